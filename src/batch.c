@@ -0,0 +1,111 @@
+#include "batch.h"
+#include "board.h"
+#include "search.h"
+#include "util.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Upper bound on the worker pool size
+#define MAX_BATCH_THREADS MAX_WORKERS
+
+
+// Shared Batch State
+
+typedef struct {
+    const char** fens;
+    int count;
+    const BatchParams* params;
+    BatchResultFunc callback;
+    void* user_data;
+    atomic_int next_index;      // Next position to hand out
+    atomic_uint_fast64_t nodes;
+    pthread_mutex_t callback_lock;
+} BatchJob;
+
+
+// Worker
+
+static void analyse_position(BatchJob* job, int index, Board* board, SearchInfo* info,
+                             SearchParams* search_params, BatchResult* result) {
+    set_fen(board, job->fens[index]);
+    iterative_deepening(board, job->params->depth, info, search_params);
+    
+    result->index = index;
+    result->fen = job->fens[index];
+    result->best_move = info->best_move;
+    result->score = (info->pv_line_count > 0) ? info->pv_lines[0].score : 0;
+    result->pv_length = info->pv_length;
+    memcpy(result->pv, info->pv, info->pv_length * sizeof(Move));
+    result->nodes = (uint64_t)info->nodes_searched + (uint64_t)info->qnodes_searched;
+}
+
+static void* batch_worker(void* arg) {
+    BatchJob* job = (BatchJob*)arg;
+    
+    // Every worker owns its board, search state and (thread-local) heuristics
+    Board* board = malloc(sizeof(Board));
+    SearchInfo* info = malloc(sizeof(SearchInfo));
+    BatchResult* result = malloc(sizeof(BatchResult));
+    
+    SearchParams search_params = {
+        .max_depth = job->params->depth,
+        .use_quiescence = true,
+        .max_nodes = job->params->max_nodes,
+        .tt = job->params->tt
+    };
+    
+    int index;
+    while ((index = atomic_fetch_add(&job->next_index, 1)) < job->count) {
+        analyse_position(job, index, board, info, &search_params, result);
+        atomic_fetch_add(&job->nodes, result->nodes);
+        
+        if (job->callback) {
+            pthread_mutex_lock(&job->callback_lock);
+            job->callback(result, job->user_data);
+            pthread_mutex_unlock(&job->callback_lock);
+        }
+    }
+    
+    free(result);
+    free(info);
+    free(board);
+    return NULL;
+}
+
+
+// Batch Analysis
+
+uint64_t analyse_batch(const char** fens, int count, const BatchParams* params,
+                       BatchResultFunc callback, void* user_data) {
+    BatchJob job = {
+        .fens = fens,
+        .count = count,
+        .params = params,
+        .callback = callback,
+        .user_data = user_data
+    };
+    atomic_init(&job.next_index, 0);
+    atomic_init(&job.nodes, 0);
+    pthread_mutex_init(&job.callback_lock, NULL);
+    
+    if (params->tt) {
+        if (params->clear_tt) {
+            clear_tt(params->tt);
+        } else {
+            age_tt(params->tt);
+        }
+    }
+    
+    int threads = params->threads;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_BATCH_THREADS) threads = MAX_BATCH_THREADS;
+    if (threads > count) threads = count > 0 ? count : 1;
+    
+    // All workers share the job; the calling thread works too
+    run_workers(batch_worker, &job, 0, threads);
+    
+    pthread_mutex_destroy(&job.callback_lock);
+    return atomic_load(&job.nodes);
+}
@@ -0,0 +1,36 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "types.h"
+#include "transposition.h"
+#include <stddef.h>
+
+// Result of analysing one position of a batch
+typedef struct {
+    int index;              // Position index in the input list
+    const char* fen;
+    Move best_move;
+    int score;              // From the side to move's perspective
+    Move pv[MAX_PLY];
+    int pv_length;
+    uint64_t nodes;         // Nodes + quiescence nodes
+} BatchResult;
+
+// Called once per finished position, serialized across workers
+typedef void (*BatchResultFunc)(const BatchResult* result, void* user_data);
+
+// Batch analysis parameters
+typedef struct {
+    int depth;
+    uint64_t max_nodes;     // Node limit per position (0 = unlimited)
+    int threads;            // Worker count (0 or 1 = single worker)
+    bool clear_tt;          // Clear the shared table before the batch starts
+    TranspositionTable* tt; // Shared by all workers (optional)
+} BatchParams;
+
+// Analyse a list of FENs on a worker pool, streaming results as they complete.
+// Returns the total number of nodes searched.
+uint64_t analyse_batch(const char** fens, int count, const BatchParams* params,
+                       BatchResultFunc callback, void* user_data);
+
+#endif // BATCH_H
@@ -0,0 +1,499 @@
+#include "bench.h"
+#include "bitbase.h"
+#include "board.h"
+#include "evaluation.h"
+#include "notation.h"
+#include "packed.h"
+#include "pgn.h"
+#include "search.h"
+#include "tablebase.h"
+#include "transposition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bench Positions
+// A mix of opening, middlegame and endgame positions (mostly the usual perft suite)
+
+const char* bench_positions[BENCH_POSITION_COUNT] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"
+};
+
+
+// Search Bench
+
+#ifdef EVAL_PROFILE
+// Calls, total and mean cycles and share of evaluation time per term
+static void print_eval_profile(void) {
+    EvalProfile profile;
+    get_eval_profile(&profile);
+    
+    uint64_t total = 0;
+    for (int term = 0; term < EVAL_TERM_COUNT; term++) {
+        total += profile.cycles[term];
+    }
+    
+    printf("===========================\n");
+    printf("%-14s %12s %16s %10s %7s\n", "Term", "Calls", "Cycles", "Per call", "Share");
+    for (int term = 0; term < EVAL_TERM_COUNT; term++) {
+        uint64_t calls = profile.calls[term];
+        printf("%-14s %12llu %16llu %10.1f %6.1f%%\n", eval_term_names[term],
+               (unsigned long long)calls, (unsigned long long)profile.cycles[term],
+               calls ? (double)profile.cycles[term] / calls : 0.0,
+               total ? 100.0 * profile.cycles[term] / total : 0.0);
+    }
+    printf("Lazy exits     %12llu\n", (unsigned long long)profile.lazy_exits);
+}
+#endif
+
+
+void bench_search(int depth, int multi_pv, size_t tt_mb) {
+    TranspositionTable tt;
+    uint64_t tt_start = get_time_ms();
+    if (!init_tt(&tt, tt_mb)) {
+        printf("Cannot allocate a %zu MB transposition table\n", tt_mb);
+        return;
+    }
+    uint64_t tt_ms = get_time_ms() - tt_start;
+    
+    SearchParams params = {
+        .max_depth = depth,
+        .use_quiescence = true,
+        .multi_pv = multi_pv,
+        .tt = &tt
+    };
+    
+    SearchInfo info;
+    uint64_t total_nodes = 0;
+    uint64_t total_qnodes = 0;
+    uint64_t cache_probes = 0, cache_hits = 0;
+    uint64_t bitbase_hits = 0, tb_hits = 0;
+    uint64_t cutoffs = 0, first_move_cutoffs = 0;
+    uint64_t total_ms = 0;
+    uint64_t clear_ms = 0;
+    
+    printf("Bench: depth %d, MultiPV %d\n", depth, multi_pv > 1 ? multi_pv : 1);
+    printf("Hash: %zu MB, %s pages, initialised in %llu ms\n", tt_mb, tt.huge_pages ? "huge" : "normal",
+           (unsigned long long)tt_ms);
+#ifdef EVAL_PROFILE
+    reset_eval_profile();
+#endif
+    
+    for (int i = 0; i < BENCH_POSITION_COUNT; i++) {
+        Board board;
+        set_fen(&board, bench_positions[i]);
+        uint64_t clear_start = get_time_ms();
+        clear_tt(&tt);
+        clear_ms += get_time_ms() - clear_start;
+        
+        uint64_t start = get_time_ms();
+        iterative_deepening(&board, depth, &info, &params);
+        uint64_t elapsed = get_time_ms() - start;
+        
+        uint64_t nodes = (uint64_t)info.nodes_searched + (uint64_t)info.qnodes_searched;
+        total_nodes += nodes;
+        total_qnodes += (uint64_t)info.qnodes_searched;
+        cache_probes += info.eval_cache_probes;
+        cache_hits += info.eval_cache_hits;
+        bitbase_hits += (uint64_t)info.bitbase_hits;
+        tb_hits += (uint64_t)info.tb_hits;
+        cutoffs += info.beta_cutoffs;
+        first_move_cutoffs += info.first_move_cutoffs;
+        total_ms += elapsed;
+        
+        printf("Position %d: %10llu nodes %6llu ms\n", i + 1,
+               (unsigned long long)nodes, (unsigned long long)elapsed);
+    }
+    
+    printf("===========================\n");
+    printf("Total time (ms) : %llu (plus %llu ms clearing the table)\n", (unsigned long long)total_ms,
+           (unsigned long long)clear_ms);
+    printf("Nodes searched  : %llu\n", (unsigned long long)total_nodes);
+    printf("Nodes/second    : %llu\n",
+           (unsigned long long)(total_ms ? total_nodes * 1000 / total_ms : 0));
+    printf("Beta cutoffs    : %llu, %.1f%% on the first move\n", (unsigned long long)cutoffs,
+           cutoffs ? 100.0 * first_move_cutoffs / cutoffs : 0.0);
+    printf("Qsearch nodes   : %llu (%.1f%%)\n", (unsigned long long)total_qnodes,
+           total_nodes ? 100.0 * total_qnodes / total_nodes : 0.0);
+    printf("Qsearch nodes/s : %llu\n",
+           (unsigned long long)(total_ms ? total_qnodes * 1000 / total_ms : 0));
+    printf("Eval cache hits : %.1f%% of %llu probes (%zu entries)\n",
+           cache_probes ? 100.0 * cache_hits / cache_probes : 0.0,
+           (unsigned long long)cache_probes, eval_cache_entries());
+    
+    TTStats tt_stats;
+    get_tt_stats(&tt, &tt_stats);
+    printf("TT probes       : %llu, %.1f%% hits, hashfull %d permille (last position)\n",
+           (unsigned long long)tt_stats.probes,
+           tt_stats.probes ? 100.0 * tt_stats.hits / tt_stats.probes : 0.0, tt_stats.hashfull);
+    printf("TT stores       : %llu (empty %llu, older search %llu, depth %llu, rejected %llu)\n",
+           (unsigned long long)tt_stats.stores, (unsigned long long)tt_stats.stored_empty,
+           (unsigned long long)tt_stats.stored_age, (unsigned long long)tt_stats.stored_depth,
+           (unsigned long long)tt_stats.rejected);
+#ifdef DEBUG
+    printf("TT collisions   : %llu\n", (unsigned long long)tt_stats.collisions);
+#endif
+    
+    KpkStats kpk;
+    get_kpk_stats(&kpk);
+    printf("Bitbase hits    : %llu\n", (unsigned long long)bitbase_hits);
+    printf("KPK bitbase     : %llu ms (%d threads, %d passes, %d wins)\n",
+           (unsigned long long)kpk.milliseconds, kpk.threads, kpk.passes, kpk.wins);
+    if (tablebase_count() > 0) {
+        printf("Tablebase hits  : %llu (%d tables, up to %d pieces)\n", (unsigned long long)tb_hits,
+               tablebase_count(), tb_max_pieces);
+    }
+#ifdef EVAL_PROFILE
+    print_eval_profile();
+#endif
+    
+    free_tt(&tt);
+}
+
+
+// Mate Suite Bench
+
+typedef struct {
+    const char* fen;
+    int moves;      // Mate in
+} MatePosition;
+
+static const MatePosition mate_suite[] = {
+    { "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 1 },
+    { "kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1", 2 },
+    { "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 2 },
+    { "r1b2k1r/ppp1bppp/8/1B1Q4/5q2/2P5/PPP2PPP/R3R1K1 w - - 1 1", 2 },
+    { "r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1", 3 },
+    { "2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - 0 1", 3 },
+    { "3r1r1k/1p3p1p/p2p4/4n1NN/6bQ/1BPq4/P3p1PP/1R5K w - - 1 1", 3 }
+};
+
+#define MATE_SUITE_COUNT ((int)(sizeof(mate_suite) / sizeof(mate_suite[0])))
+
+void bench_mates(int max_depth) {
+    TranspositionTable tt;
+    if (!init_tt(&tt, TT_SIZE_MB)) {
+        printf("Cannot allocate a %d MB transposition table\n", TT_SIZE_MB);
+        return;
+    }
+    SearchParams params = {
+        .max_depth = max_depth,
+        .use_quiescence = true,
+        .tt = &tt
+    };
+    
+    int solved = 0;
+    uint64_t total_nodes = 0;
+    uint64_t total_ms = 0;
+    printf("Mate suite: %d positions, up to depth %d\n", MATE_SUITE_COUNT, max_depth);
+    
+    for (int i = 0; i < MATE_SUITE_COUNT; i++) {
+        Board board;
+        set_fen(&board, mate_suite[i].fen);
+        clear_tt(&tt);
+        
+        // The search stops on its own once the mate is proven
+        SearchInfo info;
+        uint64_t start = get_time_ms();
+        iterative_deepening(&board, max_depth, &info, &params);
+        uint64_t elapsed = get_time_ms() - start;
+        
+        uint64_t nodes = (uint64_t)info.nodes_searched + (uint64_t)info.qnodes_searched;
+        bool found = info.pv_line_count > 0 && info.pv_lines[0].score == MATE_SCORE - (2 * mate_suite[i].moves - 1);
+        solved += found;
+        total_nodes += nodes;
+        total_ms += elapsed;
+        
+        printf("Mate in %d: %-8s depth %2d %10llu nodes %6llu ms\n", mate_suite[i].moves,
+               found ? "found" : "missed", info.pv_line_count > 0 ? info.pv_lines[0].depth : 0,
+               (unsigned long long)nodes, (unsigned long long)elapsed);
+    }
+    
+    printf("===========================\n");
+    printf("Solved          : %d / %d\n", solved, MATE_SUITE_COUNT);
+    printf("Time to mate    : %llu ms\n", (unsigned long long)total_ms);
+    printf("Nodes searched  : %llu\n", (unsigned long long)total_nodes);
+    
+    free_tt(&tt);
+}
+
+
+// Transposition Table Snapshot Bench
+
+// The middlegame position of the bench set
+#define RESUME_POSITION 5
+
+static uint64_t timed_search(const Board* start, int depth, TranspositionTable* tt, SearchInfo* info) {
+    SearchParams params = {
+        .max_depth = depth,
+        .use_quiescence = true,
+        .tt = tt
+    };
+    Board board = *start;
+    uint64_t begin = get_time_ms();
+    iterative_deepening(&board, depth, info, &params);
+    return get_time_ms() - begin;
+}
+
+void bench_tt_resume(const char* path, int depth, size_t tt_mb) {
+    Board board;
+    set_fen(&board, bench_positions[RESUME_POSITION]);
+    
+    // The analysis before the restart
+    TranspositionTable tt;
+    if (!init_tt(&tt, tt_mb)) {
+        printf("Cannot allocate a %zu MB transposition table\n", tt_mb);
+        return;
+    }
+    SearchInfo info;
+    uint64_t first_ms = timed_search(&board, depth, &tt, &info);
+    
+    uint64_t start = get_time_ms();
+    bool saved = save_tt(&tt, path);
+    uint64_t save_ms = get_time_ms() - start;
+    
+    // A restarted worker without the snapshot goes one ply deeper from an empty table...
+    clear_tt(&tt);
+    uint64_t cold_ms = timed_search(&board, depth + 1, &tt, &info);
+    uint64_t cold_nodes = (uint64_t)info.nodes_searched + (uint64_t)info.qnodes_searched;
+    free_tt(&tt);
+    if (!saved) {
+        printf("Cannot save the table to %s\n", path);
+        return;
+    }
+    
+    // ...and one with it from the mapped table
+    bool loaded = init_tt(&tt, 1);
+    start = get_time_ms();
+    loaded = loaded && load_tt(&tt, path);
+    uint64_t load_ms = get_time_ms() - start;
+    if (!loaded) {
+        printf("Cannot load the table from %s\n", path);
+        free_tt(&tt);
+        return;
+    }
+    uint64_t warm_ms = timed_search(&board, depth + 1, &tt, &info);
+    uint64_t warm_nodes = (uint64_t)info.nodes_searched + (uint64_t)info.qnodes_searched;
+    free_tt(&tt);
+    
+    printf("Resume: position %d, depth %d then %d, hash %zu MB\n", RESUME_POSITION + 1, depth, depth + 1, tt_mb);
+    printf("First analysis  : %llu ms\n", (unsigned long long)first_ms);
+    printf("Snapshot        : saved in %llu ms, mapped in %llu ms\n", (unsigned long long)save_ms,
+           (unsigned long long)load_ms);
+    printf("Cold resume     : %10llu nodes %6llu ms\n", (unsigned long long)cold_nodes,
+           (unsigned long long)cold_ms);
+    printf("Warm resume     : %10llu nodes %6llu ms\n", (unsigned long long)warm_nodes,
+           (unsigned long long)warm_ms);
+}
+
+
+// Tablebase Bench
+
+void bench_tablebases(const char* dir) {
+    int loaded = load_tablebases(dir);
+    if (loaded < 0) {
+        printf("Cannot read %s\n", dir);
+        return;
+    }
+    
+    printf("Tablebase probes: %d tables\n", loaded);
+    for (int i = 0; i < tablebase_count(); i++) {
+        printf("%-12s %8.1f ns/probe\n", tablebase_name(i), tablebase_probe_latency(i, 1000000));
+    }
+}
+
+
+// PGN Bench
+
+void bench_pgn(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Cannot open %s\n", path);
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    char* data = malloc(size);
+    size_t length = fread(data, 1, size, file);
+    fclose(file);
+    
+    PgnGame* game = malloc(sizeof(PgnGame));
+    uint64_t games = 0, moves = 0, errors = 0, passes = 0;
+    
+    // Decode the file from memory repeatedly for at least one second
+    uint64_t start = get_time_ms();
+    uint64_t elapsed = 0;
+    do {
+        PgnReader reader;
+        pgn_open_memory(&reader, data, length);
+        while (pgn_read_game(&reader, game)) {
+            games++;
+            moves += game->move_count;
+            errors += game->error;
+        }
+        pgn_close(&reader);
+        passes++;
+        elapsed = get_time_ms() - start;
+    } while (elapsed < 1000);
+    
+    printf("PGN bench: %s (%zu bytes, %llu passes)\n", path, length, (unsigned long long)passes);
+    printf("Games           : %llu (%llu with errors)\n",
+           (unsigned long long)games, (unsigned long long)errors);
+    printf("Moves decoded   : %llu\n", (unsigned long long)moves);
+    printf("Total time (ms) : %llu\n", (unsigned long long)elapsed);
+    printf("Moves/second    : %llu\n", (unsigned long long)(moves * 1000 / elapsed));
+    printf("MB/second       : %.1f\n", (double)length * passes / 1048576.0 * 1000.0 / elapsed);
+    
+    free(game);
+    free(data);
+}
+
+
+// SAN Bench
+
+void bench_san(const char* path) {
+    PgnReader reader;
+    if (!pgn_open(&reader, path)) {
+        printf("Cannot open %s\n", path);
+        return;
+    }
+    
+    // Decode all games once, then time only the SAN export
+    int capacity = 64;
+    int count = 0;
+    PgnGame* games = malloc(capacity * sizeof(PgnGame));
+    while (pgn_read_game(&reader, &games[count])) {
+        if (++count == capacity) {
+            capacity *= 2;
+            games = realloc(games, capacity * sizeof(PgnGame));
+        }
+    }
+    pgn_close(&reader);
+    
+    Board* board = malloc(sizeof(Board));
+    uint64_t strings = 0, bytes = 0, passes = 0;
+    char str[16];
+    
+    uint64_t start = get_time_ms();
+    uint64_t elapsed = 0;
+    do {
+        for (int g = 0; g < count; g++) {
+            set_fen(board, games[g].start_fen);
+            for (int i = 0; i < games[g].move_count; i++) {
+                move_to_algebraic(board, games[g].moves[i], str);
+                bytes += strlen(str);
+                strings++;
+                make_move(board, games[g].moves[i]);
+                if (board->history_index >= MAX_PLY - 1) {
+                    compact_history(board);
+                }
+            }
+        }
+        passes++;
+        elapsed = get_time_ms() - start;
+    } while (elapsed < 1000);
+    
+    printf("SAN bench: %s (%d games, %llu passes)\n", path, count, (unsigned long long)passes);
+    printf("SAN strings     : %llu (%llu bytes)\n", (unsigned long long)strings, (unsigned long long)bytes);
+    printf("Total time (ms) : %llu\n", (unsigned long long)elapsed);
+    printf("Strings/second  : %llu\n", (unsigned long long)(strings * 1000 / elapsed));
+    
+    free(board);
+    free(games);
+}
+
+
+// Packed Position Bench
+
+void bench_packed(const char* path) {
+    PgnReader reader;
+    if (!pgn_open(&reader, path)) {
+        printf("Cannot open %s\n", path);
+        return;
+    }
+    
+    // Collect every position of every game as FEN and as PackedPosition
+    int capacity = 4096;
+    int count = 0;
+    char (*fens)[128] = malloc(capacity * sizeof(*fens));
+    PackedPosition* packed = malloc(capacity * sizeof(PackedPosition));
+    PgnGame* game = malloc(sizeof(PgnGame));
+    Board* board = malloc(sizeof(Board));
+    uint64_t fen_bytes = 0;
+    
+    while (pgn_read_game(&reader, game)) {
+        set_fen(board, game->start_fen);
+        for (int i = 0; i <= game->move_count; i++) {
+            if (count == capacity) {
+                capacity *= 2;
+                fens = realloc(fens, capacity * sizeof(*fens));
+                packed = realloc(packed, capacity * sizeof(PackedPosition));
+            }
+            get_fen(board, fens[count]);
+            fen_bytes += strlen(fens[count]) + 1;
+            pack_position(board, &packed[count]);
+            count++;
+            
+            if (i == game->move_count) break;
+            make_move(board, game->moves[i]);
+            if (board->history_index >= MAX_PLY - 1) {
+                compact_history(board);
+            }
+        }
+    }
+    pgn_close(&reader);
+    
+    // Both decoders must agree before they are timed
+    int mismatches = 0;
+    Board* other = malloc(sizeof(Board));
+    for (int i = 0; i < count; i++) {
+        set_fen(board, fens[i]);
+        unpack_position(&packed[i], other);
+        mismatches += board->hash != other->hash;
+    }
+    free(other);
+    
+    // Decode each representation into a Board for at least one second
+    uint64_t checksum = 0, fen_decoded = 0, packed_decoded = 0;
+    uint64_t start = get_time_ms();
+    uint64_t fen_elapsed = 0;
+    do {
+        for (int i = 0; i < count; i++) {
+            set_fen(board, fens[i]);
+            checksum += board->hash;
+        }
+        fen_decoded += count;
+        fen_elapsed = get_time_ms() - start;
+    } while (fen_elapsed < 1000);
+    
+    start = get_time_ms();
+    uint64_t packed_elapsed = 0;
+    do {
+        for (int i = 0; i < count; i++) {
+            unpack_position(&packed[i], board);
+            checksum += board->hash;
+        }
+        packed_decoded += count;
+        packed_elapsed = get_time_ms() - start;
+    } while (packed_elapsed < 1000);
+    
+    printf("Packed bench: %s (%d positions, %d mismatches, checksum %016llx)\n",
+           path, count, mismatches, (unsigned long long)checksum);
+    printf("Bytes/position  : FEN %.1f, packed %zu\n", (double)fen_bytes / count, sizeof(PackedPosition));
+    printf("FEN positions/s : %llu\n", (unsigned long long)(fen_decoded * 1000 / fen_elapsed));
+    printf("Packed pos/s    : %llu\n", (unsigned long long)(packed_decoded * 1000 / packed_elapsed));
+    
+    free(board);
+    free(game);
+    free(packed);
+    free(fens);
+}
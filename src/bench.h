@@ -0,0 +1,35 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+#include <stddef.h>
+
+// Number of positions in the built-in bench set
+#define BENCH_POSITION_COUNT 8
+
+// Built-in bench positions (FEN)
+extern const char* bench_positions[BENCH_POSITION_COUNT];
+
+// Fixed-depth search over the bench set with a table of tt_mb MB, reports nodes and nps
+void bench_search(int depth, int multi_pv, size_t tt_mb);
+
+// Time to mate over a suite of forced mates, searching each until the mate is proven
+void bench_mates(int max_depth);
+
+// Deep analysis of a bench position from an empty table, then again after saving the table to
+// path and loading it back, as a restarted worker would resume
+void bench_tt_resume(const char* path, int depth, size_t tt_mb);
+
+// Average probe latency of every tablebase in a directory
+void bench_tablebases(const char* dir);
+
+// PGN decoding throughput (moves/second) over a PGN file
+void bench_pgn(const char* path);
+
+// SAN writing throughput (strings/second) exporting the games of a PGN file
+void bench_san(const char* path);
+
+// Positions/second decoded into a Board from FEN versus PackedPosition, over the positions of a PGN file
+void bench_packed(const char* path);
+
+#endif // BENCH_H
@@ -0,0 +1,246 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bitbase.h"
+#include "bitboard.h"
+#include "util.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_KPK_THREADS MAX_WORKERS
+
+// Positions handed to a thread at a time
+#define KPK_CHUNK 4096
+
+// One bit per position
+static uint32_t kpk_bitbase[KPK_POSITIONS / 32];
+static KpkStats kpk_stats;
+static bool kpk_generated = false;
+static pthread_once_t kpk_once = PTHREAD_ONCE_INIT;
+
+
+// Indexing
+
+// stm | black king << 1 | white king << 7 | pawn file << 13 | (RANK_7 - pawn rank) << 15
+static unsigned kpk_index(Color side_to_move, Square black_king, Square white_king, Square pawn) {
+    return (unsigned)side_to_move | (black_king << 1) | (white_king << 7) |
+           (square_file(pawn) << 13) | ((6 - square_rank(pawn)) << 15);
+}
+
+
+// Retrograde Analysis
+
+// Results are bit flags so that a position's successors can be or-ed together
+enum {
+    KPK_INVALID = 0,
+    KPK_UNKNOWN = 1,
+    KPK_DRAW = 2,
+    KPK_WIN = 4
+};
+
+typedef struct {
+    _Atomic uint8_t* results;
+    atomic_uint next_chunk;
+    atomic_bool changed;
+    bool initial;               // First pass: classify from the position alone
+} KpkJob;
+
+// Result decided by the position itself, without looking at successors
+static uint8_t initial_result(Color stm, Square black_king, Square white_king, Square pawn) {
+    Square push = pawn + 8;
+    
+    // Kings touching or on the pawn, or the side not to move in check
+    if (square_distance(white_king, black_king) <= 1 || white_king == pawn || black_king == pawn) {
+        return KPK_INVALID;
+    }
+    if (stm == WHITE && (pawn_attacks(pawn, WHITE) & square_bb(black_king))) {
+        return KPK_INVALID;
+    }
+    
+    // The pawn promotes and the new queen cannot be taken
+    if (stm == WHITE && square_rank(pawn) == 6 && push != white_king && push != black_king &&
+        (square_distance(black_king, push) > 1 || square_distance(white_king, push) == 1)) {
+        return KPK_WIN;
+    }
+    
+    if (stm == BLACK) {
+        // Stalemate, or the pawn falls
+        Bitboard guarded = king_attacks(white_king) | pawn_attacks(pawn, WHITE);
+        if (!(king_attacks(black_king) & ~guarded)) {
+            return KPK_DRAW;
+        }
+        if (king_attacks(black_king) & square_bb(pawn) & ~king_attacks(white_king)) {
+            return KPK_DRAW;
+        }
+    }
+    
+    return KPK_UNKNOWN;
+}
+
+// Result from the successors: White needs one winning move, Black one drawing move.
+// Moves into illegal positions lead to KPK_INVALID entries and drop out of the or.
+static uint8_t classify(const _Atomic uint8_t* results, Color stm, Square black_king, Square white_king, Square pawn) {
+    uint8_t reached = KPK_INVALID;
+    
+    Bitboard moves = king_attacks(stm == WHITE ? white_king : black_king);
+    while (moves) {
+        Square to = pop_lsb(&moves);
+        unsigned next = (stm == WHITE) ? kpk_index(BLACK, black_king, to, pawn)
+                                       : kpk_index(WHITE, to, white_king, pawn);
+        reached |= atomic_load_explicit(&results[next], memory_order_relaxed);
+    }
+    
+    if (stm == WHITE) {
+        int rank = square_rank(pawn);
+        if (rank < 6) {
+            reached |= atomic_load_explicit(&results[kpk_index(BLACK, black_king, white_king, pawn + 8)],
+                                            memory_order_relaxed);
+        }
+        if (rank == 1 && pawn + 8 != white_king && pawn + 8 != black_king) {
+            reached |= atomic_load_explicit(&results[kpk_index(BLACK, black_king, white_king, pawn + 16)],
+                                            memory_order_relaxed);
+        }
+    }
+    
+    uint8_t good = (stm == WHITE) ? KPK_WIN : KPK_DRAW;
+    uint8_t bad = (stm == WHITE) ? KPK_DRAW : KPK_WIN;
+    return (reached & good) ? good : (reached & KPK_UNKNOWN) ? KPK_UNKNOWN : bad;
+}
+
+// Works through chunks of the index space until the pass is done.
+// Results only ever go from unknown to final, so threads may read each other's updates early.
+static void* kpk_worker(void* arg) {
+    KpkJob* job = (KpkJob*)arg;
+    
+    for (;;) {
+        unsigned start = atomic_fetch_add(&job->next_chunk, 1) * KPK_CHUNK;
+        if (start >= KPK_POSITIONS) break;
+        
+        bool changed = false;
+        for (unsigned idx = start; idx < start + KPK_CHUNK; idx++) {
+            Color stm = (Color)(idx & 1);
+            Square black_king = (idx >> 1) & 63;
+            Square white_king = (idx >> 7) & 63;
+            Square pawn = make_square(6 - (idx >> 15), (idx >> 13) & 3);
+            
+            if (job->initial) {
+                atomic_store_explicit(&job->results[idx], initial_result(stm, black_king, white_king, pawn),
+                                      memory_order_relaxed);
+            } else if (atomic_load_explicit(&job->results[idx], memory_order_relaxed) == KPK_UNKNOWN) {
+                uint8_t result = classify(job->results, stm, black_king, white_king, pawn);
+                if (result != KPK_UNKNOWN) {
+                    atomic_store_explicit(&job->results[idx], result, memory_order_relaxed);
+                    changed = true;
+                }
+            }
+        }
+        
+        if (changed) {
+            atomic_store_explicit(&job->changed, true, memory_order_relaxed);
+        }
+    }
+    return NULL;
+}
+
+// One pass over all positions; the calling thread works too
+static void run_pass(KpkJob* job, int threads) {
+    atomic_store(&job->next_chunk, 0);
+    atomic_store(&job->changed, false);
+    
+    run_workers(kpk_worker, job, 0, threads);
+}
+
+
+// Generation
+
+void generate_kpk_bitbase(int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > MAX_KPK_THREADS) threads = MAX_KPK_THREADS;
+    
+    uint64_t start = get_time_ms();
+    
+    KpkJob job = { .results = malloc(KPK_POSITIONS * sizeof(_Atomic uint8_t)) };
+    if (!job.results) return;
+    
+    job.initial = true;
+    run_pass(&job, threads);
+    
+    // Iterate until no unknown position can be decided; the rest are draws
+    job.initial = false;
+    int passes = 0;
+    do {
+        run_pass(&job, threads);
+        passes++;
+    } while (atomic_load(&job.changed));
+    
+    int wins = 0;
+    for (unsigned idx = 0; idx < KPK_POSITIONS; idx++) {
+        if (idx % 32 == 0) kpk_bitbase[idx / 32] = 0;
+        if (atomic_load_explicit(&job.results[idx], memory_order_relaxed) == KPK_WIN) {
+            kpk_bitbase[idx / 32] |= 1u << (idx % 32);
+            wins++;
+        }
+    }
+    free(job.results);
+    
+    kpk_stats.milliseconds = get_time_ms() - start;
+    kpk_stats.threads = threads;
+    kpk_stats.passes = passes;
+    kpk_stats.wins = wins;
+    kpk_generated = true;
+}
+
+static void generate_once(void) {
+    if (!kpk_generated) {
+        generate_kpk_bitbase((int)sysconf(_SC_NPROCESSORS_ONLN));
+    }
+}
+
+void init_kpk_bitbase(void) {
+    pthread_once(&kpk_once, generate_once);
+}
+
+void get_kpk_stats(KpkStats* stats) {
+    *stats = kpk_stats;
+}
+
+
+// Probing
+
+bool kpk_probe(Square white_king, Square pawn, Square black_king, Color side_to_move) {
+    init_kpk_bitbase();
+    
+    // Mirror pawns on files e-h to a-d
+    if (square_file(pawn) > 3) {
+        white_king ^= 7;
+        pawn ^= 7;
+        black_king ^= 7;
+    }
+    
+    unsigned idx = kpk_index(side_to_move, black_king, white_king, pawn);
+    return (kpk_bitbase[idx / 32] >> (idx % 32)) & 1;
+}
+
+bool is_kpk(const Board* board) {
+    return board->material_key == MATERIAL_KEY_UNIT(WHITE, PAWN) ||
+           board->material_key == MATERIAL_KEY_UNIT(BLACK, PAWN);
+}
+
+bool kpk_is_win(const Board* board, Color strong) {
+    Color weak = (strong == WHITE) ? BLACK : WHITE;
+    Square strong_king = get_king_square(board, strong);
+    Square weak_king = get_king_square(board, weak);
+    Square pawn = lsb(board->pieces[strong][PAWN]);
+    Color stm = board->side_to_move;
+    
+    // Flip the board so that the pawn side is White
+    if (strong == BLACK) {
+        strong_king ^= 56;
+        weak_king ^= 56;
+        pawn ^= 56;
+        stm = (stm == WHITE) ? BLACK : WHITE;
+    }
+    
+    return kpk_probe(strong_king, pawn, weak_king, stm);
+}
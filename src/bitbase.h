@@ -0,0 +1,38 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "types.h"
+#include "board.h"
+
+// KPK bitbase: one bit (win or not) for every king and pawn against king position,
+// generated by retrograde analysis. Positions are stored with White holding the pawn
+// on files a-d; other positions are mirrored before probing.
+
+// Side to move x black king x white king x pawn (4 files, ranks 2-7)
+#define KPK_POSITIONS (2 * 64 * 64 * 24)
+
+typedef struct {
+    uint64_t milliseconds;   // Wall time of the last generation
+    int threads;
+    int passes;              // Classification passes until nothing changed
+    int wins;                // Won positions (White holding the pawn)
+} KpkStats;
+
+// Generates the bitbase once, on all online cores (called by init_evaluation and by the first
+// probe before it; threads probing meanwhile wait for it)
+void init_kpk_bitbase(void);
+
+// Regenerates the bitbase with the given number of threads
+void generate_kpk_bitbase(int threads);
+void get_kpk_stats(KpkStats* stats);
+
+// Whether White holding the pawn wins, pawn on any file
+bool kpk_probe(Square white_king, Square pawn, Square black_king, Color side_to_move);
+
+// Exactly one pawn and the kings on the board
+bool is_kpk(const Board* board);
+
+// Whether the side holding the pawn of a KPK position wins
+bool kpk_is_win(const Board* board, Color strong);
+
+#endif // BITBASE_H
@@ -1,4 +1,5 @@
 #include "bitboard.h"
+#include <stdlib.h>
 #include <string.h>
 
 #define FILE_A 0x0101010101010101ULL
@@ -54,6 +55,12 @@ Bitboard square_bb(Square sq) {
     return 1ULL << sq;
 }
 
+int square_distance(Square a, Square b) {
+    int rank_distance = abs(square_rank(a) - square_rank(b));
+    int file_distance = abs(square_file(a) - square_file(b));
+    return rank_distance > file_distance ? rank_distance : file_distance;
+}
+
 
 // Masks
 
@@ -92,6 +99,20 @@ Bitboard anti_diagonal_mask(Square sq) {
 }
 
 
+// Ray Tables
+
+Bitboard between_table[64][64];
+Bitboard line_table[64][64];
+
+Bitboard between_bb(Square a, Square b) {
+    return between_table[a][b];
+}
+
+Bitboard line_bb(Square a, Square b) {
+    return line_table[a][b];
+}
+
+
 // Non-Sliding Piece Attack Tables
 
 Bitboard pawn_attack_table[2][64];
@@ -120,8 +141,8 @@ Bitboard rook_magics[64] = {
     0x0080020400080080ULL, 0x0080010200040080ULL, 0x0080008001000200ULL, 0x0080002040800100ULL,
     0x0000800020400080ULL, 0x0000400020005000ULL, 0x0000801000200080ULL, 0x0000800800100080ULL,
     0x0000800400080080ULL, 0x0000800200040080ULL, 0x0000800100020080ULL, 0x0000800040800100ULL,
-    0x0000208000400080ULL, 0x0000404000201000ULL, 0x0000808010000800ULL, 0x0000808008000400ULL,
-    0x0000808004000200ULL, 0x0000808002000100ULL, 0x0000010100020004ULL, 0x0000020000408104ULL,
+    0x0000208000400080ULL, 0x0000404000201000ULL, 0x0E86110020050440ULL, 0x8108008008100080ULL,
+    0x1080808004000800ULL, 0x0002010100080400ULL, 0x0000010100020004ULL, 0x0000020000408104ULL,
     0x0000208080004000ULL, 0x0000200040005000ULL, 0x0000100080200080ULL, 0x0000080080100080ULL,
     0x0000040080080080ULL, 0x0000020080040080ULL, 0x0000010080800200ULL, 0x0000800080004100ULL,
     0x0000204000800080ULL, 0x0000200040401000ULL, 0x0000100080802000ULL, 0x0000080080801000ULL,
@@ -415,4 +436,24 @@ void init_bitboards(void) {
             bishop_attacks_table[sq][index] = generate_bishop_attacks_slow(sq, occ);
         }
     }
+    
+    // Ray tables (need the sliding attacks above)
+    for (int a = 0; a < 64; a++) {
+        for (int b = 0; b < 64; b++) {
+            between_table[a][b] = 0ULL;
+            line_table[a][b] = 0ULL;
+            if (a == b) continue;
+            
+            Bitboard bb_a = 1ULL << a;
+            Bitboard bb_b = 1ULL << b;
+            
+            if (bishop_attacks(a, 0ULL) & bb_b) {
+                line_table[a][b] = (bishop_attacks(a, 0ULL) & bishop_attacks(b, 0ULL)) | bb_a | bb_b;
+                between_table[a][b] = bishop_attacks(a, bb_b) & bishop_attacks(b, bb_a);
+            } else if (rook_attacks(a, 0ULL) & bb_b) {
+                line_table[a][b] = (rook_attacks(a, 0ULL) & rook_attacks(b, 0ULL)) | bb_a | bb_b;
+                between_table[a][b] = rook_attacks(a, bb_b) & rook_attacks(b, bb_a);
+            }
+        }
+    }
 }
@@ -16,6 +16,7 @@ int square_rank(Square sq);
 int square_file(Square sq);
 Square make_square(int rank, int file);
 Bitboard square_bb(Square sq);
+int square_distance(Square a, Square b);  // King moves between the squares
 
 // Attack generation
 Bitboard pawn_attacks(Square sq, Color color);
@@ -30,6 +31,8 @@ Bitboard rank_mask(int rank);
 Bitboard file_mask(int file);
 Bitboard diagonal_mask(Square sq);
 Bitboard anti_diagonal_mask(Square sq);
+Bitboard between_bb(Square a, Square b);  // Squares strictly between a and b (0 if not aligned)
+Bitboard line_bb(Square a, Square b);     // Full line through a and b (0 if not aligned)
 
 // Initialization
 void init_bitboards(void);
@@ -47,6 +50,10 @@ extern Bitboard bishop_masks[64];
 extern int rook_shifts[64];
 extern int bishop_shifts[64];
 
+// Ray tables: [from][to]
+extern Bitboard between_table[64][64];
+extern Bitboard line_table[64][64];
+
 // Attack tables for magic bitboards
 extern Bitboard rook_attacks_table[64][4096];
 extern Bitboard bishop_attacks_table[64][512];
@@ -12,8 +12,7 @@
 
 void init_board(Board* board) {
     // Standard starting position: https://rustic-chess.org/board_functionality/handling_fen_strings.html
-    const char* start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-    set_fen(board, start_fen);
+    set_fen(board, START_FEN);
 }
 
 void copy_board(Board* dest, const Board* src) {
@@ -118,6 +117,7 @@ void set_fen(Board* board, const char* fen) {
     
     // Compute zobrist hash
     board->hash = compute_hash(board);
+    board->material_key = compute_material_key(board);
     board->position_history[board->history_index++] = board->hash;
 }
 
@@ -287,6 +287,106 @@ Bitboard get_attackers(const Board* board, Square sq, Color color) {
 }
 
 
+Bitboard slider_blockers(const Board* board, Color attacker, Square king_sq) {
+    // Pieces (of either color) that are the only piece between king_sq and an attacking slider
+    Bitboard snipers = (rook_attacks(king_sq, 0ULL) &
+                        (board->pieces[attacker][ROOK] | board->pieces[attacker][QUEEN])) |
+                       (bishop_attacks(king_sq, 0ULL) &
+                        (board->pieces[attacker][BISHOP] | board->pieces[attacker][QUEEN]));
+    Bitboard blockers = 0ULL;
+    
+    while (snipers) {
+        Square sniper = pop_lsb(&snipers);
+        Bitboard between = between_bb(king_sq, sniper) & board->all_occupied;
+        
+        if (between && !(between & (between - 1))) {
+            blockers |= between;
+        }
+    }
+    
+    return blockers;
+}
+
+void init_check_info(const Board* board, CheckInfo* info) {
+    Color us = board->side_to_move;
+    Color them = (us == WHITE) ? BLACK : WHITE;
+    Square ksq = get_king_square(board, them);
+    Bitboard occupied = board->all_occupied;
+    
+    info->king_square = ksq;
+    if (ksq == NO_SQUARE) {
+        memset(info->check_squares, 0, sizeof(info->check_squares));
+        info->blockers = 0ULL;
+        return;
+    }
+    
+    info->check_squares[PAWN] = pawn_attacks(ksq, them);
+    info->check_squares[KNIGHT] = knight_attacks(ksq);
+    info->check_squares[BISHOP] = bishop_attacks(ksq, occupied);
+    info->check_squares[ROOK] = rook_attacks(ksq, occupied);
+    info->check_squares[QUEEN] = info->check_squares[BISHOP] | info->check_squares[ROOK];
+    info->check_squares[KING] = 0ULL;
+    info->blockers = slider_blockers(board, us, ksq) & board->occupied[us];
+}
+
+bool gives_check(const Board* board, const CheckInfo* info, Move move) {
+    Square ksq = info->king_square;
+    if (ksq == NO_SQUARE) return false;
+    
+    Square from = move_from(move);
+    Square to = move_to(move);
+    MoveFlags flags = move_flags(move);
+    Color us = board->side_to_move;
+    Bitboard king_bb = square_bb(ksq);
+    
+    // Direct check
+    if (!is_promotion(move) && (info->check_squares[piece_on(board, from)] & square_bb(to))) {
+        return true;
+    }
+    
+    // Discovered check: a blocker leaves the line to the king
+    if ((info->blockers & square_bb(from)) && !(line_bb(from, ksq) & square_bb(to))) {
+        return true;
+    }
+    
+    Bitboard occupied = (board->all_occupied ^ square_bb(from)) | square_bb(to);
+    
+    if (is_promotion(move)) {
+        switch (promotion_piece(move)) {
+            case KNIGHT: return (knight_attacks(to) & king_bb) != 0;
+            case BISHOP: return (bishop_attacks(to, occupied) & king_bb) != 0;
+            case ROOK:   return (rook_attacks(to, occupied) & king_bb) != 0;
+            case QUEEN:  return (queen_attacks(to, occupied) & king_bb) != 0;
+            default:     return false;
+        }
+    }
+    
+    if (flags == EN_PASSANT) {
+        // The captured pawn can uncover a check as well
+        Square captured_sq = (us == WHITE) ? (to - 8) : (to + 8);
+        occupied ^= square_bb(captured_sq);
+        return (bishop_attacks(ksq, occupied) & (board->pieces[us][BISHOP] | board->pieces[us][QUEEN])) ||
+               (rook_attacks(ksq, occupied) & (board->pieces[us][ROOK] | board->pieces[us][QUEEN]));
+    }
+    
+    if (flags == CASTLE_KINGSIDE || flags == CASTLE_QUEENSIDE) {
+        // The rook gives the check
+        Square rook_from, rook_to;
+        if (flags == CASTLE_KINGSIDE) {
+            rook_from = (us == WHITE) ? H1 : H8;
+            rook_to = (us == WHITE) ? F1 : F8;
+        } else {
+            rook_from = (us == WHITE) ? A1 : A8;
+            rook_to = (us == WHITE) ? D1 : D8;
+        }
+        occupied = (occupied ^ square_bb(rook_from)) | square_bb(rook_to);
+        return (rook_attacks(rook_to, occupied) & king_bb) != 0;
+    }
+    
+    return false;
+}
+
+
 // Move Execution
 
 void make_move(Board* board, Move move) {
@@ -304,6 +404,7 @@ void make_move(Board* board, Move move) {
     board->undo_stack[board->undo_index].en_passant_square = board->en_passant_square;
     board->undo_stack[board->undo_index].halfmove_clock = board->halfmove_clock;
     board->undo_stack[board->undo_index].hash = board->hash;
+    board->undo_stack[board->undo_index].material_key = board->material_key;
     board->undo_stack[board->undo_index].captured_piece = NO_PIECE_TYPE;
     board->undo_index++;
     
@@ -323,18 +424,20 @@ void make_move(Board* board, Move move) {
     // Reset en passant (will be set again if this is a double pawn push)
     board->en_passant_square = NO_SQUARE;
     
-    // Handle special moves
-    if (flags == CAPTURE) {
+    // Handle special moves (a promotion can also capture)
+    if (flags == CAPTURE || (is_promotion(move) && get_bit(board->occupied[them], to))) {
         captured = piece_on(board, to);
         board->pieces[them][captured] = clear_bit(board->pieces[them][captured], to);
         board->occupied[them] = clear_bit(board->occupied[them], to);
         board->hash ^= piece_keys[them][captured][to];
+        board->material_key -= MATERIAL_KEY_UNIT(them, captured);
         board->undo_stack[board->undo_index - 1].captured_piece = captured;
     } else if (flags == EN_PASSANT) {
         Square captured_sq = (us == WHITE) ? (to - 8) : (to + 8);
         board->pieces[them][PAWN] = clear_bit(board->pieces[them][PAWN], captured_sq);
         board->occupied[them] = clear_bit(board->occupied[them], captured_sq);
         board->hash ^= piece_keys[them][PAWN][captured_sq];
+        board->material_key -= MATERIAL_KEY_UNIT(them, PAWN);
         board->undo_stack[board->undo_index - 1].captured_piece = PAWN;
     } else if (flags == CASTLE_KINGSIDE) {
         Square rook_from = (us == WHITE) ? H1 : H8;
@@ -361,6 +464,7 @@ void make_move(Board* board, Move move) {
         PieceType promoted = promotion_piece(move);
         board->pieces[us][promoted] = set_bit(board->pieces[us][promoted], to);
         board->hash ^= piece_keys[us][promoted][to];
+        board->material_key += MATERIAL_KEY_UNIT(us, promoted) - MATERIAL_KEY_UNIT(us, PAWN);
     } else {
         board->pieces[us][piece] = set_bit(board->pieces[us][piece], to);
         board->hash ^= piece_keys[us][piece][to];
@@ -432,6 +536,7 @@ void unmake_move(Board* board, Move move) {
     board->en_passant_square = undo->en_passant_square;
     board->halfmove_clock = undo->halfmove_clock;
     board->hash = undo->hash;
+    board->material_key = undo->material_key;
     PieceType captured = undo->captured_piece;
     
     // Determine piece type (handle promotions)
@@ -451,7 +556,7 @@ void unmake_move(Board* board, Move move) {
     board->occupied[us] = set_bit(board->occupied[us], from);
     
     // Restore captured piece
-    if (flags == CAPTURE) {
+    if (flags == CAPTURE || (is_promotion(move) && captured != NO_PIECE_TYPE)) {
         board->pieces[them][captured] = set_bit(board->pieces[them][captured], to);
         board->occupied[them] = set_bit(board->occupied[them], to);
     } else if (flags == EN_PASSANT) {
@@ -564,6 +669,20 @@ bool is_fifty_move_draw(const Board* board) {
     return board->halfmove_clock >= 100;  // 50 moves for each side
 }
 
+void compact_history(Board* board) {
+    // Drop the undo stack and keep only the positions that can still repeat,
+    // so a game can go on past MAX_PLY plies (moves before this can no longer be unmade)
+    int keep = board->halfmove_clock + 1;
+    if (keep > board->history_index) keep = board->history_index;
+    if (keep > MAX_PLY / 2) keep = MAX_PLY / 2;
+    
+    memmove(board->position_history,
+            board->position_history + board->history_index - keep,
+            keep * sizeof(uint64_t));
+    board->history_index = keep;
+    board->undo_index = 0;
+}
+
 
 // Game State
 
@@ -3,15 +3,24 @@
 
 #include "types.h"
 
+// Standard starting position
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
 // Undo information for making/unmaking moves
 typedef struct {
     uint8_t castling_rights;
     Square en_passant_square;
     int halfmove_clock;  // Number of consecutive moves without a pawn move or a capture. If it reaches 100 (50 moves for each side), the game is a draw.
     uint64_t hash;
+    uint64_t material_key;
     PieceType captured_piece;
 } UndoInfo;
 
+// Material key: a 4-bit count for each color and piece type from pawn to queen
+#define MATERIAL_KEY_SHIFT(color, piece) (4 * ((color) * 5 + (piece)))
+#define MATERIAL_KEY_UNIT(color, piece) (1ULL << MATERIAL_KEY_SHIFT(color, piece))
+#define material_count(key, color, piece) ((int)(((key) >> MATERIAL_KEY_SHIFT(color, piece)) & 0xF))
+
 // Board representation
 typedef struct Board {
     Bitboard pieces[2][6];  // [color][piece_type]
@@ -25,6 +34,7 @@ typedef struct Board {
     int fullmove_number;  // total number of turns in the game.
     
     uint64_t hash;
+    uint64_t material_key;  // Piece counts, see MATERIAL_KEY_UNIT
     
     // Undo stack for move/unmake
     UndoInfo undo_stack[MAX_PLY];
@@ -35,6 +45,13 @@ typedef struct Board {
     int history_index;
 } Board;
 
+// Check detection data for the side to move, computed once per position
+typedef struct {
+    Square king_square;          // Enemy king
+    Bitboard check_squares[6];   // [piece_type] squares from which that piece checks the enemy king
+    Bitboard blockers;           // Own pieces whose move can uncover a check
+} CheckInfo;
+
 // Board initialization
 void init_board(Board* board);
 void set_fen(Board* board, const char* fen);
@@ -55,9 +72,13 @@ bool make_move_if_legal(Board* board, Move move);
 
 // Board utilities
 Bitboard get_attackers(const Board* board, Square sq, Color color);
+Bitboard slider_blockers(const Board* board, Color attacker, Square king_sq);
+void init_check_info(const Board* board, CheckInfo* info);
+bool gives_check(const Board* board, const CheckInfo* info, Move move);
 bool is_insufficient_material(const Board* board);
 bool is_repetition(const Board* board);
 bool is_fifty_move_draw(const Board* board);
+void compact_history(Board* board);
 
 // Game state
 GameResult get_game_result(const Board* board);
@@ -0,0 +1,441 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "book.h"
+#include "bitboard.h"
+#include "moves.h"
+#include "movegen.h"
+#include "packed.h"
+#include "pgn.h"
+#include "util.h"
+#include "zobrist.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Upper bound on the builder's worker pool
+#define MAX_BOOK_THREADS MAX_WORKERS
+
+// Largest weight an entry can hold
+#define BOOK_MAX_WEIGHT 65535
+
+
+// Entry Encoding
+
+static uint64_t read_be(const uint8_t* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static void write_be(uint8_t* bytes, uint64_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        bytes[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+// to | from << 6 | promotion << 12; the promotion codes 1-4 are KNIGHT..QUEEN
+static uint16_t encode_book_move(Move move) {
+    Square from = move_from(move);
+    Square to = move_to(move);
+    MoveFlags flags = move_flags(move);
+    
+    if (flags == CASTLE_KINGSIDE) {
+        to = from + 3;
+    } else if (flags == CASTLE_QUEENSIDE) {
+        to = from - 4;
+    }
+    int promotion = is_promotion(move) ? (int)promotion_piece(move) : 0;
+    return (uint16_t)(to | (from << 6) | (promotion << 12));
+}
+
+
+// Memory-Mapped Reading
+
+bool book_open(Book* book, const char* path) {
+    memset(book, 0, sizeof(Book));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size % BOOK_ENTRY_SIZE != 0) {
+        close(fd);
+        return false;
+    }
+    
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps the file alive
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    
+    // Probes jump around the file
+    posix_madvise(data, st.st_size, POSIX_MADV_RANDOM);
+    book->data = data;
+    book->size = st.st_size;
+    book->count = st.st_size / BOOK_ENTRY_SIZE;
+    return true;
+}
+
+void book_close(Book* book) {
+    if (book->data) {
+        munmap((void*)book->data, book->size);
+    }
+    memset(book, 0, sizeof(Book));
+}
+
+
+// Probing
+
+// First entry with a key not below the given one
+static uint64_t lower_bound(const Book* book, uint64_t key) {
+    uint64_t low = 0, high = book->count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (read_be(book->data + mid * BOOK_ENTRY_SIZE, 8) < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+int book_moves(const Book* book, const Board* board, BookMove* moves, int max_moves) {
+    if (!book->data) {
+        return 0;
+    }
+    
+    MoveList legal;
+    generate_moves(board, &legal);
+    
+    uint64_t key = compute_polyglot_key(board);
+    int count = 0;
+    for (uint64_t i = lower_bound(book, key); i < book->count && count < max_moves; i++) {
+        const uint8_t* entry = book->data + i * BOOK_ENTRY_SIZE;
+        if (read_be(entry, 8) != key) break;
+        
+        // Only moves that are legal here (a key collision may point anywhere)
+        uint16_t encoded = (uint16_t)read_be(entry + 8, 2);
+        int weight = (int)read_be(entry + 10, 2);
+        for (int j = 0; j < legal.count; j++) {
+            if (encode_book_move(legal.moves[j]) == encoded && is_legal(board, legal.moves[j])) {
+                moves[count].move = legal.moves[j];
+                moves[count].weight = weight;
+                count++;
+                break;
+            }
+        }
+    }
+    
+    // Heaviest first
+    for (int i = 1; i < count; i++) {
+        BookMove current = moves[i];
+        int j = i - 1;
+        while (j >= 0 && moves[j].weight < current.weight) {
+            moves[j + 1] = moves[j];
+            j--;
+        }
+        moves[j + 1] = current;
+    }
+    return count;
+}
+
+Move book_probe(const Book* book, const Board* board, uint64_t* seed) {
+    BookMove moves[BOOK_MAX_MOVES];
+    int count = book_moves(book, board, moves, BOOK_MAX_MOVES);
+    
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += (uint64_t)moves[i].weight;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    
+    // xorshift64
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    uint64_t pick = *seed % total;
+    for (int i = 0; i < count; i++) {
+        if (pick < (uint64_t)moves[i].weight) {
+            return moves[i].move;
+        }
+        pick -= (uint64_t)moves[i].weight;
+    }
+    return moves[0].move;
+}
+
+
+// Book Building
+// The games are decoded on the calling thread, then the workers replay slices of them and
+// count (key, move) pairs into sorted private arrays, which are merged at the end.
+
+typedef struct {
+    PackedPosition start;       // Its result field holds the game result
+    size_t first_move;
+    int move_count;
+} BookGame;
+
+typedef struct {
+    uint64_t key;
+    uint16_t move;
+    uint32_t games;
+    uint32_t score;             // 2 per win, 1 per draw for the side that played the move
+} BookCount;
+
+typedef struct {
+    const BookGame* games;
+    const Move* moves;
+    size_t begin;
+    size_t end;
+    BookCount* counts;
+    size_t count;
+} BookTask;
+
+static int compare_counts(const void* a, const void* b) {
+    const BookCount* x = (const BookCount*)a;
+    const BookCount* y = (const BookCount*)b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+// Heaviest first within a key, so that readers see the main line first
+static int compare_entries(const void* a, const void* b) {
+    const BookCount* x = (const BookCount*)a;
+    const BookCount* y = (const BookCount*)b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+// Sorts and folds equal (key, move) pairs together, returns the new count
+static size_t combine_counts(BookCount* counts, size_t count) {
+    qsort(counts, count, sizeof(BookCount), compare_counts);
+    size_t out = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (out > 0 && counts[out - 1].key == counts[i].key && counts[out - 1].move == counts[i].move) {
+            counts[out - 1].games += counts[i].games;
+            counts[out - 1].score += counts[i].score;
+        } else {
+            counts[out++] = counts[i];
+        }
+    }
+    return out;
+}
+
+static void* count_worker(void* arg) {
+    BookTask* task = (BookTask*)arg;
+    Board* board = malloc(sizeof(Board));
+    if (!board) return NULL;
+    
+    for (size_t g = task->begin; g < task->end; g++) {
+        const BookGame* game = &task->games[g];
+        unpack_position(&game->start, board);
+        
+        for (int i = 0; i < game->move_count; i++) {
+            Move move = task->moves[game->first_move + i];
+            GameResult result = (GameResult)game->start.result;
+            GameResult win = (board->side_to_move == WHITE) ? WHITE_WINS : BLACK_WINS;
+            
+            BookCount* count = &task->counts[task->count++];
+            count->key = compute_polyglot_key(board);
+            count->move = encode_book_move(move);
+            count->games = 1;
+            count->score = (result == win) ? 2 : (result == DRAW) ? 1 : 0;
+            
+            make_move(board, move);
+            if (board->history_index >= MAX_PLY - 1) {
+                compact_history(board);
+            }
+        }
+    }
+    
+    free(board);
+    task->count = combine_counts(task->counts, task->count);
+    return NULL;
+}
+
+// Decodes the games of every file, keeping the first max_ply moves of games with a result
+static bool read_games(const char** paths, int path_count, int max_ply,
+                       BookGame** games, size_t* game_count, Move** moves, size_t* move_count) {
+    size_t game_capacity = 1024, move_capacity = 1024 * 16;
+    *games = malloc(game_capacity * sizeof(BookGame));
+    *moves = malloc(move_capacity * sizeof(Move));
+    *game_count = *move_count = 0;
+    PgnGame* game = malloc(sizeof(PgnGame));
+    Board* board = malloc(sizeof(Board));
+    bool ok = *games && *moves && game && board;
+    
+    for (int p = 0; ok && p < path_count; p++) {
+        PgnReader reader;
+        if (!pgn_open(&reader, paths[p])) {
+            ok = false;
+            break;
+        }
+        
+        while (ok && pgn_read_game(&reader, game)) {
+            if (game->result == ONGOING || game->move_count == 0) continue;
+            int plies = game->move_count < max_ply ? game->move_count : max_ply;
+            
+            if (*game_count == game_capacity) {
+                game_capacity *= 2;
+                BookGame* grown = realloc(*games, game_capacity * sizeof(BookGame));
+                if (!grown) {
+                    ok = false;
+                    break;
+                }
+                *games = grown;
+            }
+            while (*move_count + plies > move_capacity) {
+                move_capacity *= 2;
+                Move* grown = realloc(*moves, move_capacity * sizeof(Move));
+                if (!grown) {
+                    ok = false;
+                    break;
+                }
+                *moves = grown;
+            }
+            if (!ok) break;
+            
+            BookGame* entry = &(*games)[(*game_count)++];
+            set_fen(board, game->start_fen);
+            pack_position(board, &entry->start);
+            entry->start.result = (uint8_t)game->result;
+            entry->first_move = *move_count;
+            entry->move_count = plies;
+            memcpy(*moves + *move_count, game->moves, plies * sizeof(Move));
+            *move_count += plies;
+        }
+        pgn_close(&reader);
+    }
+    
+    free(board);
+    free(game);
+    return ok;
+}
+
+// Writes the entries, scaling down the weights of keys whose scores do not fit in 16 bits
+static bool write_book(const char* path, const BookCount* entries, size_t count) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; ) {
+        size_t end = i;
+        uint32_t max_score = 0;
+        while (end < count && entries[end].key == entries[i].key) {
+            if (entries[end].score > max_score) max_score = entries[end].score;
+            end++;
+        }
+        
+        for (; ok && i < end; i++) {
+            uint64_t weight = entries[i].score;
+            if (max_score > BOOK_MAX_WEIGHT) {
+                weight = weight * BOOK_MAX_WEIGHT / max_score;
+            }
+            uint8_t bytes[BOOK_ENTRY_SIZE];
+            write_be(bytes, entries[i].key, 8);
+            write_be(bytes + 8, entries[i].move, 2);
+            write_be(bytes + 10, weight, 2);
+            write_be(bytes + 12, 0, 4);
+            ok = fwrite(bytes, 1, BOOK_ENTRY_SIZE, file) == BOOK_ENTRY_SIZE;
+        }
+    }
+    return fclose(file) == 0 && ok;
+}
+
+bool build_book(const char** pgn_paths, int path_count, const char* out_path,
+                const BookBuildParams* params, BookBuildStats* stats) {
+    memset(stats, 0, sizeof(BookBuildStats));
+    uint64_t start = get_time_ms();
+    
+    BookGame* games;
+    Move* moves;
+    size_t game_count, move_count;
+    if (!read_games(pgn_paths, path_count, params->max_ply, &games, &game_count, &moves, &move_count)) {
+        free(games);
+        free(moves);
+        return false;
+    }
+    stats->games = game_count;
+    stats->positions = move_count;
+    stats->read_ms = get_time_ms() - start;
+    
+    // Every worker gets room for one count per ply of its games
+    int threads = params->threads;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_BOOK_THREADS) threads = MAX_BOOK_THREADS;
+    if ((size_t)threads > game_count) threads = game_count > 0 ? (int)game_count : 1;
+    
+    BookTask tasks[MAX_BOOK_THREADS];
+    bool ok = true;
+    for (int i = 0; i < threads; i++) {
+        tasks[i] = (BookTask){
+            .games = games,
+            .moves = moves,
+            .begin = game_count * i / threads,
+            .end = game_count * (i + 1) / threads
+        };
+        size_t plies = 0;
+        for (size_t g = tasks[i].begin; g < tasks[i].end; g++) {
+            plies += games[g].move_count;
+        }
+        tasks[i].counts = malloc((plies > 0 ? plies : 1) * sizeof(BookCount));
+        ok = ok && tasks[i].counts;
+    }
+    
+    if (ok) {
+        start = get_time_ms();
+        run_workers(count_worker, tasks, sizeof(BookTask), threads);
+        stats->count_ms = get_time_ms() - start;
+    }
+    free(games);
+    free(moves);
+    
+    // Merge, then drop rare moves
+    start = get_time_ms();
+    size_t total = 0;
+    for (int i = 0; ok && i < threads; i++) {
+        total += tasks[i].count;
+    }
+    BookCount* merged = ok ? malloc((total > 0 ? total : 1) * sizeof(BookCount)) : NULL;
+    if (merged) {
+        size_t offset = 0;
+        for (int i = 0; i < threads; i++) {
+            memcpy(merged + offset, tasks[i].counts, tasks[i].count * sizeof(BookCount));
+            offset += tasks[i].count;
+        }
+        total = combine_counts(merged, total);
+        
+        size_t kept = 0;
+        for (size_t i = 0; i < total; i++) {
+            if ((int)merged[i].games >= params->min_games) {
+                merged[kept++] = merged[i];
+            }
+        }
+        qsort(merged, kept, sizeof(BookCount), compare_entries);
+        ok = write_book(out_path, merged, kept);
+        stats->entries = kept;
+    } else {
+        ok = false;
+    }
+    stats->merge_ms = get_time_ms() - start;
+    
+    free(merged);
+    for (int i = 0; i < threads; i++) {
+        free(tasks[i].counts);
+    }
+    return ok;
+}
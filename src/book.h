@@ -0,0 +1,60 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "types.h"
+#include "board.h"
+#include <stddef.h>
+
+// Opening books in the Polyglot format: 16-byte big-endian entries (key, move, weight, learn)
+// sorted by key, where the key is compute_polyglot_key() and the move packs the to file and
+// rank, the from file and rank and the promotion piece in 3 bits each. Castling is written as
+// the king taking its own rook (e1h1).
+
+#define BOOK_ENTRY_SIZE 16
+#define BOOK_MAX_MOVES 64
+
+// Read-only memory-mapped book
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    uint64_t count;             // Entries
+} Book;
+
+// A book move of the current position
+typedef struct {
+    Move move;
+    int weight;
+} BookMove;
+
+// Opening and closing (false if the file is missing or not a whole number of entries)
+bool book_open(Book* book, const char* path);
+void book_close(Book* book);
+
+// Legal book moves of a position, heaviest first. Returns the count.
+int book_moves(const Book* book, const Board* board, BookMove* moves, int max_moves);
+
+// A book move picked at random in proportion to the weights, 0 when out of book
+Move book_probe(const Book* book, const Board* board, uint64_t* seed);
+
+// Book building from PGN files
+typedef struct {
+    int threads;
+    int max_ply;                // Plies of each game that enter the book
+    int min_games;              // Moves played in fewer games are left out
+} BookBuildParams;
+
+typedef struct {
+    uint64_t games;             // Games with a result
+    uint64_t positions;         // Plies counted
+    uint64_t entries;           // Entries written
+    uint64_t read_ms;           // PGN decoding
+    uint64_t count_ms;          // Replaying and counting on the workers
+    uint64_t merge_ms;          // Merging the workers' counts and writing
+} BookBuildStats;
+
+// Counts every (position, move) pair of the games with 2 points per win and 1 per draw for
+// the side that played it, and writes the book. Returns false if a file cannot be read or written.
+bool build_book(const char** pgn_paths, int path_count, const char* out_path,
+                const BookBuildParams* params, BookBuildStats* stats);
+
+#endif // BOOK_H
@@ -0,0 +1,141 @@
+#include "endgame.h"
+#include "bitbase.h"
+#include "bitboard.h"
+#include "board.h"
+#include "evaluation.h"
+#include "material.h"
+#include <stdlib.h>
+
+
+// Helpers
+
+#define DARK_SQUARES 0xAA55AA55AA55AA55ULL
+
+Square relative_square(Color color, Square sq) {
+    return (color == WHITE) ? sq : (Square)(sq ^ 56);
+}
+
+static bool is_dark_square(Square sq) {
+    return (DARK_SQUARES >> sq) & 1;  // a1 is dark
+}
+
+static int manhattan_distance(Square a, Square b) {
+    return abs(square_rank(a) - square_rank(b)) + abs(square_file(a) - square_file(b));
+}
+
+// 0 in the centre, 6 in a corner
+static int edge_distance_bonus(Square sq) {
+    int file = square_file(sq), rank = square_rank(sq);
+    int file_edge = file < 4 ? 3 - file : file - 4;
+    int rank_edge = rank < 4 ? 3 - rank : rank - 4;
+    return file_edge + rank_edge;
+}
+
+static int from_white(int score, Color strong) {
+    return (strong == WHITE) ? score : -score;
+}
+
+
+// Evaluators
+
+int evaluate_kxk(const Board* board, Color strong) {
+    Color weak = (strong == WHITE) ? BLACK : WHITE;
+    Square strong_king = get_king_square(board, strong);
+    Square weak_king = get_king_square(board, weak);
+    
+    int score = 0;
+    for (int piece_type = PAWN; piece_type <= QUEEN; piece_type++) {
+        score += popcount(board->pieces[strong][piece_type]) * piece_value(piece_type);
+    }
+    
+    // Drive the lone king to the edge and follow it with ours
+    score += edge_distance_bonus(weak_king) * 20;
+    score += (7 - square_distance(strong_king, weak_king)) * 10;
+    
+    // Mating material: heavy piece, bishop and knight, or bishops on both colors
+    Bitboard bishops = board->pieces[strong][BISHOP];
+    bool both_colors = (bishops & DARK_SQUARES) && (bishops & ~DARK_SQUARES);
+    if (board->pieces[strong][QUEEN] || board->pieces[strong][ROOK] || both_colors ||
+        (board->pieces[strong][BISHOP] && board->pieces[strong][KNIGHT])) {
+        score += KNOWN_WIN;
+    }
+    
+    return from_white(score, strong);
+}
+
+int evaluate_kbnk(const Board* board, Color strong) {
+    Color weak = (strong == WHITE) ? BLACK : WHITE;
+    Square strong_king = get_king_square(board, strong);
+    Square weak_king = get_king_square(board, weak);
+    Square bishop = lsb(board->pieces[strong][BISHOP]);
+    
+    // Mate is only possible in a corner of the bishop's color
+    Square corner_a = is_dark_square(bishop) ? A1 : A8;
+    Square corner_b = is_dark_square(bishop) ? H8 : H1;
+    int corner = manhattan_distance(weak_king, corner_a);
+    if (manhattan_distance(weak_king, corner_b) < corner) {
+        corner = manhattan_distance(weak_king, corner_b);
+    }
+    
+    int score = KNOWN_WIN + KNIGHT_VALUE + BISHOP_VALUE;
+    score += (14 - corner) * 20;
+    score += (7 - square_distance(strong_king, weak_king)) * 10;
+    return from_white(score, strong);
+}
+
+int evaluate_krkp(const Board* board, Color strong) {
+    Color weak = (strong == WHITE) ? BLACK : WHITE;
+    
+    // From the strong side's view: the pawn runs down the board towards rank 1
+    Square strong_king = relative_square(strong, get_king_square(board, strong));
+    Square weak_king = relative_square(strong, get_king_square(board, weak));
+    Square rook = relative_square(strong, lsb(board->pieces[strong][ROOK]));
+    Square pawn = relative_square(strong, lsb(board->pieces[weak][PAWN]));
+    Square stop = pawn - 8;
+    Square queening = make_square(0, square_file(pawn));
+    int strong_to_move = board->side_to_move == strong;
+    int score;
+    
+    if (square_file(strong_king) == square_file(pawn) && square_rank(strong_king) < square_rank(pawn)) {
+        // Our king stands in front of the pawn
+        score = ROOK_VALUE - square_distance(strong_king, pawn);
+    } else if (square_distance(weak_king, pawn) >= 3 + !strong_to_move &&
+               square_distance(weak_king, rook) >= 3) {
+        // Their king is too far from the pawn and the rook
+        score = ROOK_VALUE - square_distance(strong_king, pawn);
+    } else if (square_rank(weak_king) <= 2 && square_distance(weak_king, pawn) == 1 &&
+               square_rank(strong_king) >= 3 && square_distance(strong_king, pawn) > 2 + strong_to_move) {
+        // Advanced pawn next to its king while ours is far away: usually a draw
+        score = 80 - 8 * square_distance(strong_king, pawn);
+    } else {
+        score = 200 - 8 * (square_distance(strong_king, stop) - square_distance(weak_king, stop) -
+                           square_distance(pawn, queening));
+    }
+    
+    return from_white(score, strong);
+}
+
+int evaluate_kpk(const Board* board, Color strong) {
+    // Exact result from the bitbase; wins rise as the pawn advances
+    if (!kpk_is_win(board, strong)) {
+        return 0;
+    }
+    Square pawn = relative_square(strong, lsb(board->pieces[strong][PAWN]));
+    return from_white(KNOWN_WIN + PAWN_VALUE + square_rank(pawn) * 20, strong);
+}
+
+
+// Scale Factors
+
+int scale_opposite_bishops(const Board* board, Color strong) {
+    (void)strong;
+    Square white_bishop = lsb(board->pieces[WHITE][BISHOP]);
+    Square black_bishop = lsb(board->pieces[BLACK][BISHOP]);
+    if (is_dark_square(white_bishop) == is_dark_square(black_bishop)) {
+        return SCALE_NORMAL;
+    }
+    
+    // Bishops of opposite colors with only pawns besides: drawish even a pawn or two up
+    int pawn_difference = abs(popcount(board->pieces[WHITE][PAWN]) - popcount(board->pieces[BLACK][PAWN]));
+    return (pawn_difference <= 1) ? 16 : 32;
+}
@@ -0,0 +1,24 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "types.h"
+#include "board.h"
+
+// Specialised endgame knowledge, selected by the material table (material.h)
+
+// Score for a won endgame: above any normal evaluation, well below mate scores
+#define KNOWN_WIN 10000
+
+// Evaluators (White's point of view); strong is the side with the extra material
+int evaluate_kxk(const Board* board, Color strong);   // Enough material against a lone king
+int evaluate_kbnk(const Board* board, Color strong);  // Mate with bishop and knight
+int evaluate_krkp(const Board* board, Color strong);  // Rook against pawn
+int evaluate_kpk(const Board* board, Color strong);   // King and pawn against king (bitbase)
+
+// Scale factors (0..SCALE_NORMAL)
+int scale_opposite_bishops(const Board* board, Color strong);
+
+// Square seen from a color's side of the board (rank 1 is that color's back rank)
+Square relative_square(Color color, Square sq);
+
+#endif // ENDGAME_H
@@ -1,87 +1,138 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "evaluation.h"
+#include "bitbase.h"
 #include "bitboard.h"
 #include "board.h"
+#include "material.h"
 #include "movegen.h"
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 // Piece-Square Tables (from White's perspective)
 
-int pawn_pst[64] = {
-      0,   0,   0,   0,   0,   0,   0,   0,
-     50,  50,  50,  50,  50,  50,  50,  50,
-     10,  10,  20,  30,  30,  20,  10,  10,
-      5,   5,  10,  25,  25,  10,   5,   5,
-      0,   0,   0,  20,  20,   0,   0,   0,
-      5,  -5, -10,   0,   0, -10,  -5,   5,
-      5,  10,  10, -20, -20,  10,  10,   5,
-      0,   0,   0,   0,   0,   0,   0,   0
-};
+// Rows of each table, shared by the arrays below and the default parameters
+#define PAWN_PST \
+    (  0,   0,   0,   0,   0,   0,   0,   0), \
+    ( 50,  50,  50,  50,  50,  50,  50,  50), \
+    ( 10,  10,  20,  30,  30,  20,  10,  10), \
+    (  5,   5,  10,  25,  25,  10,   5,   5), \
+    (  0,   0,   0,  20,  20,   0,   0,   0), \
+    (  5,  -5, -10,   0,   0, -10,  -5,   5), \
+    (  5,  10,  10, -20, -20,  10,  10,   5), \
+    (  0,   0,   0,   0,   0,   0,   0,   0)
 
-int knight_pst[64] = {
-    -50, -40, -30, -30, -30, -30, -40, -50,
-    -40, -20,   0,   0,   0,   0, -20, -40,
-    -30,   0,  10,  15,  15,  10,   0, -30,
-    -30,   5,  15,  20,  20,  15,   5, -30,
-    -30,   0,  15,  20,  20,  15,   0, -30,
-    -30,   5,  10,  15,  15,  10,   5, -30,
-    -40, -20,   0,   5,   5,   0, -20, -40,
-    -50, -40, -30, -30, -30, -30, -40, -50
-};
+#define KNIGHT_PST \
+    (-50, -40, -30, -30, -30, -30, -40, -50), \
+    (-40, -20,   0,   0,   0,   0, -20, -40), \
+    (-30,   0,  10,  15,  15,  10,   0, -30), \
+    (-30,   5,  15,  20,  20,  15,   5, -30), \
+    (-30,   0,  15,  20,  20,  15,   0, -30), \
+    (-30,   5,  10,  15,  15,  10,   5, -30), \
+    (-40, -20,   0,   5,   5,   0, -20, -40), \
+    (-50, -40, -30, -30, -30, -30, -40, -50)
 
-int bishop_pst[64] = {
-    -20, -10, -10, -10, -10, -10, -10, -20,
-    -10,   0,   0,   0,   0,   0,   0, -10,
-    -10,   0,   5,  10,  10,   5,   0, -10,
-    -10,   5,   5,  10,  10,   5,   5, -10,
-    -10,   0,  10,  10,  10,  10,   0, -10,
-    -10,  10,  10,  10,  10,  10,  10, -10,
-    -10,   5,   0,   0,   0,   0,   5, -10,
-    -20, -10, -10, -10, -10, -10, -10, -20
-};
+#define BISHOP_PST \
+    (-20, -10, -10, -10, -10, -10, -10, -20), \
+    (-10,   0,   0,   0,   0,   0,   0, -10), \
+    (-10,   0,   5,  10,  10,   5,   0, -10), \
+    (-10,   5,   5,  10,  10,   5,   5, -10), \
+    (-10,   0,  10,  10,  10,  10,   0, -10), \
+    (-10,  10,  10,  10,  10,  10,  10, -10), \
+    (-10,   5,   0,   0,   0,   0,   5, -10), \
+    (-20, -10, -10, -10, -10, -10, -10, -20)
 
-int rook_pst[64] = {
-      0,   0,   0,   0,   0,   0,   0,   0,
-      5,  10,  10,  10,  10,  10,  10,   5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-      0,   0,   0,   5,   5,   0,   0,   0
-};
+#define ROOK_PST \
+    (  0,   0,   0,   0,   0,   0,   0,   0), \
+    (  5,  10,  10,  10,  10,  10,  10,   5), \
+    ( -5,   0,   0,   0,   0,   0,   0,  -5), \
+    ( -5,   0,   0,   0,   0,   0,   0,  -5), \
+    ( -5,   0,   0,   0,   0,   0,   0,  -5), \
+    ( -5,   0,   0,   0,   0,   0,   0,  -5), \
+    ( -5,   0,   0,   0,   0,   0,   0,  -5), \
+    (  0,   0,   0,   5,   5,   0,   0,   0)
 
-int queen_pst[64] = {
-    -20, -10, -10,  -5,  -5, -10, -10, -20,
-    -10,   0,   0,   0,   0,   0,   0, -10,
-    -10,   0,   5,   5,   5,   5,   0, -10,
-     -5,   0,   5,   5,   5,   5,   0,  -5,
-      0,   0,   5,   5,   5,   5,   0,  -5,
-    -10,   5,   5,   5,   5,   5,   0, -10,
-    -10,   0,   5,   0,   0,   0,   0, -10,
-    -20, -10, -10,  -5,  -5, -10, -10, -20
-};
+#define QUEEN_PST \
+    (-20, -10, -10,  -5,  -5, -10, -10, -20), \
+    (-10,   0,   0,   0,   0,   0,   0, -10), \
+    (-10,   0,   5,   5,   5,   5,   0, -10), \
+    ( -5,   0,   5,   5,   5,   5,   0,  -5), \
+    (  0,   0,   5,   5,   5,   5,   0,  -5), \
+    (-10,   5,   5,   5,   5,   5,   0, -10), \
+    (-10,   0,   5,   0,   0,   0,   0, -10), \
+    (-20, -10, -10,  -5,  -5, -10, -10, -20)
 
-int king_pst_midgame[64] = {
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -20, -30, -30, -40, -40, -30, -30, -20,
-    -10, -20, -20, -20, -20, -20, -20, -10,
-     20,  20,   0,   0,   0,   0,  20,  20,
-     20,  30,  10,   0,   0,  10,  30,  20
-};
+#define KING_PST_MIDGAME \
+    (-30, -40, -40, -50, -50, -40, -40, -30), \
+    (-30, -40, -40, -50, -50, -40, -40, -30), \
+    (-30, -40, -40, -50, -50, -40, -40, -30), \
+    (-30, -40, -40, -50, -50, -40, -40, -30), \
+    (-20, -30, -30, -40, -40, -30, -30, -20), \
+    (-10, -20, -20, -20, -20, -20, -20, -10), \
+    ( 20,  20,   0,   0,   0,   0,  20,  20), \
+    ( 20,  30,  10,   0,   0,  10,  30,  20)
 
-int king_pst_endgame[64] = {
-    -50, -40, -30, -20, -20, -30, -40, -50,
-    -30, -20, -10,   0,   0, -10, -20, -30,
-    -30, -10,  20,  30,  30,  20, -10, -30,
-    -30, -10,  30,  40,  40,  30, -10, -30,
-    -30, -10,  30,  40,  40,  30, -10, -30,
-    -30, -10,  20,  30,  30,  20, -10, -30,
-    -30, -30,   0,   0,   0,   0, -30, -30,
-    -50, -30, -30, -30, -30, -30, -30, -50
-};
+#define KING_PST_ENDGAME \
+    (-50, -40, -30, -20, -20, -30, -40, -50), \
+    (-30, -20, -10,   0,   0, -10, -20, -30), \
+    (-30, -10,  20,  30,  30,  20, -10, -30), \
+    (-30, -10,  30,  40,  40,  30, -10, -30), \
+    (-30, -10,  30,  40,  40,  30, -10, -30), \
+    (-30, -10,  20,  30,  30,  20, -10, -30), \
+    (-30, -30,   0,   0,   0,   0, -30, -30), \
+    (-50, -30, -30, -30, -30, -30, -30, -50)
+
+// A table's 64 values as written, or negated with the ranks mirrored (Black's signed table)
+#define PST_ROW(a, b, c, d, e, f, g, h) a, b, c, d, e, f, g, h
+#define PST_NEGATED_ROW(a, b, c, d, e, f, g, h) -(a), -(b), -(c), -(d), -(e), -(f), -(g), -(h)
+#define PST_WHITE_ROWS(r0, r1, r2, r3, r4, r5, r6, r7) \
+    PST_ROW r0, PST_ROW r1, PST_ROW r2, PST_ROW r3, PST_ROW r4, PST_ROW r5, PST_ROW r6, PST_ROW r7
+#define PST_BLACK_ROWS(r0, r1, r2, r3, r4, r5, r6, r7) \
+    PST_NEGATED_ROW r7, PST_NEGATED_ROW r6, PST_NEGATED_ROW r5, PST_NEGATED_ROW r4, \
+    PST_NEGATED_ROW r3, PST_NEGATED_ROW r2, PST_NEGATED_ROW r1, PST_NEGATED_ROW r0
+#define PST_WHITE(table) PST_WHITE_ROWS(table)
+#define PST_BLACK(table) PST_BLACK_ROWS(table)
+
+int pawn_pst[64] = { PST_WHITE(PAWN_PST) };
+int knight_pst[64] = { PST_WHITE(KNIGHT_PST) };
+int bishop_pst[64] = { PST_WHITE(BISHOP_PST) };
+int rook_pst[64] = { PST_WHITE(ROOK_PST) };
+int queen_pst[64] = { PST_WHITE(QUEEN_PST) };
+int king_pst_midgame[64] = { PST_WHITE(KING_PST_MIDGAME) };
+int king_pst_endgame[64] = { PST_WHITE(KING_PST_ENDGAME) };
+
+// Compiled-in parameters, derived tables included, so evaluate() works before init_evaluation()
+#define DEFAULT_EVAL_PARAMS { \
+    .material = { PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE }, \
+    .pst_mg = { { PST_WHITE(PAWN_PST) }, { PST_WHITE(KNIGHT_PST) }, { PST_WHITE(BISHOP_PST) }, \
+                { PST_WHITE(ROOK_PST) }, { PST_WHITE(QUEEN_PST) }, { PST_WHITE(KING_PST_MIDGAME) } }, \
+    .pst_eg = { { PST_WHITE(PAWN_PST) }, { PST_WHITE(KNIGHT_PST) }, { PST_WHITE(BISHOP_PST) }, \
+                { PST_WHITE(ROOK_PST) }, { PST_WHITE(QUEEN_PST) }, { PST_WHITE(KING_PST_ENDGAME) } }, \
+    .doubled_pawn = -10, \
+    .isolated_pawn = -15, \
+    .king_open_file = -20, \
+    .mobility = 128,            /* Half a centipawn per move */ \
+    .lazy_margin = 150,         /* Above any realistic mobility term, so the search is unchanged */ \
+    .psq_mg = { \
+        { { PST_WHITE(PAWN_PST) }, { PST_WHITE(KNIGHT_PST) }, { PST_WHITE(BISHOP_PST) }, \
+          { PST_WHITE(ROOK_PST) }, { PST_WHITE(QUEEN_PST) }, { PST_WHITE(KING_PST_MIDGAME) } }, \
+        { { PST_BLACK(PAWN_PST) }, { PST_BLACK(KNIGHT_PST) }, { PST_BLACK(BISHOP_PST) }, \
+          { PST_BLACK(ROOK_PST) }, { PST_BLACK(QUEEN_PST) }, { PST_BLACK(KING_PST_MIDGAME) } } }, \
+    .psq_eg = { \
+        { { PST_WHITE(PAWN_PST) }, { PST_WHITE(KNIGHT_PST) }, { PST_WHITE(BISHOP_PST) }, \
+          { PST_WHITE(ROOK_PST) }, { PST_WHITE(QUEEN_PST) }, { PST_WHITE(KING_PST_ENDGAME) } }, \
+        { { PST_BLACK(PAWN_PST) }, { PST_BLACK(KNIGHT_PST) }, { PST_BLACK(BISHOP_PST) }, \
+          { PST_BLACK(ROOK_PST) }, { PST_BLACK(QUEEN_PST) }, { PST_BLACK(KING_PST_ENDGAME) } } } \
+}
+
+static const EvalParams default_params = DEFAULT_EVAL_PARAMS;
+
+// Active parameters: the defaults until set_eval_params()
+EvalParams eval_params = DEFAULT_EVAL_PARAMS;
+unsigned eval_params_generation;
 
 
 // Utility Functions
@@ -141,152 +192,456 @@ int evaluate_material(const Board* board) {
     for (int piece_type = PAWN; piece_type <= QUEEN; piece_type++) {
         int white_count = popcount(board->pieces[WHITE][piece_type]);
         int black_count = popcount(board->pieces[BLACK][piece_type]);
-        score += (white_count - black_count) * piece_value(piece_type);
+        score += (white_count - black_count) * eval_params.material[piece_type];
     }
     
     return score;
 }
 
-int evaluate_piece_square(const Board* board) {
+// Piece-square sum tapered by the given phase
+static int piece_square_score(const Board* board, int phase) {
     int mg_score = 0;
     int eg_score = 0;
     
-    int* pst_tables[6] = {pawn_pst, knight_pst, bishop_pst, rook_pst, queen_pst, king_pst_midgame};
-    
-    for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
-        Bitboard white_pieces = board->pieces[WHITE][piece_type];
-        while (white_pieces) {
-            Square sq = pop_lsb(&white_pieces);
-            
-            if (piece_type == KING) {
-                mg_score += king_pst_midgame[sq];
-                eg_score += king_pst_endgame[sq];
-            } else {
-                mg_score += pst_tables[piece_type][sq];
-                eg_score += pst_tables[piece_type][sq];
-            }
-        }
-        
-        Bitboard black_pieces = board->pieces[BLACK][piece_type];
-        while (black_pieces) {
-            Square sq = pop_lsb(&black_pieces);
-            Square mirrored = mirror_square(sq);
+    // Tables are pre-combined per color, so no mirroring or sign flips here
+    for (int color = WHITE; color <= BLACK; color++) {
+        for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+            const int* mg_table = eval_params.psq_mg[color][piece_type];
+            const int* eg_table = eval_params.psq_eg[color][piece_type];
+            Bitboard pieces = board->pieces[color][piece_type];
             
-            if (piece_type == KING) {
-                mg_score -= king_pst_midgame[mirrored];
-                eg_score -= king_pst_endgame[mirrored];
-            } else {
-                mg_score -= pst_tables[piece_type][mirrored];
-                eg_score -= pst_tables[piece_type][mirrored];
+            while (pieces) {
+                Square sq = pop_lsb(&pieces);
+                mg_score += mg_table[sq];
+                eg_score += eg_table[sq];
             }
         }
     }
     
     // Taper between midgame and endgame
-    int phase = get_game_phase(board);
     return tapered_eval(mg_score, eg_score, phase);
 }
 
-int evaluate_mobility(const Board* board) {
-    MoveList white_moves, black_moves;
-    
-    // Count mobility
+int evaluate_piece_square(const Board* board) {
+    return piece_square_score(board, get_game_phase(board));
+}
+
+// Generated moves of one side, as if it were to move
+static int count_mobility(const Board* board, Color color) {
+    MoveList moves;
     Board temp;
     copy_board(&temp, board);
-    temp.side_to_move = WHITE;
-    generate_moves(&temp, &white_moves);
-    
-    copy_board(&temp, board);
-    temp.side_to_move = BLACK;
-    generate_moves(&temp, &black_moves);
-    
+    temp.side_to_move = color;
+    generate_moves(&temp, &moves);
+    return moves.count;
+}
+
+int evaluate_mobility(const Board* board) {
     // Mobility bonus (1 centipawn per move)
-    return white_moves.count - black_moves.count;
+    return count_mobility(board, WHITE) - count_mobility(board, BLACK);
 }
 
-int evaluate_pawn_structure(const Board* board) {
+// Doubled and isolated pawn terms of one side (weights are signed, so this is usually <= 0)
+static int pawn_structure_of(const Board* board, Color color) {
+    Bitboard pawns = board->pieces[color][PAWN];
     int score = 0;
     
-    // Doubled pawns penalty
     for (int file = 0; file < 8; file++) {
         Bitboard fmask = file_mask(file);
-        
-        int white_pawns = popcount(board->pieces[WHITE][PAWN] & fmask);
-        int black_pawns = popcount(board->pieces[BLACK][PAWN] & fmask);
-        
-        if (white_pawns > 1) score -= (white_pawns - 1) * 10;
-        if (black_pawns > 1) score += (black_pawns - 1) * 10;
+        int count = popcount(pawns & fmask);
+        if (count > 1) score += (count - 1) * eval_params.doubled_pawn;
     }
     
-    // Isolated pawns penalty (simplified)
+    // Isolated pawns (simplified: once per file)
     for (int file = 0; file < 8; file++) {
-        Bitboard fmask = file_mask(file);
         Bitboard adjacent_files = 0ULL;
         if (file > 0) adjacent_files |= file_mask(file - 1);
         if (file < 7) adjacent_files |= file_mask(file + 1);
         
-        // White isolated pawns
-        if ((board->pieces[WHITE][PAWN] & fmask) && !(board->pieces[WHITE][PAWN] & adjacent_files)) {
-            score -= 15;
-        }
-        
-        // Black isolated pawns
-        if ((board->pieces[BLACK][PAWN] & fmask) && !(board->pieces[BLACK][PAWN] & adjacent_files)) {
-            score += 15;
+        if ((pawns & file_mask(file)) && !(pawns & adjacent_files)) {
+            score += eval_params.isolated_pawn;
         }
     }
     
     return score;
 }
 
+int evaluate_pawn_structure(const Board* board) {
+    return pawn_structure_of(board, WHITE) - pawn_structure_of(board, BLACK);
+}
+
+// King file term of one side
+static int king_safety_of(const Board* board, Color color) {
+    Square king = get_king_square(board, color);
+    if (king == NO_SQUARE) {
+        return 0;
+    }
+    
+    // Penalty for king on open file (no pawns)
+    Bitboard fmask = file_mask(square_file(king));
+    if (!((board->pieces[WHITE][PAWN] | board->pieces[BLACK][PAWN]) & fmask)) {
+        return eval_params.king_open_file;
+    }
+    return 0;
+}
+
 int evaluate_king_safety(const Board* board) {
-    int score = 0;
+    return king_safety_of(board, WHITE) - king_safety_of(board, BLACK);
+}
+
+
+// Term Profiling
+// Built with -DEVAL_PROFILE (make profile); otherwise EVAL_TIMED only runs its statement
+
+#ifdef EVAL_PROFILE
+
+static _Thread_local EvalProfile profile;
+
+static inline uint64_t read_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Runs the statement and charges its cycles to the term
+#define EVAL_TIMED(term, ...) do { \
+    uint64_t start_ = read_cycles(); \
+    __VA_ARGS__; \
+    profile.cycles[term] += read_cycles() - start_; \
+    profile.calls[term]++; \
+} while (0)
+#define EVAL_LAZY_EXIT() (profile.lazy_exits++)
+
+void reset_eval_profile(void) {
+    memset(&profile, 0, sizeof(profile));
+}
+
+void get_eval_profile(EvalProfile* out) {
+    *out = profile;
+}
+
+#else
+
+#define EVAL_TIMED(term, ...) do { __VA_ARGS__; } while (0)
+#define EVAL_LAZY_EXIT() ((void)0)
+
+#endif
+
+
+// Evaluation Cache
+
+// The low 16 bits of an entry hold the score, the rest must match the hash
+#define EVAL_CACHE_KEY_MASK 0xFFFFFFFFFFFF0000ULL
+
+static _Atomic uint64_t* eval_cache;
+static size_t eval_cache_size;  // Entries, a power of 2 (0 = disabled)
+static _Thread_local EvalCacheStats cache_stats;
+
+bool init_eval_cache(size_t size_mb) {
+    free_eval_cache();
     
-    // Simple king safety: penalize king on open files
-    Square white_king = get_king_square(board, WHITE);
-    Square black_king = get_king_square(board, BLACK);
+    size_t entries = size_mb * 1024 * 1024 / sizeof(uint64_t);
+    if (entries == 0) {
+        return true;
+    }
     
-    if (white_king != NO_SQUARE) {
-        int file = square_file(white_king);
-        Bitboard fmask_w = file_mask(file);
-        
-        // Penalty for king on open file (no pawns)
-        if (!(board->pieces[WHITE][PAWN] & fmask_w) &&
-            !(board->pieces[BLACK][PAWN] & fmask_w)) {
-            score -= 20;
-        }
+    size_t size = 1;
+    while (size * 2 <= entries) size *= 2;
+    eval_cache = calloc(size, sizeof(uint64_t));
+    if (!eval_cache) {
+        return false;
+    }
+    eval_cache_size = size;
+    return true;
+}
+
+void free_eval_cache(void) {
+    free((void*)eval_cache);
+    eval_cache = NULL;
+    eval_cache_size = 0;
+}
+
+void clear_eval_cache(void) {
+    // Entry by entry, so searches running on other threads may keep using the cache
+    for (size_t i = 0; i < eval_cache_size; i++) {
+        atomic_store_explicit(&eval_cache[i], 0, memory_order_relaxed);
+    }
+}
+
+size_t eval_cache_entries(void) {
+    return eval_cache_size;
+}
+
+void get_eval_cache_stats(EvalCacheStats* stats) {
+    *stats = cache_stats;
+}
+
+void reset_eval_cache_stats(void) {
+    memset(&cache_stats, 0, sizeof(cache_stats));
+}
+
+static inline bool probe_eval_cache(uint64_t hash, int* score) {
+    if (!eval_cache_size) {
+        return false;
     }
     
-    if (black_king != NO_SQUARE) {
-        int file = square_file(black_king);
-        Bitboard fmask_b = file_mask(file);
-        
-        if (!(board->pieces[WHITE][PAWN] & fmask_b) &&
-            !(board->pieces[BLACK][PAWN] & fmask_b)) {
-            score += 20;
-        }
+    cache_stats.probes++;
+    uint64_t entry = atomic_load_explicit(&eval_cache[hash & (eval_cache_size - 1)], memory_order_relaxed);
+    if ((entry ^ hash) & EVAL_CACHE_KEY_MASK) {
+        return false;
     }
     
-    return score;
+    cache_stats.hits++;
+    *score = (int16_t)(uint16_t)entry;
+    return true;
+}
+
+static inline void store_eval_cache(uint64_t hash, int score) {
+    if (eval_cache_size) {
+        uint64_t entry = (hash & EVAL_CACHE_KEY_MASK) | (uint16_t)(int16_t)score;
+        atomic_store_explicit(&eval_cache[hash & (eval_cache_size - 1)], entry, memory_order_relaxed);
+    }
 }
 
 
 // Main Evaluation Function
 
 int evaluate(const Board* board) {
-    int score = 0;
-    score += evaluate_material(board);
-    score += evaluate_piece_square(board);
-    score += evaluate_mobility(board) / 2;  // Lighter, so we divide by 2
-    score += evaluate_pawn_structure(board);
-    score += evaluate_king_safety(board);
-    return (board->side_to_move == WHITE) ? score : -score;
+    // An infinite window never stops early
+    return evaluate_window(board, -INFINITE, INFINITE);
+}
+
+int evaluate_window(const Board* board, int alpha, int beta) {
+    int cached;
+    if (probe_eval_cache(board->hash, &cached)) {
+        return cached;
+    }
+    
+    const MaterialEntry* entry;
+    EVAL_TIMED(EVAL_MATERIAL, entry = probe_material(board));
+    int sign = (board->side_to_move == WHITE) ? 1 : -1;
+    
+    // Known endgames replace the evaluation
+    if (entry->endgame) {
+        int score = sign * entry->endgame(board, entry->strong);
+        store_eval_cache(board->hash, score);
+        return score;
+    }
+    
+    int score = entry->material;
+    EVAL_TIMED(EVAL_PIECE_SQUARE, score += piece_square_score(board, entry->phase));
+    EVAL_TIMED(EVAL_PAWNS, score += evaluate_pawn_structure(board));
+    EVAL_TIMED(EVAL_KING_SAFETY, score += evaluate_king_safety(board));
+    
+    // Mobility is by far the most expensive term; skip it when it cannot bring the score into the
+    // window, nor change the side favoured, whose scale factor applies. Partial scores are not cached.
+    if (abs(score) >= eval_params.lazy_margin) {
+        int partial = sign * score * material_scale(entry, board, score >= 0 ? WHITE : BLACK) / SCALE_NORMAL;
+        if (partial - eval_params.lazy_margin >= beta || partial + eval_params.lazy_margin <= alpha) {
+            EVAL_LAZY_EXIT();
+            return partial;
+        }
+    }
+    
+    EVAL_TIMED(EVAL_MOBILITY, score += evaluate_mobility(board) * eval_params.mobility / 256);
+    
+    // Scale factor of the side the whole evaluation favours
+    score = sign * score * material_scale(entry, board, score >= 0 ? WHITE : BLACK) / SCALE_NORMAL;
+    store_eval_cache(board->hash, score);
+    return score;
+}
+
+
+// Evaluation Trace
+
+const char* eval_term_names[EVAL_TERM_COUNT] = {
+    "Material", "Piece-square", "Mobility", "Pawns", "King safety"
+};
+
+void trace_evaluate(const Board* board, EvalTrace* trace) {
+    memset(trace, 0, sizeof(EvalTrace));
+    
+    for (int color = WHITE; color <= BLACK; color++) {
+        // Per-side values from that side's point of view (Black's tables are stored negated)
+        int sign = (color == WHITE) ? 1 : -1;
+        for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+            Bitboard pieces = board->pieces[color][piece_type];
+            if (piece_type != KING) {
+                trace->material[color] += popcount(pieces) * eval_params.material[piece_type];
+            }
+            while (pieces) {
+                Square sq = pop_lsb(&pieces);
+                trace->pst_mg[color] += sign * eval_params.psq_mg[color][piece_type][sq];
+                trace->pst_eg[color] += sign * eval_params.psq_eg[color][piece_type][sq];
+            }
+        }
+        trace->mobility[color] = count_mobility(board, color);
+        trace->pawns[color] = pawn_structure_of(board, color);
+        trace->king_safety[color] = king_safety_of(board, color);
+    }
+    
+    // Net terms combined exactly as evaluate() does
+    const MaterialEntry* entry = probe_material(board);
+    trace->phase = entry->phase;
+    trace->terms[EVAL_MATERIAL] = trace->material[WHITE] - trace->material[BLACK];
+    trace->terms[EVAL_PIECE_SQUARE] = tapered_eval(trace->pst_mg[WHITE] - trace->pst_mg[BLACK],
+                                                   trace->pst_eg[WHITE] - trace->pst_eg[BLACK], trace->phase);
+    trace->terms[EVAL_MOBILITY] = (trace->mobility[WHITE] - trace->mobility[BLACK]) * eval_params.mobility / 256;
+    trace->terms[EVAL_PAWNS] = trace->pawns[WHITE] - trace->pawns[BLACK];
+    trace->terms[EVAL_KING_SAFETY] = trace->king_safety[WHITE] - trace->king_safety[BLACK];
+    
+    for (int term = 0; term < EVAL_TERM_COUNT; term++) {
+        trace->total += trace->terms[term];
+    }
+    trace->scale = material_scale(entry, board, trace->total >= 0 ? WHITE : BLACK);
+    trace->total = trace->total * trace->scale / SCALE_NORMAL;
+    
+    // A known endgame replaces the terms
+    if (entry->endgame) {
+        trace->endgame = true;
+        trace->scale = SCALE_NORMAL;
+        trace->total = entry->endgame(board, entry->strong);
+    }
 }
 
 
 // Initialization
 
 void init_evaluation(void) {
-    // Tables are statically initialized, nothing to do
-    // This function is provided for future extensions, just in case
+    init_kpk_bitbase();
+    
+    EvalParams params;
+    default_eval_params(&params);
+    set_eval_params(&params);
+}
+
+
+// Parameter Sets
+
+// Names used in parameter files, indexed by piece type
+static const char* piece_names[6] = { "pawn", "knight", "bishop", "rook", "queen", "king" };
+
+void default_eval_params(EvalParams* params) {
+    *params = default_params;
+}
+
+void set_eval_params(const EvalParams* params) {
+    EvalParams combined = *params;
+    
+    for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+        for (int sq = 0; sq < 64; sq++) {
+            combined.psq_mg[WHITE][piece_type][sq] = params->pst_mg[piece_type][sq];
+            combined.psq_eg[WHITE][piece_type][sq] = params->pst_eg[piece_type][sq];
+            combined.psq_mg[BLACK][piece_type][sq] = -params->pst_mg[piece_type][mirror_square(sq)];
+            combined.psq_eg[BLACK][piece_type][sq] = -params->pst_eg[piece_type][mirror_square(sq)];
+        }
+    }
+    
+    eval_params = combined;
+    eval_params_generation++;
+    clear_eval_cache();
+}
+
+// Reads count integers after a name; false if the file ends early
+static bool read_values(FILE* file, int* values, int count) {
+    for (int i = 0; i < count; i++) {
+        if (fscanf(file, "%d", &values[i]) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool load_eval_params(EvalParams* params, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    
+    // Entries not present in the file keep the defaults
+    default_eval_params(params);
+    
+    char name[64];
+    bool ok = true;
+    while (ok && fscanf(file, "%63s", name) == 1) {
+        if (name[0] == '#') {
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n');
+            continue;
+        }
+        
+        bool known = false;
+        if (strcmp(name, "material") == 0) {
+            ok = read_values(file, params->material, 5);
+            known = true;
+        }
+        for (int piece_type = PAWN; piece_type <= KING && !known; piece_type++) {
+            char mg_name[32], eg_name[32];
+            snprintf(mg_name, sizeof(mg_name), "pst_mg_%s", piece_names[piece_type]);
+            snprintf(eg_name, sizeof(eg_name), "pst_eg_%s", piece_names[piece_type]);
+            if (strcmp(name, mg_name) == 0) {
+                ok = read_values(file, params->pst_mg[piece_type], 64);
+                known = true;
+            } else if (strcmp(name, eg_name) == 0) {
+                ok = read_values(file, params->pst_eg[piece_type], 64);
+                known = true;
+            }
+        }
+        if (!known) {
+            int* value = NULL;
+            if (strcmp(name, "doubled_pawn") == 0) value = &params->doubled_pawn;
+            else if (strcmp(name, "isolated_pawn") == 0) value = &params->isolated_pawn;
+            else if (strcmp(name, "king_open_file") == 0) value = &params->king_open_file;
+            else if (strcmp(name, "mobility") == 0) value = &params->mobility;
+            else if (strcmp(name, "lazy_margin") == 0) value = &params->lazy_margin;
+            ok = value && read_values(file, value, 1);
+        }
+    }
+    
+    fclose(file);
+    return ok;
+}
+
+static void save_table(FILE* file, const char* name, const int* table) {
+    fprintf(file, "%s\n", name);
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            fprintf(file, "%5d", table[row * 8 + col]);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+bool save_eval_params(const EvalParams* params, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    
+    fprintf(file, "# Zugzwang evaluation parameters (centipawns, White's perspective)\n");
+    fprintf(file, "# Tables are indexed like pawn_pst in evaluation.c: a1..h1 first\n");
+    fprintf(file, "material %d %d %d %d %d\n", params->material[PAWN], params->material[KNIGHT],
+            params->material[BISHOP], params->material[ROOK], params->material[QUEEN]);
+    
+    for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+        char name[32];
+        snprintf(name, sizeof(name), "pst_mg_%s", piece_names[piece_type]);
+        save_table(file, name, params->pst_mg[piece_type]);
+        snprintf(name, sizeof(name), "pst_eg_%s", piece_names[piece_type]);
+        save_table(file, name, params->pst_eg[piece_type]);
+    }
+    
+    fprintf(file, "doubled_pawn %d\n", params->doubled_pawn);
+    fprintf(file, "isolated_pawn %d\n", params->isolated_pawn);
+    fprintf(file, "king_open_file %d\n", params->king_open_file);
+    fprintf(file, "# 1/256 centipawn per legal move\n");
+    fprintf(file, "mobility %d\n", params->mobility);
+    fprintf(file, "# Lazy evaluation margin (centipawns)\n");
+    fprintf(file, "lazy_margin %d\n", params->lazy_margin);
+    
+    return fclose(file) == 0;
 }
@@ -3,13 +3,50 @@
 
 #include "types.h"
 #include "board.h"
+#include <stddef.h>
+
+// Evaluation parameters (all weights from White's perspective)
+typedef struct {
+    int material[5];            // Pawn..queen values
+    int pst_mg[6][64];          // Midgame piece-square tables, indexed like pawn_pst
+    int pst_eg[6][64];          // Endgame piece-square tables
+    int doubled_pawn;           // Per extra pawn on a file (negative = penalty)
+    int isolated_pawn;          // Per file holding isolated pawns
+    int king_open_file;         // King on a file without pawns
+    int mobility;               // Per legal move, in 1/256 centipawn
+    int lazy_margin;            // evaluate_window() skips mobility beyond this distance from the window
+    
+    // Derived by set_eval_params(): signed tables by color with Black's squares mirrored
+    int psq_mg[2][6][64];
+    int psq_eg[2][6][64];
+} EvalParams;
+
+// Parameters used by evaluate(); the generation changes with every set_eval_params()
+extern EvalParams eval_params;
+extern unsigned eval_params_generation;
 
 // Main evaluation function (returns score from side-to-move perspective)
 int evaluate(const Board* board);
 
+// Lazy evaluation for a (alpha, beta) window: the cheap terms first, and mobility only
+// when they end within lazy_margin of the window. Outside it, the partial score is returned.
+int evaluate_window(const Board* board, int alpha, int beta);
+
 // Evaluation components (function pointers used here)
 typedef int (*EvalFunc)(const Board*);
 
+// Terms of evaluate(), in evaluation order
+typedef enum {
+    EVAL_MATERIAL,
+    EVAL_PIECE_SQUARE,
+    EVAL_MOBILITY,
+    EVAL_PAWNS,
+    EVAL_KING_SAFETY,
+    EVAL_TERM_COUNT
+} EvalTerm;
+
+extern const char* eval_term_names[EVAL_TERM_COUNT];
+
 int evaluate_material(const Board* board);
 int evaluate_piece_square(const Board* board);
 int evaluate_mobility(const Board* board);
@@ -33,9 +70,63 @@ int get_game_phase(const Board* board);
 // Tapered evaluation (interpolate between midgame and endgame)
 int tapered_eval(int mg_score, int eg_score, int phase);
 
-// Initialize evaluation tables
+// Restore the compiled-in parameters (also active before the first call) and generate the
+// KPK bitbase once
 void init_evaluation(void);
 
+// Parameter sets: defaults, activation, and text files of "name value..." entries
+void default_eval_params(EvalParams* params);
+void set_eval_params(const EvalParams* params);
+bool load_eval_params(EvalParams* params, const char* path);
+bool save_eval_params(const EvalParams* params, const char* path);
+
+// Evaluation cache shared by all threads: one word per entry holding the score and the upper
+// 48 bits of the hash, so it is lock-free. Off until init_eval_cache(); 0 MB disables it.
+// Resizing is not safe while searches run. set_eval_params() clears it.
+typedef struct {
+    uint64_t probes;
+    uint64_t hits;
+} EvalCacheStats;
+
+bool init_eval_cache(size_t size_mb);
+void free_eval_cache(void);
+void clear_eval_cache(void);
+size_t eval_cache_entries(void);
+
+// Probe and hit counts of the calling thread
+void get_eval_cache_stats(EvalCacheStats* stats);
+void reset_eval_cache_stats(void);
+
+// Breakdown of evaluate() by term and side
+typedef struct {
+    int material[2];                // Piece values of each side
+    int pst_mg[2];                  // Midgame piece-square sums, from each side's point of view
+    int pst_eg[2];                  // Endgame piece-square sums
+    int mobility[2];                // Moves of each side
+    int pawns[2];                   // Doubled and isolated pawn terms
+    int king_safety[2];             // King file terms
+    int phase;                      // get_game_phase(), 256 = midgame
+    int terms[EVAL_TERM_COUNT];     // Net weighted terms from White's point of view
+    int scale;                      // Scale factor of the side ahead (SCALE_NORMAL = unscaled)
+    bool endgame;                   // A specialised endgame evaluator replaced the terms
+    int total;                      // evaluate() from White's point of view
+} EvalTrace;
+
+void trace_evaluate(const Board* board, EvalTrace* trace);
+
+// Calls and cycles (or nanoseconds off x86) per term of evaluate() on the calling thread.
+// Only built with -DEVAL_PROFILE (make profile); release builds have no profiling code.
+#ifdef EVAL_PROFILE
+typedef struct {
+    uint64_t calls[EVAL_TERM_COUNT];
+    uint64_t cycles[EVAL_TERM_COUNT];
+    uint64_t lazy_exits;            // evaluate_window() calls that skipped mobility
+} EvalProfile;
+
+void reset_eval_profile(void);
+void get_eval_profile(EvalProfile* profile);
+#endif
+
 // Mirror square for black pieces
 Square mirror_square(Square sq);
 
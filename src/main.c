@@ -1,16 +1,28 @@
+#include "batch.h"
+#include "bench.h"
 #include "bitboard.h"
 #include "board.h"
+#include "book.h"
 #include "evaluation.h"
+#include "material.h"
 #include "moves.h"
 #include "movegen.h"
 #include "notation.h"
+#include "packed.h"
 #include "search.h"
+#include "selfplay.h"
+#include "tablebase.h"
 #include "transposition.h"
+#include "tune.h"
 #include "zobrist.h"
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Opening book of the interactive game (--book)
+static Book opening_book;
+
 
 void print_game_rules(void) {
     printf("\n");
@@ -48,7 +60,10 @@ void play_game(Color player_color, int search_depth) {
     init_board(&board);
     
     TranspositionTable tt;
-    init_tt(&tt, 64);
+    if (!init_tt(&tt, 64)) {
+        printf("Cannot allocate a 64 MB transposition table\n");
+        return;
+    }
     
     SearchParams params = {
         .max_depth = search_depth,
@@ -56,6 +71,7 @@ void play_game(Color player_color, int search_depth) {
     };
     
     SearchInfo info;
+    uint64_t book_seed = get_time_ms() | 1;
     
     printf("\n");
     printf("   White        Black\n");
@@ -108,14 +124,14 @@ void play_game(Color player_color, int search_depth) {
             } else {
                 printf("    ");
             }
-           
+            
             move = read_user_move(&board);
-
+            
             if (move == 0) {
                 printf("\nGame terminated.\n");
                 break;
             }
-
+            
             move_to_algebraic(&board, move, move_str);
         } else {
             if (board.side_to_move == WHITE) {
@@ -124,8 +140,12 @@ void play_game(Color player_color, int search_depth) {
                 printf("    ");
             }
             
-            memset(&info, 0, sizeof(SearchInfo));
-            move = find_best_move(&board, search_depth, &info, &params);
+            // In book: no search
+            move = book_probe(&opening_book, &board, &book_seed);
+            if (move == 0) {
+                memset(&info, 0, sizeof(SearchInfo));
+                move = find_best_move(&board, search_depth, &info, &params);
+            }
             
             if (move == 0) {
                 printf("Engine error: no move found.\n");
@@ -153,9 +173,416 @@ void play_game(Color player_color, int search_depth) {
     free_tt(&tt);
 }
 
-int main(void) {
+// Batch Analysis
+// Reads one FEN per line and prints: index best-move score nodes pv...
+
+static void print_batch_result(const BatchResult* result, void* user_data) {
+    (void)user_data;
+    char str[8];
+    move_to_coordinate(result->best_move, str);
+    printf("%d %s %d %llu", result->index, str, result->score, (unsigned long long)result->nodes);
+    for (int i = 0; i < result->pv_length; i++) {
+        move_to_coordinate(result->pv[i], str);
+        printf(" %s", str);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+void run_batch(const char* path, int depth, int threads, uint64_t max_nodes) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Cannot open %s\n", path);
+        return;
+    }
+    
+    int capacity = 1024;
+    int count = 0;
+    char** fens = malloc(capacity * sizeof(char*));
+    char line[256];
+    
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '\0') continue;
+        
+        if (count == capacity) {
+            capacity *= 2;
+            fens = realloc(fens, capacity * sizeof(char*));
+        }
+        fens[count] = malloc(strlen(line) + 1);
+        strcpy(fens[count], line);
+        count++;
+    }
+    fclose(file);
+    
+    TranspositionTable tt;
+    if (init_tt(&tt, TT_SIZE_MB)) {
+        BatchParams params = {
+            .depth = depth,
+            .max_nodes = max_nodes,
+            .threads = threads,
+            .tt = &tt
+        };
+        
+        uint64_t start = get_time_ms();
+        uint64_t nodes = analyse_batch((const char**)fens, count, &params, print_batch_result, NULL);
+        uint64_t elapsed = get_time_ms() - start;
+        
+        printf("Positions: %d, nodes: %llu, time: %llu ms, positions/second: %.1f\n",
+               count, (unsigned long long)nodes, (unsigned long long)elapsed,
+               elapsed ? count * 1000.0 / elapsed : 0.0);
+        free_tt(&tt);
+    } else {
+        printf("Cannot allocate a %d MB transposition table\n", TT_SIZE_MB);
+    }
+    
+    for (int i = 0; i < count; i++) free(fens[i]);
+    free(fens);
+}
+
+// Evaluation Trace
+// Prints every term of evaluate() for each side, from that side's point of view
+
+void run_eval(const char* fen) {
+    Board board;
+    set_fen(&board, fen);
+    
+    EvalTrace trace;
+    trace_evaluate(&board, &trace);
+    
+    printf("%-20s %8s %8s %8s\n", "Term", "White", "Black", "Net");
+    printf("%-20s %8d %8d %8d\n", "Material", trace.material[WHITE], trace.material[BLACK],
+           trace.terms[EVAL_MATERIAL]);
+    printf("%-20s %8d %8d %8d\n", "Piece-square mg", trace.pst_mg[WHITE], trace.pst_mg[BLACK],
+           trace.pst_mg[WHITE] - trace.pst_mg[BLACK]);
+    printf("%-20s %8d %8d %8d\n", "Piece-square eg", trace.pst_eg[WHITE], trace.pst_eg[BLACK],
+           trace.pst_eg[WHITE] - trace.pst_eg[BLACK]);
+    printf("%-20s %8s %8s %8d\n", "Piece-square", "", "", trace.terms[EVAL_PIECE_SQUARE]);
+    printf("%-20s %8d %8d %8d\n", "Mobility (moves)", trace.mobility[WHITE], trace.mobility[BLACK],
+           trace.terms[EVAL_MOBILITY]);
+    printf("%-20s %8d %8d %8d\n", "Pawns", trace.pawns[WHITE], trace.pawns[BLACK],
+           trace.terms[EVAL_PAWNS]);
+    printf("%-20s %8d %8d %8d\n", "King safety", trace.king_safety[WHITE], trace.king_safety[BLACK],
+           trace.terms[EVAL_KING_SAFETY]);
+    printf("Phase %d/256 (256 = midgame)\n", trace.phase);
+    if (trace.endgame) {
+        printf("Known endgame: specialised evaluation replaces the terms\n");
+    } else if (trace.scale != SCALE_NORMAL) {
+        printf("Scale %d/%d\n", trace.scale, SCALE_NORMAL);
+    }
+    printf("Total %d (White), %d (side to move)\n", trace.total, evaluate(&board));
+}
+
+// Binary Conversion
+// FEN files become position files; PGN files become game files, or position files with "positions"
+
+void run_pack(const char* in_path, const char* out_path, const char* mode) {
+    size_t length = strlen(in_path);
+    bool is_pgn = length > 4 && strcmp(in_path + length - 4, ".pgn") == 0;
+    
+    long long count;
+    if (is_pgn) {
+        PackedKind kind = (strcmp(mode, "positions") == 0) ? PACKED_POSITIONS : PACKED_GAMES;
+        count = packed_convert_pgn(in_path, out_path, kind);
+    } else {
+        count = packed_convert_fen(in_path, out_path);
+    }
+    
+    if (count < 0) {
+        printf("Conversion of %s failed\n", in_path);
+    } else {
+        printf("Wrote %lld records to %s\n", count, out_path);
+    }
+}
+
+// Self-Play Data Generation
+// Writes a packed position file; Ctrl-C stops cleanly and keeps the finished games
+
+static void print_selfplay_progress(const SelfPlayStats* stats, void* user_data) {
+    (void)user_data;
+    uint64_t elapsed = stats->elapsed_ms ? stats->elapsed_ms : 1;
+    printf("games %llu (+%llu =%llu -%llu, %llu adjudicated), positions %llu, positions/second %.1f, nps %llu\n",
+           (unsigned long long)stats->games, (unsigned long long)stats->white_wins,
+           (unsigned long long)stats->draws, (unsigned long long)stats->black_wins,
+           (unsigned long long)stats->adjudicated, (unsigned long long)stats->positions,
+           stats->positions * 1000.0 / elapsed, (unsigned long long)(stats->nodes * 1000 / elapsed));
+    fflush(stdout);
+}
+
+static void handle_interrupt(int sig) {
+    (void)sig;
+    stop_selfplay();
+}
+
+void run_selfplay_command(const char* path, int threads, uint64_t games, uint64_t nodes, uint64_t seconds) {
+    SelfPlayParams params;
+    init_selfplay_params(&params);
+    params.output_path = path;
+    params.threads = threads;
+    params.games = games;
+    params.nodes_per_move = nodes;
+    params.time_limit_ms = seconds * 1000;
+    params.seed = get_time_ms();
+    
+    signal(SIGINT, handle_interrupt);
+    signal(SIGTERM, handle_interrupt);
+    
+    SelfPlayStats stats;
+    if (!run_selfplay(&params, &stats, print_selfplay_progress, NULL)) {
+        printf("Cannot write %s or allocate %zu MB transposition tables\n", path, params.tt_mb);
+        return;
+    }
+    print_selfplay_progress(&stats, NULL);
+}
+
+// Evaluation Tuning
+// Texel tuning on a packed position file, starting from the active evaluation parameters
+
+static void print_tune_progress(const TuneProgress* progress, void* user_data) {
+    (void)user_data;
+    printf("epoch %d, loss %.6f, epochs/second %.2f\n",
+           progress->epoch, progress->loss, progress->epochs_per_second);
+    fflush(stdout);
+}
+
+void run_tune(const char* data_path, int epochs, int threads, const char* out_path) {
+    TuneData data;
+    uint64_t start = get_time_ms();
+    if (!load_tune_data(&data, data_path, threads)) {
+        printf("Cannot read %s\n", data_path);
+        return;
+    }
+    printf("Loaded %zu positions (%.1f MB) in %llu ms\n", data.count,
+           data.count * sizeof(TuneEntry) / 1048576.0, (unsigned long long)(get_time_ms() - start));
+    
+    double* params = malloc(TUNE_PARAM_COUNT * sizeof(double));
+    init_tune_params(params, &eval_params);
+    
+    TuneParams tune_params = {
+        .threads = threads,
+        .epochs = epochs,
+        .learning_rate = 1.0,
+        .report_every = 10
+    };
+    
+    tune_params.k = find_best_k(&data, params, threads);
+    printf("K = %.6f, initial loss %.6f\n", tune_params.k, tune_loss(&data, params, tune_params.k, threads));
+    
+    double loss = run_tuner(&data, params, &tune_params, print_tune_progress, NULL);
+    printf("Final loss %.6f\n", loss);
+    
+    if (write_tune_params(params, out_path)) {
+        printf("Parameters written to %s\n", out_path);
+    } else {
+        printf("Cannot write %s\n", out_path);
+    }
+    
+    free(params);
+    free_tune_data(&data);
+}
+
+// Opening Book Building
+// Compiles PGN files into a Polyglot-format book
+
+void run_makebook(const char* out_path, int threads, int max_ply, int min_games, const char** pgn_paths, int count) {
+    BookBuildParams params = {
+        .threads = threads,
+        .max_ply = max_ply,
+        .min_games = min_games
+    };
+    
+    BookBuildStats stats;
+    if (!build_book(pgn_paths, count, out_path, &params, &stats)) {
+        printf("Cannot build %s\n", out_path);
+        return;
+    }
+    printf("Games %llu, positions %llu, entries %llu (%.1f KB)\n", (unsigned long long)stats.games,
+           (unsigned long long)stats.positions, (unsigned long long)stats.entries,
+           stats.entries * BOOK_ENTRY_SIZE / 1024.0);
+    printf("Read %llu ms, count %llu ms (%d threads), merge %llu ms\n", (unsigned long long)stats.read_ms,
+           (unsigned long long)stats.count_ms, threads, (unsigned long long)stats.merge_ms);
+}
+
+// Tablebase Generation
+// Each argument is a signature ("KRvKP") or a piece count standing for every signature up to it
+
+static void print_tablebase_stats(const char* signature, const TbGenStats* stats) {
+    printf("%-12s %8llu ms, %llu entries, +%llu =%llu -%llu, max DTZ %d, %d passes\n", signature,
+           (unsigned long long)stats->milliseconds, (unsigned long long)stats->entries,
+           (unsigned long long)stats->wins, (unsigned long long)stats->draws,
+           (unsigned long long)stats->losses, stats->max_dtz, stats->passes);
+    fflush(stdout);
+}
+
+void run_tbgen(const char* dir, int threads, char** signatures, int count) {
+    load_tablebases(dir);
+    
+    static char all[TB_MAX_TABLES][TB_SIGNATURE_LENGTH];
+    uint64_t start = get_time_ms();
+    for (int i = 0; i < count; i++) {
+        int pieces = atoi(signatures[i]);
+        if (pieces > 0) {
+            int total = tablebase_signatures(pieces, all, TB_MAX_TABLES);
+            for (int j = 0; j < total; j++) {
+                if (!generate_tablebase(all[j], dir, threads, print_tablebase_stats)) {
+                    printf("Cannot generate %s in %s\n", all[j], dir);
+                    return;
+                }
+            }
+        } else if (!generate_tablebase(signatures[i], dir, threads, print_tablebase_stats)) {
+            printf("Cannot generate %s in %s\n", signatures[i], dir);
+            return;
+        }
+    }
+    printf("%d tables in %s, %llu ms\n", tablebase_count(), dir, (unsigned long long)(get_time_ms() - start));
+}
+
+int main(int argc, char** argv) {
     init_bitboards();
     init_zobrist();
+    init_evaluation();
+    
+    init_eval_cache(EVAL_CACHE_SIZE_MB);
+    
+    // Engine options
+    // Usage: zugzwang [--eval-params <file>] [--eval-cache <mb>] [--tb <dir>] [--book <file>] [command ...]
+    while (argc > 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--eval-params") == 0) {
+            EvalParams params = eval_params;
+            if (!load_eval_params(&params, argv[2])) {
+                printf("Cannot load evaluation parameters from %s\n", argv[2]);
+                return 1;
+            }
+            set_eval_params(&params);
+        } else if (strcmp(argv[1], "--eval-cache") == 0) {
+            if (!init_eval_cache(strtoull(argv[2], NULL, 10))) {
+                printf("Cannot allocate a %s MB evaluation cache\n", argv[2]);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--book") == 0) {
+            if (!book_open(&opening_book, argv[2])) {
+                printf("Cannot open opening book %s\n", argv[2]);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--tb") == 0) {
+            if (load_tablebases(argv[2]) < 0) {
+                printf("Cannot read tablebases from %s\n", argv[2]);
+                return 1;
+            }
+        } else {
+            printf("Unknown option %s\n", argv[1]);
+            return 1;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    
+    // Command-line tools
+    // Usage: zugzwang bench pgn <file>
+    if (argc > 3 && strcmp(argv[1], "bench") == 0 && strcmp(argv[2], "pgn") == 0) {
+        bench_pgn(argv[3]);
+        return 0;
+    }
+    
+    // Usage: zugzwang bench san <file>
+    if (argc > 3 && strcmp(argv[1], "bench") == 0 && strcmp(argv[2], "san") == 0) {
+        bench_san(argv[3]);
+        return 0;
+    }
+    
+    // Usage: zugzwang bench packed <file>
+    if (argc > 3 && strcmp(argv[1], "bench") == 0 && strcmp(argv[2], "packed") == 0) {
+        bench_packed(argv[3]);
+        return 0;
+    }
+    
+    // Usage: zugzwang bench mate [max-depth]
+    if (argc > 2 && strcmp(argv[1], "bench") == 0 && strcmp(argv[2], "mate") == 0) {
+        bench_mates((argc > 3) ? atoi(argv[3]) : 8);
+        return 0;
+    }
+    
+    // Usage: zugzwang bench resume <file> [depth] [hash-mb]
+    if (argc > 3 && strcmp(argv[1], "bench") == 0 && strcmp(argv[2], "resume") == 0) {
+        int depth = (argc > 4) ? atoi(argv[4]) : 6;
+        size_t tt_mb = (argc > 5) ? strtoull(argv[5], NULL, 10) : TT_SIZE_MB;
+        bench_tt_resume(argv[3], depth, tt_mb);
+        return 0;
+    }
+    
+    // Usage: zugzwang bench tb <dir>
+    if (argc > 3 && strcmp(argv[1], "bench") == 0 && strcmp(argv[2], "tb") == 0) {
+        bench_tablebases(argv[3]);
+        return 0;
+    }
+    
+    // Usage: zugzwang bench [depth] [multipv] [hash-mb]
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int depth = (argc > 2) ? atoi(argv[2]) : 3;
+        int multi_pv = (argc > 3) ? atoi(argv[3]) : 1;
+        size_t tt_mb = (argc > 4) ? strtoull(argv[4], NULL, 10) : TT_SIZE_MB;
+        bench_search(depth, multi_pv, tt_mb);
+        return 0;
+    }
+    
+    // Usage: zugzwang batch <fen-file> [depth] [threads] [max-nodes]
+    if (argc > 2 && strcmp(argv[1], "batch") == 0) {
+        int depth = (argc > 3) ? atoi(argv[3]) : 3;
+        int threads = (argc > 4) ? atoi(argv[4]) : 1;
+        uint64_t max_nodes = (argc > 5) ? strtoull(argv[5], NULL, 10) : 0;
+        run_batch(argv[2], depth, threads, max_nodes);
+        return 0;
+    }
+    
+    // Usage: zugzwang selfplay <out> [threads] [games] [nodes-per-move] [seconds]
+    if (argc > 2 && strcmp(argv[1], "selfplay") == 0) {
+        int threads = (argc > 3) ? atoi(argv[3]) : 1;
+        uint64_t games = (argc > 4) ? strtoull(argv[4], NULL, 10) : 0;
+        uint64_t nodes = (argc > 5) ? strtoull(argv[5], NULL, 10) : 5000;
+        uint64_t seconds = (argc > 6) ? strtoull(argv[6], NULL, 10) : 0;
+        run_selfplay_command(argv[2], threads, games, nodes, seconds);
+        return 0;
+    }
+    
+    // Usage: zugzwang tune <data> [epochs] [threads] [out]
+    if (argc > 2 && strcmp(argv[1], "tune") == 0) {
+        int epochs = (argc > 3) ? atoi(argv[3]) : 1000;
+        int threads = (argc > 4) ? atoi(argv[4]) : 1;
+        const char* out_path = (argc > 5) ? argv[5] : "tuned_params.txt";
+        run_tune(argv[2], epochs, threads, out_path);
+        return 0;
+    }
+    
+    // Usage: zugzwang eval [fen]
+    if (argc > 1 && strcmp(argv[1], "eval") == 0) {
+        char fen[256] = "";
+        for (int i = 2; i < argc; i++) {
+            if (i > 2) strncat(fen, " ", sizeof(fen) - strlen(fen) - 1);
+            strncat(fen, argv[i], sizeof(fen) - strlen(fen) - 1);
+        }
+        run_eval(argc > 2 ? fen : START_FEN);
+        return 0;
+    }
+    
+    // Usage: zugzwang makebook <out> <threads> <max-ply> <min-games> <pgn>...
+    if (argc > 6 && strcmp(argv[1], "makebook") == 0) {
+        run_makebook(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), (const char**)argv + 6, argc - 6);
+        return 0;
+    }
+    
+    // Usage: zugzwang tbgen <dir> <threads> <signature|max-pieces>...
+    // (five-piece tables: up to 665 MB each, and 2.6 GB of memory while generating)
+    if (argc > 4 && strcmp(argv[1], "tbgen") == 0) {
+        run_tbgen(argv[2], atoi(argv[3]), argv + 4, argc - 4);
+        return 0;
+    }
+    
+    // Usage: zugzwang pack <in.fen|in.pgn> <out> [games|positions]
+    if (argc > 3 && strcmp(argv[1], "pack") == 0) {
+        run_pack(argv[2], argv[3], (argc > 4) ? argv[4] : "games");
+        return 0;
+    }
     
     print_game_rules();
     
@@ -172,6 +599,7 @@ int main(void) {
     play_game(player_color, 5);
     
     printf("\nThank you for playing!\n");
+    book_close(&opening_book);
     
     return 0;
 }
@@ -0,0 +1,109 @@
+#include "material.h"
+#include "endgame.h"
+#include "evaluation.h"
+#include <string.h>
+
+// Per-thread table, indexed by the top bits of the key times a multiplier
+static _Thread_local MaterialEntry material_table[MATERIAL_TABLE_SIZE];
+
+
+// Material Patterns
+
+// Counts of one side, shifted down to White's position in the key
+static uint64_t side_material(uint64_t key, Color color) {
+    return (key >> MATERIAL_KEY_SHIFT(color, PAWN)) & ((1ULL << MATERIAL_KEY_SHIFT(BLACK, PAWN)) - 1);
+}
+
+// Pattern of pieces (besides the king) in side_material() form
+static uint64_t pieces_pattern(int pawns, int knights, int bishops, int rooks, int queens) {
+    return pawns * MATERIAL_KEY_UNIT(WHITE, PAWN) + knights * MATERIAL_KEY_UNIT(WHITE, KNIGHT) +
+           bishops * MATERIAL_KEY_UNIT(WHITE, BISHOP) + rooks * MATERIAL_KEY_UNIT(WHITE, ROOK) +
+           queens * MATERIAL_KEY_UNIT(WHITE, QUEEN);
+}
+
+// Non-pawn material of one side at the compiled-in piece values
+static int non_pawn_material(uint64_t key, Color color) {
+    int total = 0;
+    for (int piece_type = KNIGHT; piece_type <= QUEEN; piece_type++) {
+        total += material_count(key, color, piece_type) * piece_value(piece_type);
+    }
+    return total;
+}
+
+static void compute_entry(MaterialEntry* entry, const Board* board) {
+    uint64_t key = board->material_key;
+    
+    entry->key = key;
+    entry->generation = eval_params_generation;
+    entry->material = evaluate_material(board);
+    entry->phase = get_game_phase(board);
+    entry->factor[WHITE] = entry->factor[BLACK] = SCALE_NORMAL;
+    entry->strong = WHITE;
+    entry->endgame = NULL;
+    entry->scale[WHITE] = entry->scale[BLACK] = NULL;
+    
+    for (int color = WHITE; color <= BLACK; color++) {
+        Color weak = (color == WHITE) ? BLACK : WHITE;
+        uint64_t ours = side_material(key, color);
+        uint64_t theirs = side_material(key, weak);
+        int ours_npm = non_pawn_material(key, color);
+        int theirs_npm = non_pawn_material(key, weak);
+        
+        // Specialised evaluators
+        EndgameFunc endgame = NULL;
+        if (ours == pieces_pattern(0, 1, 1, 0, 0) && theirs == 0) {
+            endgame = evaluate_kbnk;
+        } else if (ours == pieces_pattern(0, 0, 0, 1, 0) && theirs == pieces_pattern(1, 0, 0, 0, 0)) {
+            endgame = evaluate_krkp;
+        } else if (ours == pieces_pattern(1, 0, 0, 0, 0) && theirs == 0) {
+            endgame = evaluate_kpk;
+        } else if (theirs == 0 && ours_npm >= ROOK_VALUE && ours != pieces_pattern(0, 2, 0, 0, 0)) {
+            endgame = evaluate_kxk;
+        }
+        if (endgame) {
+            entry->endgame = endgame;
+            entry->strong = (Color)color;
+        }
+        
+        // Without pawns, a small material edge does not win (nor do two knights)
+        if (material_count(key, color, PAWN) == 0) {
+            if (ours == pieces_pattern(0, 2, 0, 0, 0) && theirs == 0) {
+                entry->factor[color] = SCALE_DRAW;
+            } else if (ours_npm - theirs_npm <= BISHOP_VALUE) {
+                entry->factor[color] = ours_npm < ROOK_VALUE ? SCALE_DRAW : (theirs_npm <= BISHOP_VALUE ? 4 : 14);
+            }
+        }
+    }
+    
+    // One bishop each and only pawns besides: scaled when the bishops are of opposite colors
+    if (non_pawn_material(key, WHITE) == BISHOP_VALUE && material_count(key, WHITE, BISHOP) == 1 &&
+        non_pawn_material(key, BLACK) == BISHOP_VALUE && material_count(key, BLACK, BISHOP) == 1) {
+        entry->scale[WHITE] = entry->scale[BLACK] = scale_opposite_bishops;
+    }
+}
+
+
+// Table Access
+
+const MaterialEntry* probe_material(const Board* board) {
+    uint64_t key = board->material_key;
+    MaterialEntry* entry = &material_table[(key * 0x9E3779B97F4A7C15ULL) >> (64 - MATERIAL_TABLE_BITS)];
+    
+    if (entry->key != key || entry->generation != eval_params_generation) {
+        compute_entry(entry, board);
+    }
+    return entry;
+}
+
+void clear_material_table(void) {
+    memset(material_table, 0, sizeof(material_table));
+}
+
+int material_scale(const MaterialEntry* entry, const Board* board, Color strong) {
+    int factor = entry->factor[strong];
+    if (entry->scale[strong]) {
+        int scaled = entry->scale[strong](board, strong);
+        if (scaled < factor) factor = scaled;
+    }
+    return factor;
+}
@@ -0,0 +1,42 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "types.h"
+#include "board.h"
+
+// Material table: everything evaluate() derives from the piece counts alone, cached by
+// Board.material_key. Each thread has its own table.
+
+// Number of entries
+#define MATERIAL_TABLE_BITS 13
+#define MATERIAL_TABLE_SIZE (1 << MATERIAL_TABLE_BITS)
+
+// Scale factors applied to the score of the side that is ahead
+#define SCALE_NORMAL 64
+#define SCALE_DRAW 0
+
+// Specialised evaluation for one endgame, from White's point of view
+typedef int (*EndgameFunc)(const Board* board, Color strong);
+
+// Scale factor depending on the piece placement, 0..SCALE_NORMAL
+typedef int (*ScaleFunc)(const Board* board, Color strong);
+
+typedef struct {
+    uint64_t key;
+    unsigned generation;        // eval_params generation the entry was computed with
+    int material;               // Piece values, White's point of view
+    int phase;                  // get_game_phase()
+    uint8_t factor[2];          // Scale factor when that color is ahead
+    Color strong;               // Side the endgame function is for
+    EndgameFunc endgame;        // Replaces the whole evaluation when set
+    ScaleFunc scale[2];         // Overrides factor[color] when set
+} MaterialEntry;
+
+// Entry for the board's material, computed on a miss
+const MaterialEntry* probe_material(const Board* board);
+void clear_material_table(void);
+
+// Scale factor for the side that is ahead
+int material_scale(const MaterialEntry* entry, const Board* board, Color strong);
+
+#endif // MATERIAL_H
@@ -7,9 +7,10 @@
 #include <string.h>
 
 
-// Global tables for move ordering heuristics
-Move killer_moves[MAX_PLY][2];
-int history_table[2][64][64];
+// Quiet move ordering tables (one copy per search thread); killers live on the search stack
+_Thread_local int history_table[2][64][64];
+_Thread_local Move counter_moves[12][64];
+_Thread_local PieceToHistory continuation_history[12][64];
 
 // Function pointer array for piece-specific move generation
 MoveGenFunc piece_movegen[6] = {
@@ -342,6 +343,29 @@ void generate_quiet_moves(const Board* board, MoveList* list) {
 }
 
 
+bool has_legal_move(const Board* board) {
+    // Stops at the first legal move; the king goes first since it is the usual escape.
+    // Castling is skipped: if it is legal, so is the king's step towards the rook.
+    Color us = board->side_to_move;
+    MoveList list;
+    init_move_list(&list);
+    
+    for (int piece_type = KING; piece_type >= PAWN; piece_type--) {
+        Bitboard pieces = board->pieces[us][piece_type];
+        
+        while (pieces) {
+            Square sq = pop_lsb(&pieces);
+            piece_movegen[piece_type](board, sq, &list);
+            if (list.count > 0) {
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+
 // Move Ordering
 
 int mvv_lva_score(const Board* board, Move move) {
@@ -362,7 +386,7 @@ int mvv_lva_score(const Board* board, Move move) {
     return 10 * victim_values[victim] - attacker_values[attacker];
 }
 
-int score_move(const Board* board, Move move, Move hash_move, int ply) {
+int score_move(const Board* board, Move move, Move hash_move, const OrderContext* context) {
     // Hash move gets highest priority
     if (move == hash_move) {
         return SCORE_HASH_MOVE;
@@ -384,25 +408,39 @@ int score_move(const Board* board, Move move, Move hash_move, int ply) {
         if (promo == KNIGHT) return SCORE_MVV_LVA_BASE + 320;
     }
     
-    // Killer moves
-    if (move == killer_moves[ply][0]) {
-        return SCORE_KILLER_1;
-    }
-    if (move == killer_moves[ply][1]) {
-        return SCORE_KILLER_2;
+    // Killer moves, then the counter move
+    if (context) {
+        if (move == context->killers[0]) {
+            return SCORE_KILLER_1;
+        }
+        if (move == context->killers[1]) {
+            return SCORE_KILLER_2;
+        }
+        if (move == context->counter_move) {
+            return SCORE_COUNTER_MOVE;
+        }
     }
     
-    // History heuristic
+    // History heuristics: by squares, and by piece and destination after the last two moves
     Square from = move_from(move);
     Square to = move_to(move);
-    return history_table[board->side_to_move][from][to];
+    int score = history_table[board->side_to_move][from][to];
+    if (context) {
+        int piece = board->side_to_move * 6 + piece_on(board, from);
+        for (int i = 0; i < 2; i++) {
+            if (context->continuation[i]) {
+                score += (*context->continuation[i])[piece][to];
+            }
+        }
+    }
+    return score;
 }
 
-void order_moves(const Board* board, MoveList* list, Move hash_move, int ply) {
+void order_moves(const Board* board, MoveList* list, Move hash_move, const OrderContext* context) {
     // Score all moves
     int scores[MAX_MOVES];
     for (int i = 0; i < list->count; i++) {
-        scores[i] = score_move(board, list->moves[i], hash_move, ply);
+        scores[i] = score_move(board, list->moves[i], hash_move, context);
     }
     
     // Simple selection sort (good enough for small lists)
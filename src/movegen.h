@@ -20,6 +20,7 @@ typedef struct {
 void generate_moves(const Board* board, MoveList* list);
 void generate_captures(const Board* board, MoveList* list);
 void generate_quiet_moves(const Board* board, MoveList* list);
+bool has_legal_move(const Board* board);
 
 // Piece-specific generation (function pointer targets)
 typedef void (*MoveGenFunc)(const Board*, Square, MoveList*);
@@ -38,9 +39,19 @@ extern MoveGenFunc piece_movegen[6];
 void add_pawn_moves(const Board* board, Square from, Square to, MoveList* list);
 void add_castling_moves(const Board* board, MoveList* list);
 
-// Move ordering functions
-void order_moves(const Board* board, MoveList* list, Move hash_move, int ply);
-int score_move(const Board* board, Move move, Move hash_move, int ply);
+// History of a move by its piece (color * 6 + piece type) and destination
+typedef int16_t PieceToHistory[12][64];
+
+// What the search knows about the node for ordering its quiet moves
+typedef struct {
+    const Move* killers;                    // The two killer moves of the ply
+    Move counter_move;                      // Last quiet refutation of the previous move (0 for none)
+    const PieceToHistory* continuation[2];  // Rows after the previous move and the one before (or NULL)
+} OrderContext;
+
+// Move ordering functions (context NULL: captures, promotions and the history table only)
+void order_moves(const Board* board, MoveList* list, Move hash_move, const OrderContext* context);
+int score_move(const Board* board, Move move, Move hash_move, const OrderContext* context);
 int mvv_lva_score(const Board* board, Move move);
 
 // Scored move list utilities
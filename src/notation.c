@@ -87,6 +87,43 @@ Move coordinate_to_move(const char* str) {
 
 // Algebraic Notation
 
+static Bitboard piece_attacks_from(PieceType piece, Square sq, Bitboard occupied) {
+    switch (piece) {
+        case KNIGHT: return knight_attacks(sq);
+        case BISHOP: return bishop_attacks(sq, occupied);
+        case ROOK:   return rook_attacks(sq, occupied);
+        case QUEEN:  return queen_attacks(sq, occupied);
+        case KING:   return king_attacks(sq);
+        default:     return 0ULL;
+    }
+}
+
+static Bitboard ambiguous_movers(const Board* board, Move move, PieceType piece) {
+    // Other legal movers of the same type to the same square, found by attacks instead of movegen
+    Color us = board->side_to_move;
+    Color them = (us == WHITE) ? BLACK : WHITE;
+    Square from = move_from(move);
+    Square to = move_to(move);
+    
+    Bitboard others = piece_attacks_from(piece, to, board->all_occupied) &
+                      board->pieces[us][piece] & ~square_bb(from);
+    if (!others) return 0ULL;
+    
+    Square king_sq = get_king_square(board, us);
+    Bitboard pinned = slider_blockers(board, them, king_sq) & board->occupied[us];
+    bool in_check = is_in_check(board, us);
+    Bitboard result = 0ULL;
+    
+    while (others) {
+        Square sq = pop_lsb(&others);
+        if ((pinned & square_bb(sq)) && !(line_bb(sq, king_sq) & square_bb(to))) continue;
+        if (in_check && !is_legal(board, encode_move(sq, to, move_flags(move)))) continue;
+        result |= square_bb(sq);
+    }
+    
+    return result;
+}
+
 void move_to_algebraic(const Board* board, Move move, char* str) {
     Square from = move_from(move);
     Square to = move_to(move);
@@ -107,33 +144,22 @@ void move_to_algebraic(const Board* board, Move move, char* str) {
         if (piece != PAWN) {
             *p++ = piece_char(piece);
             
-            // Disambiguate if needed
-            MoveList list;
-            generate_moves((Board*)board, &list);
-            
-            bool need_file = false;
-            bool need_rank = false;
-            
-            for (int i = 0; i < list.count; i++) {
-                Move other = list.moves[i];
-                if (other == move) continue;
-                if (move_to(other) != to) continue;
-                if (piece_on(board, move_from(other)) != piece) continue;
-                
-                Square other_from = move_from(other);
-                if (square_file(other_from) == square_file(from)) {
-                    need_rank = true;
+            // Disambiguate if needed: file first, then rank, then both
+            Bitboard others = ambiguous_movers(board, move, piece);
+            if (others) {
+                if (!(others & file_mask(square_file(from)))) {
+                    *p++ = file_char(square_file(from));
+                } else if (!(others & rank_mask(square_rank(from)))) {
+                    *p++ = rank_char(square_rank(from));
                 } else {
-                    need_file = true;
+                    *p++ = file_char(square_file(from));
+                    *p++ = rank_char(square_rank(from));
                 }
             }
-            
-            if (need_file) *p++ = file_char(square_file(from));
-            if (need_rank) *p++ = rank_char(square_rank(from));
         }
         
-        // Capture indicator
-        if (is_capture(move)) {
+        // Capture indicator (promotions can capture too)
+        if (is_capture(move) || color_on(board, to) != NO_COLOR) {
             if (piece == PAWN) {
                 *p++ = file_char(square_file(from));
             }
@@ -151,54 +177,204 @@ void move_to_algebraic(const Board* board, Move move, char* str) {
         }
     }
     
-    // Check/checkmate annotation
-    Board temp;
-    copy_board(&temp, board);
-    make_move(&temp, move);
+    // Check/checkmate annotation: only checking moves pay for make_move and the mate test
+    CheckInfo check_info;
+    init_check_info(board, &check_info);
     
-    if (is_in_check(&temp, temp.side_to_move)) {
-        MoveList legal_moves;
-        generate_moves(&temp, &legal_moves);
-        
-        bool has_legal = false;
-        for (int i = 0; i < legal_moves.count; i++) {
-            if (is_legal(&temp, legal_moves.moves[i])) {
-                has_legal = true;
-                break;
-            }
-        }
-        
-        *p++ = has_legal ? '+' : '#';
+    if (gives_check(board, &check_info, move)) {
+        Board temp;
+        copy_board(&temp, board);
+        make_move(&temp, move);
+        *p++ = has_legal_move(&temp) ? '+' : '#';
     }
     
     *p = '\0';
 }
 
 Move algebraic_to_move(const Board* board, const char* str) {
-    // Generate all legal moves
+    Move move = san_to_move(board, str, (int)strlen(str));
+    if (move != 0) {
+        return move;
+    }
+    
+    // Try coordinate notation as fallback, taking the flags from the matching legal move
+    Move coord = coordinate_to_move(str);
+    if (coord == 0) {
+        return 0;
+    }
+    
     MoveList list;
-    generate_moves((Board*)board, &list);
+    generate_moves(board, &list);
     
-    // Try each move and see if it matches
     for (int i = 0; i < list.count; i++) {
-        if (!is_legal(board, list.moves[i])) continue;
-        
-        char move_str[16];
-        move_to_algebraic(board, list.moves[i], move_str);
-        
-        // Strip check/mate symbols for comparison
-        int len = strlen(move_str);
-        if (len > 0 && (move_str[len-1] == '+' || move_str[len-1] == '#')) {
-            move_str[len-1] = '\0';
+        Move legal = list.moves[i];
+        if (move_from(legal) == move_from(coord) && move_to(legal) == move_to(coord) &&
+            promotion_piece(legal) == promotion_piece(coord)) {
+            return legal;
         }
-        
-        if (strcmp(str, move_str) == 0) {
-            return list.moves[i];
+    }
+    return 0;
+}
+
+
+// Direct SAN Decoding
+//
+// Decodes piece, disambiguation, target and promotion, then finds the origin
+// square with one attackers query instead of generating and formatting moves.
+// Only ambiguous candidates (e.g. a pinned second knight) are checked for legality.
+
+static PieceType san_piece(char c) {
+    switch (c) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default:  return NO_PIECE_TYPE;
+    }
+}
+
+static Move san_castle(const Board* board, bool kingside) {
+    Color us = board->side_to_move;
+    Square from = (us == WHITE) ? E1 : E8;
+    Square to = kingside ? ((us == WHITE) ? G1 : G8) : ((us == WHITE) ? C1 : C8);
+    Move move = encode_move(from, to, kingside ? CASTLE_KINGSIDE : CASTLE_QUEENSIDE);
+    
+    MoveList list;
+    init_move_list(&list);
+    add_castling_moves(board, &list);
+    
+    for (int i = 0; i < list.count; i++) {
+        if (list.moves[i] == move) return move;
+    }
+    return 0;
+}
+
+Move san_to_move(const Board* board, const char* san, int length) {
+    // Strip check, mate and annotation suffixes
+    while (length > 0 && (san[length - 1] == '+' || san[length - 1] == '#' ||
+                          san[length - 1] == '!' || san[length - 1] == '?')) {
+        length--;
+    }
+    if (length < 2) return 0;
+    
+    // Castling (also accept the digit-zero form)
+    if (san[0] == 'O' || san[0] == '0') {
+        char c = san[0];
+        if (length == 3 && san[1] == '-' && san[2] == c) return san_castle(board, true);
+        if (length == 5 && san[1] == '-' && san[2] == c && san[3] == '-' && san[4] == c) {
+            return san_castle(board, false);
+        }
+        return 0;
+    }
+    
+    Color us = board->side_to_move;
+    Color them = (us == WHITE) ? BLACK : WHITE;
+    
+    PieceType piece = san_piece(san[0]);
+    int start = 1;
+    if (piece == NO_PIECE_TYPE) {
+        piece = PAWN;
+        start = 0;
+    }
+    
+    // Promotion suffix: e8=Q (or e8Q)
+    MoveFlags flags = NORMAL;
+    if (piece == PAWN) {
+        switch (san_piece(san[length - 1])) {
+            case KNIGHT: flags = PROMOTION_KNIGHT; break;
+            case BISHOP: flags = PROMOTION_BISHOP; break;
+            case ROOK:   flags = PROMOTION_ROOK; break;
+            case QUEEN:  flags = PROMOTION_QUEEN; break;
+            default:     break;
+        }
+        if (flags != NORMAL) {
+            length--;
+            if (length > 0 && san[length - 1] == '=') length--;
         }
     }
+    if (length - start < 2) return 0;
     
-    // Try coordinate notation as fallback
-    return coordinate_to_move(str);
+    // Target square
+    int to_file = san[length - 2] - 'a';
+    int to_rank = san[length - 1] - '1';
+    if (to_file < 0 || to_file > 7 || to_rank < 0 || to_rank > 7) return 0;
+    Square to = make_square(to_rank, to_file);
+    
+    // Disambiguation and capture marker
+    Bitboard from_mask = ~0ULL;
+    bool capture_marker = false;
+    for (int i = start; i < length - 2; i++) {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h') {
+            from_mask &= file_mask(c - 'a');
+        } else if (c >= '1' && c <= '8') {
+            from_mask &= rank_mask(c - '1');
+        } else if (c == 'x' || c == ':') {
+            capture_marker = true;
+        } else if (c != '-') {
+            return 0;
+        }
+    }
+    
+    Bitboard to_bb = square_bb(to);
+    if (board->occupied[us] & to_bb) return 0;
+    
+    bool enemy_on_target = (board->occupied[them] & to_bb) != 0;
+    bool en_passant = piece == PAWN && to == board->en_passant_square && !enemy_on_target;
+    
+    // Promotion must reach the last rank, and only there
+    int last_rank = (us == WHITE) ? 7 : 0;
+    if (piece == PAWN && (flags != NORMAL) != (to_rank == last_rank)) return 0;
+    
+    Bitboard candidates;
+    if (piece == PAWN && !enemy_on_target && !en_passant) {
+        // Pawn push: single step, or double step from the starting rank
+        if (capture_marker) return 0;
+        int back = (us == WHITE) ? -8 : 8;
+        int one = (int)to + back;
+        candidates = 0ULL;
+        if (one >= 0 && one < 64) {
+            if (board->pieces[us][PAWN] & square_bb(one)) {
+                candidates = square_bb(one);
+            } else if (!(board->all_occupied & square_bb(one)) &&
+                       to_rank == ((us == WHITE) ? 3 : 4) &&
+                       (board->pieces[us][PAWN] & square_bb(one + back))) {
+                candidates = square_bb(one + back);
+            }
+        }
+        candidates &= from_mask;
+    } else {
+        candidates = get_attackers(board, to, us) & board->pieces[us][piece] & from_mask;
+        if (piece == PAWN && from_mask == ~0ULL) return 0;  // Pawn captures name their file
+    }
+    
+    if (flags == NORMAL) {
+        if (en_passant) flags = EN_PASSANT;
+        else if (enemy_on_target) flags = CAPTURE;
+    }
+    
+    if (candidates == 0) return 0;
+    
+    // Unique candidate: only king moves, pinned pieces, en passant and check evasions need
+    // the legality test
+    if ((candidates & (candidates - 1)) == 0) {
+        Move move = encode_move(lsb(candidates), to, flags);
+        Square king = get_king_square(board, us);
+        bool safe = piece != KING && !en_passant && !is_square_attacked(board, king, them) &&
+                    !(slider_blockers(board, them, king) & candidates);
+        return (safe || is_legal(board, move)) ? move : 0;
+    }
+    
+    Move found = 0;
+    while (candidates) {
+        Move move = encode_move(pop_lsb(&candidates), to, flags);
+        if (is_legal(board, move)) {
+            if (found) return 0;  // Still ambiguous
+            found = move;
+        }
+    }
+    return found;
 }
 
 
@@ -268,7 +444,7 @@ Move read_user_move(const Board* board) {
     }
     
     // Remove newline
-    input[strcspn(input, "\n")] = 0;
+    input[strcspn(input, "\r\n")] = 0;
     
     // Handle special commands
     if (strcmp(input, "quit") == 0 || strcmp(input, "exit") == 0) {
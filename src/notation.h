@@ -8,6 +8,7 @@
 // Algebraic notation conversion
 void move_to_algebraic(const Board* board, Move move, char* str);
 Move algebraic_to_move(const Board* board, const char* str);
+Move san_to_move(const Board* board, const char* san, int length);
 
 // Coordinate notation (e2e4)
 void move_to_coordinate(Move move, char* str);
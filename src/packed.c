@@ -0,0 +1,385 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "packed.h"
+#include "bitboard.h"
+#include "board.h"
+#include "moves.h"
+#include "pgn.h"
+#include "zobrist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// stdio buffer used by readers and writers
+#define PACKED_IO_BUFFER (1 << 20)
+
+
+// Position Encoding
+
+void pack_position(const Board* board, PackedPosition* packed) {
+    memset(packed, 0, sizeof(PackedPosition));
+    packed->occupied = board->all_occupied;
+    
+    // Piece codes by square, then packed in square order
+    uint8_t codes[64];
+    for (int color = 0; color < 2; color++) {
+        for (int piece_type = 0; piece_type < 6; piece_type++) {
+            Bitboard pieces = board->pieces[color][piece_type];
+            while (pieces) {
+                codes[pop_lsb(&pieces)] = (uint8_t)(color << 3 | piece_type);
+            }
+        }
+    }
+    
+    Bitboard occupied = board->all_occupied;
+    for (int i = 0; occupied && i < 32; i++) {
+        packed->pieces[i >> 1] |= codes[pop_lsb(&occupied)] << ((i & 1) * 4);
+    }
+    
+    packed->state = (uint8_t)(board->side_to_move | board->castling_rights << 1);
+    packed->en_passant_square = (uint8_t)board->en_passant_square;
+    packed->halfmove_clock = (uint8_t)(board->halfmove_clock > 255 ? 255 : board->halfmove_clock);
+    packed->result = ONGOING;
+    packed->fullmove_number = (uint16_t)board->fullmove_number;
+    packed->score = PACKED_NO_SCORE;
+}
+
+bool unpack_position(const PackedPosition* packed, Board* board) {
+    // Only the fields a position needs are reset; the undo and history stacks start empty
+    if (popcount(packed->occupied) > 32 || packed->en_passant_square > NO_SQUARE) {
+        return false;
+    }
+    
+    memset(board->pieces, 0, sizeof(board->pieces));
+    board->occupied[WHITE] = 0ULL;
+    board->occupied[BLACK] = 0ULL;
+    board->all_occupied = packed->occupied;
+    
+    uint64_t hash = 0ULL;
+    Bitboard occupied = packed->occupied;
+    for (int i = 0; occupied; i++) {
+        Square sq = pop_lsb(&occupied);
+        int code = (packed->pieces[i >> 1] >> ((i & 1) * 4)) & 0xF;
+        int color = code >> 3;
+        int piece_type = code & 7;
+        if (piece_type > KING) {
+            return false;
+        }
+        board->pieces[color][piece_type] |= square_bb(sq);
+        board->occupied[color] |= square_bb(sq);
+        hash ^= piece_keys[color][piece_type][sq];
+    }
+    
+    board->side_to_move = (Color)(packed->state & 1);
+    board->castling_rights = (packed->state >> 1) & 0xF;
+    board->en_passant_square = (Square)packed->en_passant_square;
+    board->halfmove_clock = packed->halfmove_clock;
+    board->fullmove_number = packed->fullmove_number;
+    
+    hash ^= castling_keys[board->castling_rights];
+    if (board->en_passant_square != NO_SQUARE) {
+        hash ^= en_passant_keys[board->en_passant_square];
+    }
+    if (board->side_to_move == BLACK) {
+        hash ^= side_key;
+    }
+    
+    board->hash = hash;
+    board->material_key = compute_material_key(board);
+    board->undo_index = 0;
+    board->history_index = 0;
+    board->position_history[board->history_index++] = hash;
+    return true;
+}
+
+
+// Writing
+
+bool packed_writer_open(PackedWriter* writer, const char* path, PackedKind kind) {
+    memset(writer, 0, sizeof(PackedWriter));
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        return false;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, PACKED_IO_BUFFER);
+    writer->kind = kind;
+    
+    // Placeholder header, rewritten with the final count on close
+    PackedHeader header = { PACKED_MAGIC, PACKED_VERSION, (uint16_t)kind, 0 };
+    return fwrite(&header, sizeof(header), 1, writer->file) == 1;
+}
+
+bool packed_write_positions(PackedWriter* writer, const PackedPosition* positions, size_t count) {
+    if (writer->kind != PACKED_POSITIONS) {
+        return false;
+    }
+    size_t written = fwrite(positions, sizeof(PackedPosition), count, writer->file);
+    writer->count += written;
+    return written == count;
+}
+
+bool packed_write_game(PackedWriter* writer, const PackedPosition* start, const Move* moves, int move_count) {
+    if (writer->kind != PACKED_GAMES || move_count < 0 || move_count > PACKED_MAX_MOVES) {
+        return false;
+    }
+    
+    uint16_t count = (uint16_t)move_count;
+    size_t bytes = sizeof(PackedPosition) + sizeof(uint16_t) + move_count * sizeof(Move);
+    size_t padding = (8 - bytes % 8) % 8;
+    static const uint8_t zeros[8] = { 0 };
+    
+    bool ok = fwrite(start, sizeof(PackedPosition), 1, writer->file) == 1 &&
+              fwrite(&count, sizeof(count), 1, writer->file) == 1 &&
+              fwrite(moves, sizeof(Move), move_count, writer->file) == (size_t)move_count &&
+              fwrite(zeros, 1, padding, writer->file) == padding;
+    if (ok) {
+        writer->count++;
+    }
+    return ok;
+}
+
+bool packed_writer_close(PackedWriter* writer) {
+    if (!writer->file) {
+        return false;
+    }
+    
+    PackedHeader header = { PACKED_MAGIC, PACKED_VERSION, (uint16_t)writer->kind, writer->count };
+    bool ok = fseek(writer->file, 0, SEEK_SET) == 0 &&
+              fwrite(&header, sizeof(header), 1, writer->file) == 1;
+    ok = (fclose(writer->file) == 0) && ok;
+    writer->file = NULL;
+    return ok;
+}
+
+
+// Reading
+
+static bool valid_header(const PackedHeader* header) {
+    return header->magic == PACKED_MAGIC && header->version == PACKED_VERSION &&
+           (header->kind == PACKED_POSITIONS || header->kind == PACKED_GAMES);
+}
+
+bool packed_reader_open(PackedReader* reader, const char* path) {
+    memset(reader, 0, sizeof(PackedReader));
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        return false;
+    }
+    setvbuf(reader->file, NULL, _IOFBF, PACKED_IO_BUFFER);
+    
+    PackedHeader header;
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 || !valid_header(&header)) {
+        packed_reader_close(reader);
+        return false;
+    }
+    reader->kind = (PackedKind)header.kind;
+    reader->count = header.count;
+    return true;
+}
+
+size_t packed_read_positions(PackedReader* reader, PackedPosition* positions, size_t max_count) {
+    if (reader->kind != PACKED_POSITIONS) {
+        return 0;
+    }
+    size_t count = fread(positions, sizeof(PackedPosition), max_count, reader->file);
+    reader->read += count;
+    return count;
+}
+
+int packed_read_game(PackedReader* reader, PackedPosition* start, Move* moves, int max_moves) {
+    if (reader->kind != PACKED_GAMES) {
+        return -1;
+    }
+    
+    uint16_t count;
+    if (fread(start, sizeof(PackedPosition), 1, reader->file) != 1 ||
+        fread(&count, sizeof(count), 1, reader->file) != 1) {
+        return -1;
+    }
+    
+    // Moves beyond max_moves are skipped
+    int kept = count < max_moves ? count : max_moves;
+    if (fread(moves, sizeof(Move), kept, reader->file) != (size_t)kept) {
+        return -1;
+    }
+    size_t bytes = sizeof(PackedPosition) + sizeof(uint16_t) + count * sizeof(Move);
+    long skip = (long)((count - kept) * sizeof(Move) + (8 - bytes % 8) % 8);
+    if (skip > 0 && fseek(reader->file, skip, SEEK_CUR) != 0) {
+        return -1;
+    }
+    
+    reader->read++;
+    return kept;
+}
+
+void packed_reader_close(PackedReader* reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
+
+
+// Memory-Mapped Reading
+
+bool packed_map_open(PackedMap* map, const char* path) {
+    memset(map, 0, sizeof(PackedMap));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PackedHeader)) {
+        close(fd);
+        return false;
+    }
+    
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps the file alive
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    
+    const PackedHeader* header = (const PackedHeader*)data;
+    if (!valid_header(header)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    
+    map->data = data;
+    map->size = st.st_size;
+    map->kind = (PackedKind)header->kind;
+    map->count = header->count;
+    map->offset = sizeof(PackedHeader);
+    
+    // Never trust the count beyond what the file holds
+    if (map->kind == PACKED_POSITIONS) {
+        uint64_t available = (map->size - sizeof(PackedHeader)) / sizeof(PackedPosition);
+        if (map->count > available) map->count = available;
+    }
+    posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+    return true;
+}
+
+const PackedPosition* packed_map_positions(const PackedMap* map) {
+    if (map->kind != PACKED_POSITIONS) {
+        return NULL;
+    }
+    return (const PackedPosition*)(map->data + sizeof(PackedHeader));
+}
+
+bool packed_map_next_game(PackedMap* map, PackedGameView* game) {
+    size_t fixed = sizeof(PackedPosition) + sizeof(uint16_t);
+    if (map->kind != PACKED_GAMES || map->offset + fixed > map->size) {
+        return false;
+    }
+    
+    const uint8_t* record = map->data + map->offset;
+    uint16_t count;
+    memcpy(&count, record + sizeof(PackedPosition), sizeof(count));
+    size_t bytes = fixed + count * sizeof(Move);
+    if (map->offset + bytes > map->size) {
+        return false;
+    }
+    
+    game->start = (const PackedPosition*)record;
+    game->moves = (const Move*)(record + fixed);
+    game->move_count = count;
+    map->offset += bytes + (8 - bytes % 8) % 8;
+    return true;
+}
+
+void packed_map_close(PackedMap* map) {
+    if (map->data) {
+        munmap((void*)map->data, map->size);
+        map->data = NULL;
+    }
+}
+
+
+// Conversion
+
+long long packed_convert_fen(const char* fen_path, const char* out_path) {
+    FILE* file = fopen(fen_path, "r");
+    if (!file) {
+        return -1;
+    }
+    
+    PackedWriter writer;
+    if (!packed_writer_open(&writer, out_path, PACKED_POSITIONS)) {
+        fclose(file);
+        return -1;
+    }
+    
+    Board board;
+    PackedPosition packed;
+    char line[256];
+    bool ok = true;
+    
+    while (ok && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '\0') continue;
+        set_fen(&board, line);
+        pack_position(&board, &packed);
+        ok = packed_write_positions(&writer, &packed, 1);
+    }
+    fclose(file);
+    
+    long long count = (long long)writer.count;
+    ok = packed_writer_close(&writer) && ok;
+    return ok ? count : -1;
+}
+
+long long packed_convert_pgn(const char* pgn_path, const char* out_path, PackedKind kind) {
+    PgnReader reader;
+    if (!pgn_open(&reader, pgn_path)) {
+        return -1;
+    }
+    
+    PackedWriter writer;
+    if (!packed_writer_open(&writer, out_path, kind)) {
+        pgn_close(&reader);
+        return -1;
+    }
+    
+    PgnGame* game = malloc(sizeof(PgnGame));
+    Board* board = malloc(sizeof(Board));
+    PackedPosition packed;
+    bool ok = game && board;
+    
+    while (ok && pgn_read_game(&reader, game)) {
+        set_fen(board, game->start_fen);
+        pack_position(board, &packed);
+        packed.result = (uint8_t)game->result;
+        
+        if (kind == PACKED_GAMES) {
+            ok = packed_write_game(&writer, &packed, game->moves, game->move_count);
+            continue;
+        }
+        
+        // Every position before each move
+        for (int i = 0; ok && i < game->move_count; i++) {
+            if (i > 0) {
+                pack_position(board, &packed);
+                packed.result = (uint8_t)game->result;
+            }
+            ok = packed_write_positions(&writer, &packed, 1);
+            make_move(board, game->moves[i]);
+            if (board->history_index >= MAX_PLY - 1) {
+                compact_history(board);
+            }
+        }
+    }
+    
+    free(board);
+    free(game);
+    pgn_close(&reader);
+    
+    long long count = (long long)writer.count;
+    ok = packed_writer_close(&writer) && ok;
+    return ok ? count : -1;
+}
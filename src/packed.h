@@ -0,0 +1,105 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "types.h"
+#include "board.h"
+#include <stdio.h>
+#include <stddef.h>
+
+// Binary position and game files
+// Layout: a PackedHeader, then records. A position file holds PackedPosition records.
+// A game file holds per game: the start PackedPosition (its result field is the game
+// result), a uint16_t move count, the Moves, then zero padding to a multiple of 8 bytes.
+// Fields are written in host (little-endian) byte order.
+
+#define PACKED_MAGIC 0x4B505A5A  // "ZZPK"
+#define PACKED_VERSION 1
+#define PACKED_NO_SCORE INT16_MIN
+#define PACKED_MAX_MOVES 65535
+
+typedef enum {
+    PACKED_POSITIONS = 1,
+    PACKED_GAMES = 2
+} PackedKind;
+
+// A position in 32 bytes
+typedef struct {
+    Bitboard occupied;           // Occupied squares
+    uint8_t pieces[16];          // One nibble per occupied square, A1 to H8: color << 3 | piece type
+    uint8_t state;               // Bit 0: side to move, bits 1-4: castling rights
+    uint8_t en_passant_square;   // NO_SQUARE if none
+    uint8_t halfmove_clock;      // Saturates at 255
+    uint8_t result;              // GameResult of the game the position comes from, ONGOING if unknown
+    uint16_t fullmove_number;
+    int16_t score;               // Search score for the side to move, PACKED_NO_SCORE if unknown
+} PackedPosition;
+
+_Static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t kind;
+    uint64_t count;              // Number of records (positions or games)
+} PackedHeader;
+
+// Buffered writer; the header count is filled in on close
+typedef struct {
+    FILE* file;
+    PackedKind kind;
+    uint64_t count;
+} PackedWriter;
+
+// Buffered reader
+typedef struct {
+    FILE* file;
+    PackedKind kind;
+    uint64_t count;
+    uint64_t read;
+} PackedReader;
+
+// Read-only memory-mapped file
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    PackedKind kind;
+    uint64_t count;
+    size_t offset;               // Game cursor
+} PackedMap;
+
+// A game inside a mapped file (points into the mapping, nothing is copied)
+typedef struct {
+    const PackedPosition* start;
+    const Move* moves;
+    int move_count;
+} PackedGameView;
+
+// Position encoding
+void pack_position(const Board* board, PackedPosition* packed);
+bool unpack_position(const PackedPosition* packed, Board* board);
+
+// Writing
+bool packed_writer_open(PackedWriter* writer, const char* path, PackedKind kind);
+bool packed_write_positions(PackedWriter* writer, const PackedPosition* positions, size_t count);
+bool packed_write_game(PackedWriter* writer, const PackedPosition* start, const Move* moves, int move_count);
+bool packed_writer_close(PackedWriter* writer);
+
+// Reading (returns the number of positions read / the move count, -1 at end of file)
+bool packed_reader_open(PackedReader* reader, const char* path);
+size_t packed_read_positions(PackedReader* reader, PackedPosition* positions, size_t max_count);
+int packed_read_game(PackedReader* reader, PackedPosition* start, Move* moves, int max_moves);
+void packed_reader_close(PackedReader* reader);
+
+// Memory-mapped reading
+bool packed_map_open(PackedMap* map, const char* path);
+const PackedPosition* packed_map_positions(const PackedMap* map);
+bool packed_map_next_game(PackedMap* map, PackedGameView* game);
+void packed_map_close(PackedMap* map);
+
+// Conversion from text formats (returns the number of records written, -1 on error)
+// FEN files hold one position per line. A PGN file becomes one game record per game,
+// or, with PACKED_POSITIONS, one position record per ply labelled with the game result.
+long long packed_convert_fen(const char* fen_path, const char* out_path);
+long long packed_convert_pgn(const char* pgn_path, const char* out_path, PackedKind kind);
+
+#endif // PACKED_H
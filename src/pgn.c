@@ -0,0 +1,254 @@
+#include "pgn.h"
+#include "board.h"
+#include "moves.h"
+#include "notation.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Longest movetext token kept (longer tokens are truncated and rejected as moves)
+#define PGN_TOKEN_SIZE 64
+
+
+// Open and Close
+
+bool pgn_open(PgnReader* reader, const char* path) {
+    memset(reader, 0, sizeof(PgnReader));
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        return false;
+    }
+    reader->buffer = malloc(PGN_BLOCK_SIZE);
+    reader->data = reader->buffer;
+    return reader->buffer != NULL;
+}
+
+void pgn_open_memory(PgnReader* reader, const char* data, size_t length) {
+    memset(reader, 0, sizeof(PgnReader));
+    reader->data = data;
+    reader->length = length;
+}
+
+void pgn_close(PgnReader* reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
+
+
+// Character Input
+
+static bool refill(PgnReader* reader) {
+    if (!reader->file) {
+        return false;
+    }
+    reader->length = fread(reader->buffer, 1, PGN_BLOCK_SIZE, reader->file);
+    reader->pos = 0;
+    return reader->length > 0;
+}
+
+static inline int peek_char(PgnReader* reader) {
+    if (reader->pos == reader->length && !refill(reader)) {
+        return EOF;
+    }
+    return (unsigned char)reader->data[reader->pos];
+}
+
+static inline int next_char(PgnReader* reader) {
+    int c = peek_char(reader);
+    if (c != EOF) {
+        reader->pos++;
+    }
+    return c;
+}
+
+static inline bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline bool is_delimiter(int c) {
+    return is_space(c) || c == '{' || c == '}' || c == '(' || c == ')' ||
+           c == ';' || c == '[' || c == EOF;
+}
+
+static void skip_line(PgnReader* reader) {
+    int c;
+    while ((c = next_char(reader)) != EOF && c != '\n') {}
+}
+
+static void skip_comment(PgnReader* reader) {
+    int c;
+    while ((c = next_char(reader)) != EOF && c != '}') {}
+}
+
+static void skip_variation(PgnReader* reader) {
+    int depth = 1;
+    int c;
+    while (depth > 0 && (c = next_char(reader)) != EOF) {
+        if (c == '(') depth++;
+        else if (c == ')') depth--;
+        else if (c == '{') skip_comment(reader);
+        else if (c == ';') skip_line(reader);
+    }
+}
+
+
+// Tag Section
+
+// Copy characters up to (not including) the terminator, truncating to size
+static void read_until(PgnReader* reader, int terminator, char* out, size_t size, bool escapes) {
+    size_t n = 0;
+    int c;
+    while ((c = next_char(reader)) != EOF && c != terminator && c != '\n') {
+        if (escapes && c == '\\') {
+            c = next_char(reader);
+            if (c == EOF) break;
+        }
+        if (n + 1 < size) out[n++] = (char)c;
+    }
+    out[n] = '\0';
+}
+
+static void read_tag(PgnReader* reader, PgnGame* game) {
+    PgnTag scratch;
+    PgnTag* tag = (game->tag_count < PGN_MAX_TAGS) ? &game->tags[game->tag_count] : &scratch;
+    
+    next_char(reader);  // '['
+    while (is_space(peek_char(reader))) next_char(reader);
+    
+    size_t n = 0;
+    int c;
+    while ((c = peek_char(reader)) != EOF && !is_space(c) && c != '"' && c != ']') {
+        if (n + 1 < sizeof(tag->name)) tag->name[n++] = (char)c;
+        next_char(reader);
+    }
+    tag->name[n] = '\0';
+    
+    while ((c = peek_char(reader)) != EOF && c != '"' && c != ']' && c != '\n') next_char(reader);
+    
+    tag->value[0] = '\0';
+    if (peek_char(reader) == '"') {
+        next_char(reader);
+        read_until(reader, '"', tag->value, sizeof(tag->value), true);
+    }
+    skip_line(reader);  // Rest of the tag line including ']'
+    
+    if (tag != &scratch && tag->name[0] != '\0') {
+        game->tag_count++;
+    }
+}
+
+const char* pgn_tag(const PgnGame* game, const char* name) {
+    for (int i = 0; i < game->tag_count; i++) {
+        if (strcmp(game->tags[i].name, name) == 0) {
+            return game->tags[i].value;
+        }
+    }
+    return NULL;
+}
+
+
+// Movetext
+
+static bool parse_result(const char* token, GameResult* result) {
+    if (strcmp(token, "1-0") == 0) *result = WHITE_WINS;
+    else if (strcmp(token, "0-1") == 0) *result = BLACK_WINS;
+    else if (strcmp(token, "1/2-1/2") == 0) *result = DRAW;
+    else if (strcmp(token, "*") == 0) *result = ONGOING;
+    else return false;
+    return true;
+}
+
+static void play_token(PgnGame* game, const char* token, int length) {
+    // Skip a move number prefix: "12." "12..." or "1.e4"
+    int i = 0;
+    while (i < length && token[i] >= '0' && token[i] <= '9') i++;
+    if (i < length && token[i] == '.') {
+        while (i < length && token[i] == '.') i++;
+    } else {
+        i = 0;
+    }
+    if (i == length || game->error) {
+        return;
+    }
+    
+    Move move = san_to_move(&game->board, token + i, length - i);
+    if (move == 0 || game->move_count >= PGN_MAX_PLIES) {
+        game->error = true;
+        return;
+    }
+    
+    make_move(&game->board, move);
+    game->moves[game->move_count++] = move;
+    
+    if (game->board.history_index >= MAX_PLY - 1) {
+        compact_history(&game->board);
+    }
+}
+
+bool pgn_read_game(PgnReader* reader, PgnGame* game) {
+    game->tag_count = 0;
+    game->move_count = 0;
+    game->result = ONGOING;
+    game->error = false;
+    
+    // Tag section
+    int c;
+    bool found = false;
+    while ((c = peek_char(reader)) != EOF) {
+        if (is_space(c)) {
+            next_char(reader);
+        } else if (c == '[') {
+            read_tag(reader, game);
+            found = true;
+        } else if (c == '%') {
+            skip_line(reader);  // Escape line
+        } else {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    
+    const char* fen = pgn_tag(game, "FEN");
+    strncpy(game->start_fen, fen ? fen : START_FEN, sizeof(game->start_fen) - 1);
+    game->start_fen[sizeof(game->start_fen) - 1] = '\0';
+    set_fen(&game->board, game->start_fen);
+    
+    // Movetext, up to the result token or the next tag section
+    char token[PGN_TOKEN_SIZE];
+    while ((c = peek_char(reader)) != EOF) {
+        if (c == '[') {
+            break;
+        }
+        next_char(reader);
+        
+        if (is_space(c) || c == ')' || c == '}') continue;
+        if (c == '{') { skip_comment(reader); continue; }
+        if (c == ';') { skip_line(reader); continue; }
+        if (c == '(') { skip_variation(reader); continue; }
+        if (c == '$') {
+            while ((c = peek_char(reader)) >= '0' && c <= '9') next_char(reader);
+            continue;
+        }
+        
+        int length = 0;
+        token[length++] = (char)c;
+        while (!is_delimiter(c = peek_char(reader))) {
+            if (length + 1 < PGN_TOKEN_SIZE) token[length++] = (char)c;
+            next_char(reader);
+        }
+        token[length] = '\0';
+        
+        if (parse_result(token, &game->result)) {
+            break;
+        }
+        play_token(game, token, length);
+    }
+    
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include "types.h"
+#include "board.h"
+#include <stdio.h>
+#include <stddef.h>
+
+// Limits (games or tags beyond these are truncated)
+#define PGN_MAX_TAGS 32
+#define PGN_MAX_PLIES 2048
+#define PGN_BLOCK_SIZE (1 << 20)
+
+// One header tag: [Name "Value"]
+typedef struct {
+    char name[32];
+    char value[128];
+} PgnTag;
+
+// A decoded game. Reused between games, nothing is allocated per move.
+typedef struct {
+    PgnTag tags[PGN_MAX_TAGS];
+    int tag_count;
+    char start_fen[128];
+    Move moves[PGN_MAX_PLIES];
+    int move_count;
+    GameResult result;      // ONGOING for '*' or a missing result token
+    bool error;             // Movetext had an unreadable move; moves before it are kept
+    Board board;            // Position after the last decoded move
+} PgnGame;
+
+// Streaming reader over a file (read in large blocks) or a memory buffer
+typedef struct {
+    FILE* file;
+    char* buffer;           // Block buffer (file input only)
+    const char* data;       // Current block or memory buffer
+    size_t length;
+    size_t pos;
+} PgnReader;
+
+// Open and close
+bool pgn_open(PgnReader* reader, const char* path);
+void pgn_open_memory(PgnReader* reader, const char* data, size_t length);
+void pgn_close(PgnReader* reader);
+
+// Read the next game, returns false at end of input
+bool pgn_read_game(PgnReader* reader, PgnGame* game);
+
+// Tag lookup (NULL if the tag is absent)
+const char* pgn_tag(const PgnGame* game, const char* name);
+
+#endif // PGN_H
@@ -1,41 +1,88 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "search.h"
+#include "bitbase.h"
+#include "bitboard.h"
 #include "board.h"
 #include "moves.h"
 #include "movegen.h"
 #include "evaluation.h"
+#include "tablebase.h"
 #include "transposition.h"
+#include "zobrist.h"
+#include <stdlib.h>
 #include <string.h>
 
 
 // Heuristic Updates
 
-void update_killers(Move move, int ply) {
-    if (ply >= MAX_PLY) return;
-    
+void init_search_stack(SearchStack* stack) {
+    memset(stack, 0, SEARCH_STACK_SIZE * sizeof(SearchStack));
+}
+
+void update_killers(SearchStack* ss, Move move) {
     // Don't add if already first killer
-    if (killer_moves[ply][0] == move) return;
+    if (ss->killers[0] == move) return;
     
     // Shift killers
-    killer_moves[ply][1] = killer_moves[ply][0];
-    killer_moves[ply][0] = move;
+    ss->killers[1] = ss->killers[0];
+    ss->killers[0] = move;
 }
 
-void update_history(Move move, Color color, int depth) {
-    Square from = move_from(move);
-    Square to = move_to(move);
-    
-    // Bonus based on depth squared
-    history_table[color][from][to] += depth * depth;
+// Moves ordered by the quiet move heuristics
+static bool is_quiet(Move move) {
+    return !is_capture(move) && !is_promotion(move);
+}
+
+// Gravity update: the entry moves by bonus, less the closer it already is to the bound on that
+// side, so it stays within HISTORY_MAX and old results fade as new ones come in
+static int apply_gravity(int value, int bonus) {
+    return value + bonus - value * abs(bonus) / HISTORY_MAX;
+}
+
+int history_bonus(int depth) {
+    int bonus = 32 * depth * depth;
+    return bonus < HISTORY_MAX / 2 ? bonus : HISTORY_MAX / 2;
+}
+
+void update_history(Move move, Color color, int bonus) {
+    int* entry = &history_table[color][move_from(move)][move_to(move)];
+    *entry = apply_gravity(*entry, bonus);
+}
+
+// Continuation history of a move after the moves one and two plies earlier
+static void update_continuation(const Board* board, SearchStack* ss, int ply, Move move, int bonus) {
+    int piece = board->side_to_move * 6 + piece_on(board, move_from(move));
+    for (int back = 1; back <= 2 && back <= ply; back++) {
+        if ((ss - back)->continuation) {
+            int16_t* entry = &(*(ss - back)->continuation)[piece][move_to(move)];
+            *entry = (int16_t)apply_gravity(*entry, bonus);
+        }
+    }
+}
+
+void update_quiet_stats(const Board* board, SearchStack* ss, int ply, Move move,
+                        const Move* quiets, int quiet_count, int depth) {
+    update_killers(ss, move);
+    if (ply >= 1 && (ss - 1)->continuation) {
+        counter_moves[(ss - 1)->moved_piece][move_to((ss - 1)->current_move)] = move;
+    }
     
-    // Prevent overflow
-    if (history_table[color][from][to] > 10000) {
-        history_table[color][from][to] = 10000;
+    // The cutting move gains, the quiets searched before it lose as much
+    int bonus = history_bonus(depth);
+    Color us = board->side_to_move;
+    update_history(move, us, bonus);
+    update_continuation(board, ss, ply, move, bonus);
+    for (int i = 0; i < quiet_count; i++) {
+        update_history(quiets[i], us, -bonus);
+        update_continuation(board, ss, ply, quiets[i], -bonus);
     }
 }
 
 void clear_heuristics(void) {
-    memset(killer_moves, 0, sizeof(killer_moves));
     memset(history_table, 0, sizeof(history_table));
+    memset(counter_moves, 0, sizeof(counter_moves));
+    memset(continuation_history, 0, sizeof(continuation_history));
 }
 
 
@@ -46,27 +93,45 @@ void init_search(SearchInfo* info) {
     info->qnodes_searched = 0;
     info->tt_hits = 0;
     info->tt_cutoffs = 0;
+    info->bitbase_hits = 0;
+    info->tb_hits = 0;
+    info->eval_cache_probes = 0;
+    info->eval_cache_hits = 0;
+    info->hashfull = 0;
+    info->beta_cutoffs = 0;
+    info->first_move_cutoffs = 0;
     info->best_move = 0;
     info->pv_length = 0;
     info->selective_depth = 0;
     info->time_up = false;
+    info->pv_line_count = 0;
+    reset_eval_cache_stats();
+}
+
+// Copies the evaluation cache counters of this thread (reset by init_search) and the
+// transposition table's occupancy into info
+static void record_cache_stats(SearchInfo* info, const SearchParams* params) {
+    EvalCacheStats stats;
+    get_eval_cache_stats(&stats);
+    info->eval_cache_probes = stats.probes;
+    info->eval_cache_hits = stats.hits;
+    info->hashfull = params->tt ? tt_hashfull(params->tt) : 0;
 }
 
 bool is_draw(const Board* board) {
     return is_fifty_move_draw(board) || is_repetition(board) || is_insufficient_material(board);
 }
 
-int evaluate_terminal(const Board* board, int ply) {
-    // If in check, it's checkmate
-    if (is_in_check(board, board->side_to_move)) {
-        return -MATE_SCORE + ply;  // Negative for side to move
-    }
-    
-    // Otherwise it's stalemate
-    return DRAW_SCORE;
+bool should_stop_search(const SearchInfo* info) {
+    return info->time_up;
 }
 
-bool should_stop_search(const SearchInfo* info) {
+// Flags the search as stopped once the node limit is exhausted
+static bool check_node_limit(SearchInfo* info, const SearchParams* params) {
+    if (params->max_nodes &&
+        (uint64_t)info->nodes_searched + (uint64_t)info->qnodes_searched >= params->max_nodes) {
+        info->time_up = true;
+    }
     return info->time_up;
 }
 
@@ -76,14 +141,14 @@ bool should_stop_search(const SearchInfo* info) {
 void extract_pv(Board* board, TranspositionTable* tt, Move* pv, int* length) {
     *length = 0;
     
-    for (int i = 0; i < MAX_PLY; i++) {
-        TTEntry* entry = probe_tt(tt, board->hash);
-        
-        if (!entry || entry->best_move == 0) {
+    // Stop before the board's undo stack would overflow
+    for (int i = 0; i < MAX_PLY && board->history_index < MAX_PLY; i++) {
+        TTEntry entry;
+        if (!probe_tt(tt, board, &entry) || entry.best_move == 0) {
             break;
         }
         
-        Move move = entry->best_move;
+        Move move = entry.best_move;
         
         // Verify move is legal
         if (!is_legal(board, move)) {
@@ -106,13 +171,22 @@ void extract_pv(Board* board, TranspositionTable* tt, Move* pv, int* length) {
 int quiescence_search(Board* board, int alpha, int beta, int ply, SearchInfo* info, SearchParams* params) {
     info->qnodes_searched++;
     
+    if (check_node_limit(info, params)) {
+        return 0;
+    }
+    
     // Check for draw
     if (is_draw(board)) {
         return DRAW_SCORE;
     }
     
-    // Stand pat
-    int stand_pat = evaluate(board);
+    // No room left on the board's undo and history stacks
+    if (board->history_index >= MAX_PLY - 2) {
+        return evaluate(board);
+    }
+    
+    // Stand pat (lazy: only the sign relative to the window matters far outside it)
+    int stand_pat = evaluate_window(board, alpha, beta);
     
     if (stand_pat >= beta) {
         return beta;
@@ -131,6 +205,10 @@ int quiescence_search(Board* board, int alpha, int beta, int ply, SearchInfo* in
         int score = -quiescence_search(board, -beta, -alpha, ply + 1, info, params);
         unmake_move(board, list.moves[i]);
         
+        if (info->time_up) {
+            return 0;
+        }
+        
         if (score >= beta) {
             return beta;
         }
@@ -146,9 +224,15 @@ int quiescence_search(Board* board, int alpha, int beta, int ply, SearchInfo* in
 
 // Negamax Search
 
-int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* info, SearchParams* params) {
+// ss is stack[ply]: the node's own entry, with its parent's at ss - 1
+static int search_node(Board* board, int depth, int alpha, int beta, int ply, SearchStack* ss,
+                       SearchInfo* info, SearchParams* params) {
     info->nodes_searched++;
     
+    if (check_node_limit(info, params)) {
+        return 0;
+    }
+    
     // Update selective depth
     if (ply > info->selective_depth) {
         info->selective_depth = ply;
@@ -159,8 +243,41 @@ int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* i
         return DRAW_SCORE;
     }
     
-    // Quiescence search at leaf nodes
-    if (depth <= 0) {
+    // Mate distance pruning: nothing here beats mating at the next ply or is worse than being
+    // mated now, so a mate found nearer the root settles the window
+    if (ply > 0) {
+        if (alpha < -MATE_SCORE + ply) {
+            alpha = -MATE_SCORE + ply;
+        }
+        if (beta > MATE_SCORE - ply - 1) {
+            beta = MATE_SCORE - ply - 1;
+        }
+        if (alpha >= beta) {
+            return alpha;
+        }
+    }
+    
+    // Few pieces left: the tablebase result is exact
+    TbResult tb;
+    if (ply > 0 && tb_max_pieces && popcount(board->all_occupied) <= tb_max_pieces && probe_tablebase(board, &tb)) {
+        info->tb_hits++;
+        return tablebase_score(&tb);
+    }
+    
+    // King and pawn against king: the bitbase knows the result, no need to search
+    if (ply > 0 && is_kpk(board)) {
+        info->bitbase_hits++;
+        return evaluate(board);
+    }
+    
+    // Check extension: evasions are searched a ply deeper, so checks are never cut by the horizon
+    ss->in_check = is_in_check(board, board->side_to_move);
+    if (ss->in_check) {
+        depth++;
+    }
+    
+    // Quiescence search at leaf nodes (or when the board's or the search's stacks are nearly full)
+    if (depth <= 0 || board->history_index >= MAX_PLY - 2 || ply >= MAX_PLY - 1) {
         if (params->use_quiescence) {
             return quiescence_search(board, alpha, beta, ply, info, params);
         } else {
@@ -171,13 +288,14 @@ int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* i
     // Transposition table lookup
     Move hash_move = 0;
     if (params->tt) {
-        TTEntry* entry = probe_tt(params->tt, board->hash);
-        if (entry) {
+        TTEntry entry;
+        if (probe_tt(params->tt, board, &entry)) {
             info->tt_hits++;
-            hash_move = entry->best_move;
+            hash_move = entry.best_move;
+            entry.score = (int16_t)unadjust_mate_score(entry.score, ply);
             
             int tt_score;
-            if (tt_cutoff(entry, depth, alpha, beta, &tt_score)) {
+            if (tt_cutoff(&entry, depth, alpha, beta, &tt_score)) {
                 info->tt_cutoffs++;
                 return tt_score;
             }
@@ -190,24 +308,52 @@ int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* i
     
     // Check for terminal position
     if (list.count == 0) {
-        return evaluate_terminal(board, ply);
+        return ss->in_check ? -MATE_SCORE + ply : DRAW_SCORE;
     }
     
-    order_moves(board, &list, hash_move, ply);
+    // Quiet moves are ordered by what refuted the previous move and by what worked after the
+    // last two moves
+    OrderContext context = { .killers = ss->killers };
+    if (ply >= 1 && (ss - 1)->continuation) {
+        context.counter_move = counter_moves[(ss - 1)->moved_piece][move_to((ss - 1)->current_move)];
+        context.continuation[0] = (ss - 1)->continuation;
+    }
+    if (ply >= 2 && (ss - 2)->continuation) {
+        context.continuation[1] = (ss - 2)->continuation;
+    }
+    order_moves(board, &list, hash_move, &context);
     
     // Search moves
     int best_score = -INFINITE;
     Move best_move = 0;
     TTFlag flag = TT_UPPER;
+    Move quiets[MAX_MOVES];
+    int quiet_count = 0;
+    
+    // Children above the quiescence horizon probe the TT first thing
+    bool prefetch = params->tt && depth > 1;
     
     for (int i = 0; i < list.count; i++) {
-        make_move(board, list.moves[i]);
-        int score = -negamax(board, depth - 1, -beta, -alpha, ply + 1, info, params);
-        unmake_move(board, list.moves[i]);
+        Move move = list.moves[i];
+        
+        // Start loading the child's entry while the move is made
+        if (prefetch) {
+            prefetch_tt(params->tt, hash_after_move(board, move));
+        }
+        ss->current_move = move;
+        ss->moved_piece = (uint8_t)(board->side_to_move * 6 + piece_on(board, move_from(move)));
+        ss->continuation = &continuation_history[ss->moved_piece][move_to(move)];
+        make_move(board, move);
+        int score = -search_node(board, depth - 1, -beta, -alpha, ply + 1, ss + 1, info, params);
+        unmake_move(board, move);
+        
+        if (info->time_up) {
+            return 0;
+        }
         
         if (score > best_score) {
             best_score = score;
-            best_move = list.moves[i];
+            best_move = move;
             
             if (score > alpha) {
                 alpha = score;
@@ -215,34 +361,187 @@ int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* i
                 
                 if (score >= beta) {
                     flag = TT_LOWER;
+                    info->beta_cutoffs++;
+                    info->first_move_cutoffs += i == 0;
                     
                     // Update heuristics for quiet moves
-                    if (!is_capture(list.moves[i])) {
-                        update_killers(list.moves[i], ply);
-                        update_history(list.moves[i], board->side_to_move, depth);
+                    if (is_quiet(move)) {
+                        update_quiet_stats(board, ss, ply, move, quiets, quiet_count, depth);
                     }
                     
                     break;  // Beta cutoff
                 }
             }
         }
+        
+        if (is_quiet(move)) {
+            quiets[quiet_count++] = move;
+        }
     }
     
     // Store in transposition table
     if (params->tt && best_move != 0) {
-        store_tt(params->tt, board->hash, best_score, best_move, depth, flag);
+        store_tt(params->tt, board->hash, adjust_mate_score(best_score, ply), best_move, depth, flag);
+#ifdef DEBUG
+        record_tt_position(params->tt, board);
+#endif
+    }
+    
+    return best_score;
+}
+
+int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* info, SearchParams* params) {
+    if (ply < 0 || ply >= MAX_PLY) {
+        return evaluate(board);
+    }
+    
+    SearchStack stack[SEARCH_STACK_SIZE];
+    init_search_stack(stack);
+    return search_node(board, depth, alpha, beta, ply, stack + 1 + ply, info, params);
+}
+
+
+// Move to play when the first iteration was cut short by the node limit
+static Move fallback_move(const Board* board, SearchInfo* info) {
+    MoveList list;
+    generate_moves(board, &list);
+    
+    if (list.count == 0) {
+        return 0;
+    }
+    
+    order_moves(board, &list, 0, NULL);
+    info->best_move = list.moves[0];
+    info->pv[0] = list.moves[0];
+    info->pv_length = 1;
+    return list.moves[0];
+}
+
+
+// Root Search (MultiPV)
+
+static bool is_excluded(Move move, const Move* excluded, int excluded_count) {
+    for (int i = 0; i < excluded_count; i++) {
+        if (excluded[i] == move) return true;
+    }
+    return false;
+}
+
+// Full-window search of the root moves, skipping the excluded ones.
+// Nothing is stored in the TT for the root itself, since the result of an
+// excluded-move search is not the true value of the position.
+static int search_root(Board* board, int depth, const Move* excluded, int excluded_count,
+                       Move hash_move, Move* best_move, SearchStack* stack,
+                       SearchInfo* info, SearchParams* params) {
+    info->nodes_searched++;
+    *best_move = 0;
+    
+    SearchStack* ss = stack + 1;
+    ss->in_check = is_in_check(board, board->side_to_move);
+    
+    MoveList list;
+    generate_moves(board, &list);
+    OrderContext context = { .killers = ss->killers };
+    order_moves(board, &list, hash_move, &context);
+    
+    int alpha = -INFINITE;
+    int best_score = -INFINITE;
+    
+    for (int i = 0; i < list.count; i++) {
+        if (is_excluded(list.moves[i], excluded, excluded_count)) continue;
+        
+        ss->current_move = list.moves[i];
+        ss->moved_piece = (uint8_t)(board->side_to_move * 6 + piece_on(board, move_from(list.moves[i])));
+        ss->continuation = &continuation_history[ss->moved_piece][move_to(list.moves[i])];
+        make_move(board, list.moves[i]);
+        int score = -search_node(board, depth - 1, -INFINITE, -alpha, 1, ss + 1, info, params);
+        unmake_move(board, list.moves[i]);
+        
+        if (info->time_up) {
+            return 0;
+        }
+        
+        if (score > best_score) {
+            best_score = score;
+            *best_move = list.moves[i];
+            if (score > alpha) alpha = score;
+        }
     }
     
     return best_score;
 }
 
+// Build a PV line from a root move followed by the TT line of the child position
+static void build_pv_line(Board* board, Move root_move, int score, int depth,
+                          TranspositionTable* tt, PVLine* line) {
+    line->pv[0] = root_move;
+    line->pv_length = 1;
+    line->score = score;
+    line->depth = depth;
+    
+    if (!tt) return;
+    
+    Move child_pv[MAX_PLY];
+    int child_length = 0;
+    make_move(board, root_move);
+    extract_pv(board, tt, child_pv, &child_length);
+    unmake_move(board, root_move);
+    
+    for (int i = 0; i < child_length && line->pv_length < MAX_PLY; i++) {
+        line->pv[line->pv_length++] = child_pv[i];
+    }
+}
+
+static Move multi_pv_deepening(Board* board, int max_depth, SearchInfo* info, SearchParams* params) {
+    int line_count = params->multi_pv < MAX_MULTI_PV ? params->multi_pv : MAX_MULTI_PV;
+    PVLine lines[MAX_MULTI_PV];
+    Move best_move = 0;
+    SearchStack stack[SEARCH_STACK_SIZE];
+    init_search_stack(stack);
+    
+    for (int depth = 1; depth <= max_depth; depth++) {
+        Move excluded[MAX_MULTI_PV];
+        int found = 0;
+        
+        // Each line searches the root without the moves of the better lines
+        for (int k = 0; k < line_count; k++) {
+            Move hint = (k < info->pv_line_count) ? info->pv_lines[k].pv[0] : 0;
+            Move move;
+            int score = search_root(board, depth, excluded, found, hint, &move, stack, info, params);
+            
+            if (move == 0 || should_stop_search(info)) break;
+            
+            build_pv_line(board, move, score, depth, params->tt, &lines[found]);
+            excluded[found++] = move;
+        }
+        
+        // Keep the previous iteration if this one was interrupted
+        if (should_stop_search(info) || found == 0) {
+            break;
+        }
+        
+        memcpy(info->pv_lines, lines, found * sizeof(PVLine));
+        info->pv_line_count = found;
+        
+        best_move = lines[0].pv[0];
+        info->best_move = best_move;
+        memcpy(info->pv, lines[0].pv, lines[0].pv_length * sizeof(Move));
+        info->pv_length = lines[0].pv_length;
+    }
+    
+    return best_move ? best_move : fallback_move(board, info);
+}
+
 
 // Find Best Move
 
 Move find_best_move(Board* board, int depth, SearchInfo* info, SearchParams* params) {
     init_search(info);
     
-    negamax(board, depth, -INFINITE, INFINITE, 0, info, params);
+    SearchStack stack[SEARCH_STACK_SIZE];
+    init_search_stack(stack);
+    search_node(board, depth, -INFINITE, INFINITE, 0, stack + 1, info, params);
+    record_cache_stats(info, params);
     
     // Extract PV
     if (params->tt) {
@@ -262,9 +561,19 @@ Move iterative_deepening(Board* board, int max_depth, SearchInfo* info, SearchPa
     init_search(info);
     clear_heuristics();
     
+    if (params->multi_pv > 1) {
+        Move move = multi_pv_deepening(board, max_depth, info, params);
+        record_cache_stats(info, params);
+        return move;
+    }
+    
     Move best_move = 0;
     int prev_score = 0;
     
+    // One stack for all iterations, so the killers of one iteration order the next
+    SearchStack stack[SEARCH_STACK_SIZE];
+    init_search_stack(stack);
+    
     for (int depth = 1; depth <= max_depth; depth++) {
         int alpha = -INFINITE;
         int beta = INFINITE;
@@ -275,11 +584,16 @@ Move iterative_deepening(Board* board, int max_depth, SearchInfo* info, SearchPa
             beta = prev_score + params->aspiration_window;
         }
         
-        int score = negamax(board, depth, alpha, beta, 0, info, params);
+        int score = search_node(board, depth, alpha, beta, 0, stack + 1, info, params);
         
         // Re-search with full window if we fell outside aspiration window
         if (params->use_aspiration && depth > 3 && (score <= alpha || score >= beta)) {
-            score = negamax(board, depth, -INFINITE, INFINITE, 0, info, params);
+            score = search_node(board, depth, -INFINITE, INFINITE, 0, stack + 1, info, params);
+        }
+        
+        // An interrupted iteration is discarded, the previous one is kept
+        if (should_stop_search(info)) {
+            break;
         }
         
         prev_score = score;
@@ -290,14 +604,22 @@ Move iterative_deepening(Board* board, int max_depth, SearchInfo* info, SearchPa
             if (info->pv_length > 0) {
                 best_move = info->pv[0];
                 info->best_move = best_move;
+                
+                PVLine* line = &info->pv_lines[0];
+                memcpy(line->pv, info->pv, info->pv_length * sizeof(Move));
+                line->pv_length = info->pv_length;
+                line->score = score;
+                line->depth = depth;
+                info->pv_line_count = 1;
             }
         }
         
-        // Check if time is up
-        if (should_stop_search(info)) {
+        // A mate within the full-width depth is proven, deeper iterations only repeat it
+        if (abs(score) >= MATE_SCORE - depth && best_move) {
             break;
         }
     }
     
-    return best_move;
+    record_cache_stats(info, params);
+    return best_move ? best_move : fallback_move(board, info);
 }
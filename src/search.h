@@ -4,15 +4,35 @@
 #include "types.h"
 #include "board.h"
 #include "moves.h"
+#include "movegen.h"
 #include "transposition.h"
+#include "util.h"
 #include <stddef.h>
 
+// Maximum number of principal variations reported in MultiPV mode
+#define MAX_MULTI_PV 16
+
+// One principal variation line (MultiPV)
+typedef struct {
+    Move pv[MAX_PLY];
+    int pv_length;
+    int score;
+    int depth;
+} PVLine;
+
 // Search information and statistics
 typedef struct {
     int nodes_searched;
     int qnodes_searched;
     int tt_hits;
     int tt_cutoffs;
+    int bitbase_hits;               // KPK positions resolved without searching
+    int tb_hits;                    // Positions resolved by a tablebase probe
+    uint64_t eval_cache_probes;     // Evaluation cache lookups of this search
+    uint64_t eval_cache_hits;
+    int hashfull;                   // Permille of the transposition table written by this search
+    uint64_t beta_cutoffs;          // Fail-high nodes of the main search
+    uint64_t first_move_cutoffs;    // Those where the first move searched cut
     Move best_move;
     Move pv[MAX_PLY];
     int pv_length;
@@ -20,24 +40,48 @@ typedef struct {
     bool time_up;
     uint64_t start_time;
     uint64_t time_limit_ms;
+    PVLine pv_lines[MAX_MULTI_PV];  // Best lines, sorted by score (MultiPV)
+    int pv_line_count;
 } SearchInfo;
 
+// Per-ply record of the line being searched: stack[ply] belongs to the node at that ply and is
+// passed down the recursion, so a node can read its parent's entry (ss - 1) and set up its
+// child's (ss + 1)
+typedef struct {
+    Move current_move;      // Move being searched from this node
+    uint8_t moved_piece;    // Its piece, color * 6 + piece type
+    PieceToHistory* continuation;   // Row of continuation_history for current_move (NULL before one)
+    Move killers[2];        // Quiet moves that caused a beta cutoff at this ply
+    bool in_check;          // Side to move is in check, computed once on entering the node
+} SearchStack;
+
+// Room for every ply plus the parent entry of the root
+#define SEARCH_STACK_SIZE (MAX_PLY + 2)
+
 // Search parameters
 typedef struct {
     int max_depth;
     int aspiration_window;
     bool use_aspiration;
     bool use_quiescence;
+    int multi_pv;           // Number of root lines to report (0 or 1 = single PV)
+    uint64_t max_nodes;     // Node limit for the search (0 = unlimited)
     TranspositionTable* tt;
 } SearchParams;
 
-// Killer moves table: [ply][killer_index]
-extern Move killer_moves[MAX_PLY][2];
+// History heuristic table: [color][from][to] (thread-local)
+extern _Thread_local int history_table[2][64][64];
+
+// Quiet move that last refuted a move, by that move's piece and destination (thread-local)
+extern _Thread_local Move counter_moves[12][64];
 
-// History heuristic table: [color][from][to]
-extern int history_table[2][64][64];
+// History of a quiet move by piece and destination, after a given move one or two plies
+// earlier: [previous piece][previous destination][piece][destination] (thread-local)
+extern _Thread_local PieceToHistory continuation_history[12][64];
 
 // Main search functions
+// negamax() searches a node at ply with a fresh search stack; the iterative deepening drivers
+// keep one stack for the whole search. A node in check is searched one ply deeper.
 int negamax(Board* board, int depth, int alpha, int beta, int ply, SearchInfo* info, SearchParams* params);
 
 int quiescence_search(Board* board, int alpha, int beta, int ply, SearchInfo* info, SearchParams* params);
@@ -48,14 +92,17 @@ Move find_best_move(Board* board, int depth, SearchInfo* info, SearchParams* par
 Move iterative_deepening(Board* board, int max_depth, SearchInfo* info, SearchParams* params);
 
 // Heuristic updates
-void update_killers(Move move, int ply);
-void update_history(Move move, Color color, int depth);
+void init_search_stack(SearchStack* stack);
+void update_killers(SearchStack* ss, Move move);
+int history_bonus(int depth);
+void update_history(Move move, Color color, int bonus);
+void update_quiet_stats(const Board* board, SearchStack* ss, int ply, Move move,
+                        const Move* quiets, int quiet_count, int depth);
 void clear_heuristics(void);
 
 // Search utilities
 void init_search(SearchInfo* info);
 bool is_draw(const Board* board);
-int evaluate_terminal(const Board* board, int ply);
 bool should_stop_search(const SearchInfo* info);
 
 // Principal variation
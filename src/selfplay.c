@@ -0,0 +1,321 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "selfplay.h"
+#include "board.h"
+#include "movegen.h"
+#include "moves.h"
+#include "packed.h"
+#include "search.h"
+#include "transposition.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Upper bound on the worker pool size
+#define MAX_SELFPLAY_THREADS 256
+
+// Set by stop_selfplay(), polled by the workers between moves
+static atomic_bool stop_requested;
+
+
+// Shared Generator State
+
+typedef struct {
+    const SelfPlayParams* params;
+    PackedWriter writer;
+    pthread_mutex_t write_lock;
+    bool write_error;
+    atomic_bool table_error;    // A worker could not allocate its transposition table
+    atomic_uint_fast64_t games_started;
+    atomic_uint_fast64_t games;
+    atomic_uint_fast64_t positions;
+    atomic_uint_fast64_t white_wins;
+    atomic_uint_fast64_t black_wins;
+    atomic_uint_fast64_t draws;
+    atomic_uint_fast64_t adjudicated;
+    atomic_uint_fast64_t nodes;
+    atomic_int active_workers;
+} SelfPlayJob;
+
+// Per-worker state
+typedef struct {
+    SelfPlayJob* job;
+    uint64_t rng;
+} SelfPlayWorker;
+
+
+// Parameters
+
+void init_selfplay_params(SelfPlayParams* params) {
+    memset(params, 0, sizeof(SelfPlayParams));
+    params->output_path = "selfplay.bin";
+    params->threads = 1;
+    params->depth = 64;
+    params->nodes_per_move = 5000;
+    params->tt_mb = 16;
+    params->random_plies = 8;
+    params->seed = 1;
+    params->resign_score = 1000;
+    params->resign_plies = 6;
+    params->draw_score = 10;
+    params->draw_plies = 12;
+    params->draw_min_ply = 80;
+    params->max_plies = 400;
+    params->quiet_only = true;
+    params->report_ms = 10000;
+}
+
+void stop_selfplay(void) {
+    atomic_store(&stop_requested, true);
+}
+
+
+// Game Playing
+
+static uint64_t next_random(uint64_t* state) {
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static bool is_quiet_sample(const Board* board, Move move) {
+    return !is_in_check(board, board->side_to_move) &&
+           !is_capture(move) && !is_promotion(move) &&
+           color_on(board, move_to(move)) == NO_COLOR;
+}
+
+// Plays one game, collecting the searched positions. ONGOING means the game was abandoned.
+static GameResult play_game(SelfPlayWorker* worker, Board* board, SearchInfo* info, SearchParams* search_params,
+                            PackedPosition* records, int* record_count, bool* adjudicated) {
+    const SelfPlayParams* params = worker->job->params;
+    MoveList list;
+    
+    clear_tt(search_params->tt);
+    *record_count = 0;
+    *adjudicated = false;
+    
+    // Random opening; one that ends the game is drawn again
+    set_fen(board, START_FEN);
+    for (int ply = 0; ply < params->random_plies; ply++) {
+        generate_moves(board, &list);
+        if (list.count == 0) {
+            set_fen(board, START_FEN);
+            ply = -1;
+            continue;
+        }
+        make_move(board, list.moves[next_random(&worker->rng) % list.count]);
+    }
+    
+    int win_streak = 0, draw_streak = 0;
+    Color leader = NO_COLOR;
+    
+    for (int ply = params->random_plies; ; ply++) {
+        if (atomic_load(&stop_requested)) {
+            return ONGOING;
+        }
+        
+        Color us = board->side_to_move;
+        if (!has_legal_move(board)) {
+            if (!is_in_check(board, us)) return DRAW;
+            return (us == WHITE) ? BLACK_WINS : WHITE_WINS;
+        }
+        if (is_draw(board) || ply >= params->max_plies) {
+            return DRAW;
+        }
+        
+        // Leave the search room on the board's undo and history stacks
+        if (board->history_index > MAX_PLY / 2) {
+            compact_history(board);
+        }
+        
+        Move move = iterative_deepening(board, params->depth, info, search_params);
+        atomic_fetch_add(&worker->job->nodes,
+                         (uint64_t)info->nodes_searched + (uint64_t)info->qnodes_searched);
+        
+        // Positions without a completed iteration have no score and are not recorded
+        if (info->pv_line_count > 0) {
+            int score = info->pv_lines[0].score;
+            
+            if (!params->quiet_only || is_quiet_sample(board, move)) {
+                PackedPosition* record = &records[(*record_count)++];
+                pack_position(board, record);
+                record->score = (int16_t)(score > 32000 ? 32000 : (score < -32000 ? -32000 : score));
+            }
+            
+            // Adjudication on White's point of view
+            int white_score = (us == WHITE) ? score : -score;
+            if (abs(white_score) >= params->resign_score) {
+                Color winner = (white_score > 0) ? WHITE : BLACK;
+                win_streak = (winner == leader) ? win_streak + 1 : 1;
+                leader = winner;
+            } else {
+                win_streak = 0;
+                leader = NO_COLOR;
+            }
+            draw_streak = (abs(score) <= params->draw_score) ? draw_streak + 1 : 0;
+            
+            if (params->resign_plies > 0 && win_streak >= params->resign_plies) {
+                *adjudicated = true;
+                return (leader == WHITE) ? WHITE_WINS : BLACK_WINS;
+            }
+            if (params->draw_plies > 0 && draw_streak >= params->draw_plies && ply >= params->draw_min_ply) {
+                *adjudicated = true;
+                return DRAW;
+            }
+        }
+        
+        make_move(board, move);
+    }
+}
+
+static void record_game(SelfPlayJob* job, PackedPosition* records, int count, GameResult result, bool adjudicated) {
+    for (int i = 0; i < count; i++) {
+        records[i].result = (uint8_t)result;
+    }
+    
+    pthread_mutex_lock(&job->write_lock);
+    if (!packed_write_positions(&job->writer, records, count)) {
+        job->write_error = true;
+        atomic_store(&stop_requested, true);
+    }
+    pthread_mutex_unlock(&job->write_lock);
+    
+    atomic_fetch_add(&job->games, 1);
+    atomic_fetch_add(&job->positions, count);
+    atomic_fetch_add(&job->adjudicated, adjudicated);
+    if (result == WHITE_WINS) atomic_fetch_add(&job->white_wins, 1);
+    else if (result == BLACK_WINS) atomic_fetch_add(&job->black_wins, 1);
+    else atomic_fetch_add(&job->draws, 1);
+}
+
+static void* selfplay_worker(void* arg) {
+    SelfPlayWorker* worker = (SelfPlayWorker*)arg;
+    SelfPlayJob* job = worker->job;
+    const SelfPlayParams* params = job->params;
+    
+    // Every worker owns its board, search state, table and (thread-local) heuristics
+    Board* board = malloc(sizeof(Board));
+    SearchInfo* info = malloc(sizeof(SearchInfo));
+    PackedPosition* records = malloc((params->max_plies + 1) * sizeof(PackedPosition));
+    TranspositionTable tt;
+    bool ready = init_tt(&tt, params->tt_mb);
+    if (!ready) {
+        atomic_store(&job->table_error, true);
+        atomic_store(&stop_requested, true);
+    }
+    
+    SearchParams search_params = {
+        .max_depth = params->depth,
+        .use_quiescence = true,
+        .max_nodes = params->nodes_per_move,
+        .tt = &tt
+    };
+    
+    while (ready && !atomic_load(&stop_requested)) {
+        if (params->games && atomic_fetch_add(&job->games_started, 1) >= params->games) {
+            break;
+        }
+        
+        int count;
+        bool adjudicated;
+        GameResult result = play_game(worker, board, info, &search_params, records, &count, &adjudicated);
+        if (result != ONGOING) {
+            record_game(job, records, count, result, adjudicated);
+        }
+    }
+    
+    free_tt(&tt);
+    free(records);
+    free(info);
+    free(board);
+    atomic_fetch_sub(&job->active_workers, 1);
+    return NULL;
+}
+
+
+// Generator
+
+static void snapshot(SelfPlayJob* job, SelfPlayStats* stats, uint64_t elapsed) {
+    stats->games = atomic_load(&job->games);
+    stats->positions = atomic_load(&job->positions);
+    stats->white_wins = atomic_load(&job->white_wins);
+    stats->black_wins = atomic_load(&job->black_wins);
+    stats->draws = atomic_load(&job->draws);
+    stats->adjudicated = atomic_load(&job->adjudicated);
+    stats->nodes = atomic_load(&job->nodes);
+    stats->elapsed_ms = elapsed;
+}
+
+bool run_selfplay(const SelfPlayParams* params, SelfPlayStats* stats,
+                  SelfPlayProgressFunc progress, void* user_data) {
+    SelfPlayJob job = { .params = params };
+    if (params->max_plies < 1 || !packed_writer_open(&job.writer, params->output_path, PACKED_POSITIONS)) {
+        return false;
+    }
+    pthread_mutex_init(&job.write_lock, NULL);
+    atomic_init(&job.games_started, 0);
+    atomic_init(&job.games, 0);
+    atomic_init(&job.positions, 0);
+    atomic_init(&job.white_wins, 0);
+    atomic_init(&job.black_wins, 0);
+    atomic_init(&job.draws, 0);
+    atomic_init(&job.adjudicated, 0);
+    atomic_init(&job.nodes, 0);
+    atomic_init(&job.table_error, false);
+    atomic_store(&stop_requested, false);
+    
+    int threads = params->threads;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SELFPLAY_THREADS) threads = MAX_SELFPLAY_THREADS;
+    
+    // All workers play; the calling thread only reports and enforces the time limit
+    SelfPlayWorker* workers = malloc(threads * sizeof(SelfPlayWorker));
+    pthread_t* handles = malloc(threads * sizeof(pthread_t));
+    int spawned = 0;
+    atomic_init(&job.active_workers, threads);
+    
+    uint64_t start = get_time_ms();
+    for (int i = 0; i < threads; i++) {
+        workers[i].job = &job;
+        workers[i].rng = (params->seed + i + 1) * 0x9E3779B97F4A7C15ULL;
+        if (pthread_create(&handles[spawned], NULL, selfplay_worker, &workers[i]) == 0) {
+            spawned++;
+        } else {
+            atomic_fetch_sub(&job.active_workers, 1);
+        }
+    }
+    
+    uint64_t last_report = start;
+    struct timespec pause = { 0, 50 * 1000000L };
+    while (atomic_load(&job.active_workers) > 0) {
+        nanosleep(&pause, NULL);
+        uint64_t now = get_time_ms();
+        
+        if (params->time_limit_ms && now - start >= params->time_limit_ms) {
+            atomic_store(&stop_requested, true);
+        }
+        if (progress && params->report_ms && now - last_report >= params->report_ms) {
+            snapshot(&job, stats, now - start);
+            progress(stats, user_data);
+            last_report = now;
+        }
+    }
+    
+    for (int i = 0; i < spawned; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    
+    free(handles);
+    free(workers);
+    
+    snapshot(&job, stats, get_time_ms() - start);
+    bool ok = packed_writer_close(&job.writer) && !job.write_error && !atomic_load(&job.table_error);
+    pthread_mutex_destroy(&job.write_lock);
+    return ok;
+}
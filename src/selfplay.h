@@ -0,0 +1,57 @@
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+#include "types.h"
+#include <stddef.h>
+
+// Self-play data generation parameters
+typedef struct {
+    const char* output_path;    // Packed position file (see packed.h)
+    int threads;                // Worker count, each plays its own games
+    uint64_t games;             // Stop after this many games (0 = until time limit or stop)
+    uint64_t time_limit_ms;     // Stop after this long (0 = no limit)
+    int depth;                  // Maximum search depth per move
+    uint64_t nodes_per_move;    // Node limit per move
+    size_t tt_mb;               // Transposition table per worker
+    int random_plies;           // Uniformly random opening moves before searching
+    uint64_t seed;
+
+    // Adjudication
+    int resign_score;           // Win once |score| >= this ...
+    int resign_plies;           // ... for this many consecutive plies with the same winner
+    int draw_score;             // Draw once |score| <= this ...
+    int draw_plies;             // ... for this many consecutive plies ...
+    int draw_min_ply;           // ... but not before this ply
+    int max_plies;              // Draw by length
+
+    bool quiet_only;            // Skip positions in check or whose best move captures or promotes
+    uint64_t report_ms;         // Progress callback interval (0 = none)
+} SelfPlayParams;
+
+// Running totals
+typedef struct {
+    uint64_t games;
+    uint64_t positions;         // Records written
+    uint64_t white_wins;
+    uint64_t black_wins;
+    uint64_t draws;
+    uint64_t adjudicated;
+    uint64_t nodes;
+    uint64_t elapsed_ms;
+} SelfPlayStats;
+
+// Called from the calling thread every report_ms
+typedef void (*SelfPlayProgressFunc)(const SelfPlayStats* stats, void* user_data);
+
+// Defaults suitable for evaluation training data
+void init_selfplay_params(SelfPlayParams* params);
+
+// Play games on a worker pool and write (position, score, result) records to the output.
+// Returns false if the output cannot be written or a worker cannot allocate its table.
+bool run_selfplay(const SelfPlayParams* params, SelfPlayStats* stats,
+                  SelfPlayProgressFunc progress, void* user_data);
+
+// Ask a running generator to stop; unfinished games are dropped (async-signal-safe)
+void stop_selfplay(void);
+
+#endif // SELFPLAY_H
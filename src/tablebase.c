@@ -0,0 +1,1315 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tablebase.h"
+#include "bitboard.h"
+#include "moves.h"
+#include "movegen.h"
+#include "util.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_TB_THREADS MAX_WORKERS
+
+// Positions handed to a generation thread at a time
+#define TB_CHUNK 4096
+
+#define TB_FILE_MAGIC "ZZTB"
+#define TB_FILE_VERSION 2
+
+// Entry byte: 0 draw, 1..127 win in that many plies, 128 + n loss in n plies
+#define TB_ENTRY_ILLEGAL 255
+#define TB_MAX_DTZ 126
+
+
+// Tables
+
+typedef struct {
+    char name[TB_SIGNATURE_LENGTH];
+    int counts[2][5];               // Pieces besides the king, [color][pawn..queen]
+    uint64_t key;                   // Material key with the first side as White
+    uint64_t flipped_key;           // Material key with the first side as Black
+    int piece_count;                // Including both kings
+    Color colors[TB_MAX_PIECES];    // Index order: white king, pawns, black king, then the pieces
+    PieceType types[TB_MAX_PIECES];
+    int radix[TB_MAX_PIECES];       // Squares each piece after the white king can take (see Indexing)
+    bool pawns;
+    uint64_t entries;
+    const uint8_t* data;
+    void* map;                      // Mapped file, or NULL for a table generated in memory
+    size_t map_length;
+} Tablebase;
+
+// File header, followed by one entry byte per index
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    char name[TB_SIGNATURE_LENGTH];
+    uint64_t entries;
+} TbFileHeader;
+
+static Tablebase tables[TB_MAX_TABLES];
+static int table_count = 0;
+int tb_max_pieces = 0;
+
+static const char piece_letters[5] = { 'P', 'N', 'B', 'R', 'Q' };
+static const int signature_values[5] = { 100, 320, 330, 500, 900 };
+
+static Tablebase* find_table(uint64_t key) {
+    for (int i = 0; i < table_count; i++) {
+        if (tables[i].key == key || tables[i].flipped_key == key) {
+            return &tables[i];
+        }
+    }
+    return NULL;
+}
+
+static Tablebase* register_table(const Tablebase* table) {
+    if (table_count >= TB_MAX_TABLES) {
+        return NULL;
+    }
+    tables[table_count] = *table;
+    if (table->piece_count > tb_max_pieces) {
+        tb_max_pieces = table->piece_count;
+    }
+    return &tables[table_count++];
+}
+
+int tablebase_count(void) {
+    return table_count;
+}
+
+const char* tablebase_name(int table) {
+    return tables[table].name;
+}
+
+
+// Signatures
+
+static void format_side(const int counts[5], char* out) {
+    *out++ = 'K';
+    for (int piece = QUEEN; piece >= PAWN; piece--) {
+        for (int i = 0; i < counts[piece]; i++) {
+            *out++ = piece_letters[piece];
+        }
+    }
+    *out = '\0';
+}
+
+// Stronger side (by piece values, then by name) first
+static void canonical_counts(const int in[2][5], int out[2][5]) {
+    int value[2] = { 0, 0 };
+    char names[2][TB_SIGNATURE_LENGTH];
+    for (int side = 0; side < 2; side++) {
+        for (int piece = PAWN; piece <= QUEEN; piece++) {
+            value[side] += in[side][piece] * signature_values[piece];
+        }
+        format_side(in[side], names[side]);
+    }
+    
+    bool swap = value[1] > value[0] || (value[1] == value[0] && strcmp(names[1], names[0]) > 0);
+    memcpy(out[0], in[swap ? 1 : 0], sizeof(out[0]));
+    memcpy(out[1], in[swap ? 0 : 1], sizeof(out[1]));
+}
+
+static void format_signature(const int counts[2][5], char* out) {
+    format_side(counts[0], out);
+    strcat(out, "v");
+    format_side(counts[1], out + strlen(out));
+}
+
+static bool parse_signature(const char* signature, int counts[2][5]) {
+    memset(counts, 0, sizeof(int) * 10);
+    int side = 0, pieces = 0;
+    const char* p = signature;
+    
+    for (side = 0; side < 2; side++) {
+        if (*p++ != 'K') return false;
+        pieces++;
+        while (*p && *p != 'v') {
+            const char* letter = memchr(piece_letters, *p, sizeof(piece_letters));
+            if (!letter) return false;
+            counts[side][letter - piece_letters]++;
+            pieces++;
+            p++;
+        }
+        if (side == 0 && *p++ != 'v') return false;
+    }
+    
+    return *p == '\0' && pieces >= 3 && pieces <= TB_MAX_PIECES;
+}
+
+bool canonical_signature(const char* signature, char* out) {
+    int counts[2][5], canonical[2][5];
+    if (!parse_signature(signature, counts)) {
+        return false;
+    }
+    canonical_counts(counts, canonical);
+    format_signature(canonical, out);
+    return true;
+}
+
+// A lone minor piece (or nothing) cannot mate: no table needed
+static bool insufficient_counts(const int counts[2][5]) {
+    int total = 0;
+    for (int side = 0; side < 2; side++) {
+        for (int piece = PAWN; piece <= QUEEN; piece++) {
+            total += counts[side][piece];
+        }
+    }
+    return total == 0 ||
+           (total == 1 && (counts[0][KNIGHT] + counts[0][BISHOP] + counts[1][KNIGHT] + counts[1][BISHOP]) == 1);
+}
+
+// Table description for canonical counts (no data yet)
+static void init_table(Tablebase* table, const int counts[2][5]) {
+    memset(table, 0, sizeof(*table));
+    memcpy(table->counts, counts, sizeof(table->counts));
+    format_signature(counts, table->name);
+    
+    // The pawns come right after the white king, coded on ranks 2-7 among themselves only
+    table->piece_count = 1;
+    table->colors[0] = WHITE;
+    table->types[0] = KING;
+    for (int side = 0; side < 2; side++) {
+        for (int i = 0; i < counts[side][PAWN]; i++) {
+            table->colors[table->piece_count] = (Color)side;
+            table->types[table->piece_count] = PAWN;
+            table->piece_count++;
+        }
+    }
+    table->colors[table->piece_count] = BLACK;
+    table->types[table->piece_count] = KING;
+    table->piece_count++;
+    for (int side = 0; side < 2; side++) {
+        for (int piece = QUEEN; piece >= KNIGHT; piece--) {
+            for (int i = 0; i < counts[side][piece]; i++) {
+                table->colors[table->piece_count] = (Color)side;
+                table->types[table->piece_count] = (PieceType)piece;
+                table->piece_count++;
+            }
+        }
+        for (int piece = PAWN; piece <= QUEEN; piece++) {
+            table->key += counts[side][piece] * MATERIAL_KEY_UNIT(side, piece);
+            table->flipped_key += counts[side][piece] * MATERIAL_KEY_UNIT(1 - side, piece);
+        }
+    }
+    int pawns = counts[0][PAWN] + counts[1][PAWN];
+    table->pawns = pawns > 0;
+    
+    // Side to move x white king slots x the squares left for every other piece
+    table->entries = 2 * (table->pawns ? 32 : 10);
+    for (int i = 1; i < table->piece_count; i++) {
+        table->radix[i] = (i <= pawns) ? 48 - (i - 1) : 64 - i;
+        table->entries *= (uint64_t)table->radix[i];
+    }
+}
+
+typedef struct {
+    char name[TB_SIGNATURE_LENGTH];
+    int pieces;
+    int pawns;
+} SignatureOrder;
+
+static int compare_signatures(const void* a, const void* b) {
+    const SignatureOrder* x = (const SignatureOrder*)a;
+    const SignatureOrder* y = (const SignatureOrder*)b;
+    if (x->pieces != y->pieces) return x->pieces - y->pieces;
+    if (x->pawns != y->pawns) return x->pawns - y->pawns;
+    return strcmp(x->name, y->name);
+}
+
+// Every multiset of count pieces from pawn..queen, starting at piece type `from`
+static void enumerate_side(int counts[5], int count, int from, void (*visit)(const int[5], void*), void* arg) {
+    if (count == 0) {
+        visit(counts, arg);
+        return;
+    }
+    for (int piece = from; piece <= QUEEN; piece++) {
+        counts[piece]++;
+        enumerate_side(counts, count - 1, piece, visit, arg);
+        counts[piece]--;
+    }
+}
+
+typedef struct {
+    int weak_count;
+    int strong[5];
+    SignatureOrder* out;
+    int count;
+    int max_count;
+} SignatureEnum;
+
+static void visit_weak(const int weak[5], void* arg) {
+    SignatureEnum* e = (SignatureEnum*)arg;
+    int counts[2][5], canonical[2][5];
+    memcpy(counts[0], e->strong, sizeof(counts[0]));
+    memcpy(counts[1], weak, sizeof(counts[1]));
+    if (insufficient_counts(counts)) return;
+    
+    canonical_counts(counts, canonical);
+    char name[TB_SIGNATURE_LENGTH];
+    format_signature(canonical, name);
+    for (int i = 0; i < e->count; i++) {
+        if (strcmp(e->out[i].name, name) == 0) return;
+    }
+    if (e->count >= e->max_count) return;
+    
+    SignatureOrder* entry = &e->out[e->count++];
+    strcpy(entry->name, name);
+    entry->pieces = 2;
+    entry->pawns = canonical[0][PAWN] + canonical[1][PAWN];
+    for (int side = 0; side < 2; side++) {
+        for (int piece = PAWN; piece <= QUEEN; piece++) {
+            entry->pieces += canonical[side][piece];
+        }
+    }
+}
+
+static void visit_strong(const int strong[5], void* arg) {
+    SignatureEnum* e = (SignatureEnum*)arg;
+    int weak[5] = { 0 };
+    memcpy(e->strong, strong, sizeof(e->strong));
+    enumerate_side(weak, e->weak_count, PAWN, visit_weak, e);
+}
+
+int tablebase_signatures(int max_pieces, char signatures[][TB_SIGNATURE_LENGTH], int max_count) {
+    if (max_pieces > TB_MAX_PIECES) max_pieces = TB_MAX_PIECES;
+    
+    SignatureEnum e = { .out = malloc(TB_MAX_TABLES * sizeof(SignatureOrder)), .max_count = TB_MAX_TABLES };
+    if (!e.out) return 0;
+    
+    for (int pieces = 3; pieces <= max_pieces; pieces++) {
+        for (int strong = 1; strong <= pieces - 2; strong++) {
+            int counts[5] = { 0 };
+            e.weak_count = pieces - 2 - strong;
+            enumerate_side(counts, strong, PAWN, visit_strong, &e);
+        }
+    }
+    
+    // Promotions and captures only lead to fewer pieces or fewer pawns
+    qsort(e.out, e.count, sizeof(SignatureOrder), compare_signatures);
+    int count = (e.count < max_count) ? e.count : max_count;
+    for (int i = 0; i < count; i++) {
+        strcpy(signatures[i], e.out[i].name);
+    }
+    free(e.out);
+    return count;
+}
+
+
+// Indexing
+// index = ((stm * king slots + white king slot) * radix[1] + code[1]) * radix[2] + code[2]...
+// Without pawns the white king is brought into a1-d1-d4 by the 8 board symmetries,
+// with pawns onto files a-d by the left-right mirror. Every other piece is coded among the
+// squares the earlier pieces leave free: pawns among the 48 squares of ranks 2-7 less the
+// earlier pawns, the black king and the pieces among the 64 less every earlier piece.
+
+static const Square triangle[10] = { A1, B1, C1, D1, B2, C2, D2, C3, D3, D4 };
+
+static int triangle_slot(Square sq) {
+    for (int i = 0; i < 10; i++) {
+        if (triangle[i] == sq) return i;
+    }
+    return -1;
+}
+
+static Square transpose(Square sq) {
+    return (Square)((sq >> 3) | ((sq & 7) << 3));
+}
+
+static void canonical_squares(const Tablebase* table, Square* sq) {
+    int n = table->piece_count;
+    if (square_file(sq[0]) > 3) {
+        for (int i = 0; i < n; i++) sq[i] ^= 7;
+    }
+    if (!table->pawns) {
+        if (square_rank(sq[0]) > 3) {
+            for (int i = 0; i < n; i++) sq[i] ^= 56;
+        }
+        if (square_rank(sq[0]) > square_file(sq[0])) {
+            for (int i = 0; i < n; i++) sq[i] = transpose(sq[i]);
+        }
+    }
+}
+
+// First earlier piece a piece skips: pawns skip only the pawns, which come right after the king
+static int first_skipped(const Tablebase* table, int i) {
+    return table->types[i] == PAWN ? 1 : 0;
+}
+
+static uint64_t encode_index(const Tablebase* table, Color stm, const Square* sq) {
+    int slots = table->pawns ? 32 : 10;
+    int king = table->pawns ? square_rank(sq[0]) * 4 + square_file(sq[0]) : triangle_slot(sq[0]);
+    uint64_t index = (uint64_t)stm * slots + king;
+    for (int i = 1; i < table->piece_count; i++) {
+        int code = (table->types[i] == PAWN) ? sq[i] - 8 : sq[i];
+        for (int j = first_skipped(table, i); j < i; j++) {
+            code -= sq[j] < sq[i];
+        }
+        index = index * table->radix[i] + code;
+    }
+    return index;
+}
+
+static Color decode_index(const Tablebase* table, uint64_t index, Square* sq) {
+    int codes[TB_MAX_PIECES];
+    for (int i = table->piece_count - 1; i >= 1; i--) {
+        codes[i] = (int)(index % table->radix[i]);
+        index /= table->radix[i];
+    }
+    int slots = table->pawns ? 32 : 10;
+    int king = (int)(index % slots);
+    sq[0] = table->pawns ? make_square(king / 4, king % 4) : triangle[king];
+    
+    // A code counts the free squares below the piece: step over the skipped squares in order
+    for (int i = 1; i < table->piece_count; i++) {
+        Square skipped[TB_MAX_PIECES];
+        int count = 0;
+        for (int j = first_skipped(table, i); j < i; j++) {
+            int at = count++;
+            while (at > 0 && skipped[at - 1] > sq[j]) {
+                skipped[at] = skipped[at - 1];
+                at--;
+            }
+            skipped[at] = sq[j];
+        }
+        int square = (table->types[i] == PAWN) ? codes[i] + 8 : codes[i];
+        for (int j = 0; j < count && (int)skipped[j] <= square; j++) {
+            square++;
+        }
+        sq[i] = (Square)square;
+    }
+    return (Color)(index / slots);
+}
+
+// Identical pieces (adjacent in the table order) in square order
+static void sort_identical(const Tablebase* table, Square* sq) {
+    for (int i = 2; i < table->piece_count; i++) {
+        for (int j = i; j > 1 && table->types[j - 1] == table->types[j] &&
+                        table->colors[j - 1] == table->colors[j] && sq[j - 1] > sq[j]; j--) {
+            Square swap = sq[j];
+            sq[j] = sq[j - 1];
+            sq[j - 1] = swap;
+        }
+    }
+}
+
+// Index of a board with the table's material, in either color orientation. A position has one
+// index: identical pieces go in square order and, without pawns, a white king on the a1-h8
+// diagonal takes the smaller index of the position and its reflection. The other indices of
+// the position hold copies of its entry.
+static uint64_t board_index(const Tablebase* table, const Board* board) {
+    bool flipped = board->material_key != table->key;
+    Color white = flipped ? BLACK : WHITE;
+    Color black = flipped ? WHITE : BLACK;
+    
+    Bitboard remaining[2][6];
+    memcpy(remaining, board->pieces, sizeof(remaining));
+    
+    Square sq[TB_MAX_PIECES];
+    sq[0] = get_king_square(board, white);
+    for (int i = 1; i < table->piece_count; i++) {
+        Color color = (table->colors[i] == WHITE) ? white : black;
+        sq[i] = pop_lsb(&remaining[color][table->types[i]]);
+    }
+    
+    Color stm = board->side_to_move;
+    if (flipped) {
+        for (int i = 0; i < table->piece_count; i++) sq[i] ^= 56;
+        stm = (stm == WHITE) ? BLACK : WHITE;
+    }
+    
+    canonical_squares(table, sq);
+    sort_identical(table, sq);
+    uint64_t index = encode_index(table, stm, sq);
+    if (!table->pawns && square_rank(sq[0]) == square_file(sq[0])) {
+        for (int i = 0; i < table->piece_count; i++) sq[i] = transpose(sq[i]);
+        sort_identical(table, sq);
+        uint64_t reflected = encode_index(table, stm, sq);
+        if (reflected < index) index = reflected;
+    }
+    return index;
+}
+
+// Board for an index; false if the placement is impossible or the side not to move is in check
+static bool setup_board(const Tablebase* table, uint64_t index, Board* board) {
+    Square sq[TB_MAX_PIECES];
+    Color stm = decode_index(table, index, sq);
+    
+    memset(board->pieces, 0, sizeof(board->pieces));
+    board->occupied[WHITE] = board->occupied[BLACK] = 0ULL;
+    Bitboard occupied = 0ULL;
+    
+    for (int i = 0; i < table->piece_count; i++) {
+        Bitboard bb = square_bb(sq[i]);
+        if (occupied & bb) return false;
+        occupied |= bb;
+        board->pieces[table->colors[i]][table->types[i]] |= bb;
+        board->occupied[table->colors[i]] |= bb;
+    }
+    
+    // The hash is not needed: positions are looked up by index
+    board->all_occupied = occupied;
+    board->side_to_move = stm;
+    board->castling_rights = 0;
+    board->en_passant_square = NO_SQUARE;
+    board->halfmove_clock = 0;
+    board->fullmove_number = 1;
+    board->hash = 0ULL;
+    board->material_key = table->key;
+    board->undo_index = 0;
+    board->history_index = 0;
+    board->position_history[board->history_index++] = 0ULL;
+    
+    return !is_in_check(board, (stm == WHITE) ? BLACK : WHITE);
+}
+
+
+// Entries
+
+static uint8_t encode_entry(int wdl, int dtz) {
+    if (dtz > TB_MAX_DTZ) dtz = TB_MAX_DTZ;
+    if (wdl > 0) return (uint8_t)(dtz < 1 ? 1 : dtz);
+    if (wdl < 0) return (uint8_t)(128 + dtz);
+    return 0;
+}
+
+static void decode_entry(uint8_t entry, TbResult* result) {
+    if (entry == 0) {
+        result->wdl = 0;
+        result->dtz = 0;
+    } else if (entry < 128) {
+        result->wdl = 1;
+        result->dtz = entry;
+    } else {
+        result->wdl = -1;
+        result->dtz = entry - 128;
+    }
+}
+
+bool probe_tablebase(const Board* board, TbResult* result) {
+    if (board->castling_rights || board->en_passant_square != NO_SQUARE) {
+        return false;
+    }
+    
+    const Tablebase* table = find_table(board->material_key);
+    if (!table) {
+        return false;
+    }
+    
+    uint8_t entry = table->data[board_index(table, board)];
+    if (entry == TB_ENTRY_ILLEGAL) {
+        return false;
+    }
+    decode_entry(entry, result);
+    return true;
+}
+
+int tablebase_score(const TbResult* result) {
+    if (result->wdl > 0) return TB_WIN_SCORE - result->dtz;
+    if (result->wdl < 0) return -TB_WIN_SCORE + result->dtz;
+    return DRAW_SCORE;
+}
+
+
+// Retrograde Analysis
+// One forward pass finds mates, stalemates and positions decided by a capture or promotion, and
+// counts every other position's successors. Decided positions are then taken back one move at a
+// time: a loss makes its predecessors wins, and a win counts down each predecessor's successors,
+// making it a loss at zero. Positions never decided are draws. DTZ works back the same way from
+// the positions one zeroing move from a decided table, one ply per pass.
+
+enum {
+    WORK_ILLEGAL,
+    WORK_UNKNOWN,
+    WORK_DRAW,
+    WORK_WIN,
+    WORK_LOSS,
+    WORK_ALIAS      // Another index of a position (see board_index)
+};
+
+// Work state byte: the value, then flags
+#define WORK_VALUE 0x07
+#define WORK_PENDING 0x08   // Decided, predecessors not yet visited
+#define WORK_ZEROING 0x10   // A win with a zeroing move into a lost position
+
+#define DTZ_UNKNOWN 0xFFFF
+
+enum {
+    PHASE_INIT,
+    PHASE_WDL,
+    PHASE_DTZ_INIT,
+    PHASE_DTZ,
+    PHASE_ENTRIES
+};
+
+typedef struct {
+    const Tablebase* table;
+    _Atomic uint8_t* state;
+    _Atomic uint8_t* count;     // Successors not yet known to be won (for a loss: to have a DTZ)
+    _Atomic uint16_t* dtz;
+    uint8_t* data;              // Entry bytes, filled in PHASE_ENTRIES
+    atomic_ullong next_chunk;
+    atomic_bool changed;
+    atomic_bool failed;         // A capture or promotion reached a position no table covers
+    int phase;
+    int level;                  // DTZ whose positions PHASE_DTZ takes back
+} TbJob;
+
+typedef struct {
+    uint64_t index;
+    bool pawn;      // A pawn move, which zeroes the DTZ
+    bool drawn;     // A double push whose en passant captures would draw a loss
+} Predecessor;
+
+// Makes a pseudo-legal move; one that leaves the mover in check is taken back
+static bool make_legal_move(Board* board, Move move) {
+    Color us = board->side_to_move;
+    make_move(board, move);
+    if (is_in_check(board, us)) {
+        unmake_move(board, move);
+        return false;
+    }
+    return true;
+}
+
+// Position after a capture or promotion: another, finished table (or a dead draw). Without
+// that table the generation fails rather than score the position.
+static int converted_value(TbJob* job, const Board* board) {
+    TbResult result;
+    if (board->material_key == 0 || is_insufficient_material(board)) {
+        return WORK_DRAW;
+    }
+    if (!probe_tablebase(board, &result)) {
+        atomic_store_explicit(&job->failed, true, memory_order_relaxed);
+        return WORK_DRAW;
+    }
+    return result.wdl > 0 ? WORK_WIN : (result.wdl < 0 ? WORK_LOSS : WORK_DRAW);
+}
+
+enum {
+    EP_NONE,
+    EP_DRAWN,
+    EP_DECIDED
+};
+
+// Stored entries leave en passant out. After a double pawn push the captures may decide the
+// position whatever its entry (then *value), hold a lost entry to a draw, or change nothing.
+static int en_passant_effect(TbJob* job, Board* board, int* value) {
+    Color us = board->side_to_move;
+    if (!(pawn_attacks(board->en_passant_square, (us == WHITE) ? BLACK : WHITE) & board->pieces[us][PAWN])) {
+        return EP_NONE;
+    }
+    
+    MoveList list;
+    generate_moves(board, &list);
+    bool captures = false, draw = false, other_moves = false;
+    
+    for (int i = 0; i < list.count; i++) {
+        Move move = list.moves[i];
+        if (move_flags(move) != EN_PASSANT) {
+            if (!other_moves && make_legal_move(board, move)) {
+                unmake_move(board, move);
+                other_moves = true;
+            }
+            continue;
+        }
+        if (!make_legal_move(board, move)) continue;
+        int reply = converted_value(job, board);
+        unmake_move(board, move);
+        
+        if (reply == WORK_LOSS) {
+            *value = WORK_WIN;
+            return EP_DECIDED;
+        }
+        captures = true;
+        draw = draw || reply == WORK_DRAW;
+    }
+    
+    if (!captures) return EP_NONE;
+    
+    // Mated or stalemated but for the capture: it is the only move
+    if (!other_moves) {
+        *value = draw ? WORK_DRAW : WORK_LOSS;
+        return EP_DECIDED;
+    }
+    return draw ? EP_DRAWN : EP_NONE;
+}
+
+// Symmetric positions can reach one successor by two moves: it counts once
+static void add_unique(uint64_t* list, int* count, uint64_t index) {
+    for (int i = 0; i < *count; i++) {
+        if (list[i] == index) return;
+    }
+    list[(*count)++] = index;
+}
+
+// Positions one move after this one within the table (so no captures or promotions), each
+// once; without `pawns` only piece moves. A double push whose en passant captures decide the
+// position sets the bit of that value in *decided instead.
+static int successors(TbJob* job, Board* board, bool pawns, uint64_t* out, int* decided) {
+    Color us = board->side_to_move;
+    Color them = (us == WHITE) ? BLACK : WHITE;
+    Bitboard empty = ~board->all_occupied;
+    int count = 0;
+    
+    for (PieceType type = pawns ? PAWN : KNIGHT; type <= KING; type++) {
+        Bitboard pieces = board->pieces[us][type];
+        while (pieces) {
+            Square from = pop_lsb(&pieces);
+            Bitboard targets;
+            Square double_target = NO_SQUARE;
+            
+            switch (type) {
+                case PAWN: {
+                    // Pushes only, short of promotion
+                    int forward = (us == WHITE) ? 8 : -8;
+                    int rank = square_rank(from);
+                    targets = 0ULL;
+                    if (rank != ((us == WHITE) ? 6 : 1) && (empty & square_bb(from + forward))) {
+                        targets = square_bb(from + forward);
+                        if (rank == ((us == WHITE) ? 1 : 6) && (empty & square_bb(from + 2 * forward))) {
+                            double_target = from + 2 * forward;
+                            targets |= square_bb(double_target);
+                        }
+                    }
+                    break;
+                }
+                case KNIGHT: targets = knight_attacks(from) & empty; break;
+                case BISHOP: targets = bishop_attacks(from, board->all_occupied) & empty; break;
+                case ROOK: targets = rook_attacks(from, board->all_occupied) & empty; break;
+                case QUEEN: targets = queen_attacks(from, board->all_occupied) & empty; break;
+                default: targets = king_attacks(from) & empty; break;
+            }
+            
+            while (targets) {
+                Square to = pop_lsb(&targets);
+                Bitboard move = square_bb(from) | square_bb(to);
+                board->pieces[us][type] ^= move;
+                board->occupied[us] ^= move;
+                board->all_occupied ^= move;
+                
+                if (!is_in_check(board, us)) {
+                    board->side_to_move = them;
+                    int effect = EP_NONE, value;
+                    if (to == double_target) {
+                        board->en_passant_square = (from + to) / 2;
+                        effect = en_passant_effect(job, board, &value);
+                        board->en_passant_square = NO_SQUARE;
+                    }
+                    if (effect == EP_DECIDED) {
+                        *decided |= 1 << value;
+                    } else {
+                        add_unique(out, &count, board_index(job->table, board));
+                    }
+                    board->side_to_move = us;
+                }
+                
+                board->pieces[us][type] ^= move;
+                board->occupied[us] ^= move;
+                board->all_occupied ^= move;
+            }
+        }
+    }
+    return count;
+}
+
+// Captures and promotions: whether there is one, setting the bits of the values they reach
+// (for the opponent) in *decided
+static bool conversions(TbJob* job, Board* board, int* decided) {
+    MoveList list;
+    generate_captures(board, &list);
+    
+    Color us = board->side_to_move;
+    int forward = (us == WHITE) ? 8 : -8;
+    Bitboard pawns = board->pieces[us][PAWN] & rank_mask((us == WHITE) ? 6 : 1);
+    while (pawns) {
+        Square from = pop_lsb(&pawns);
+        if (board->all_occupied & square_bb(from + forward)) continue;
+        for (int flags = PROMOTION_KNIGHT; flags <= PROMOTION_QUEEN; flags++) {
+            add_move(&list, encode_move(from, from + forward, (MoveFlags)flags));
+        }
+    }
+    
+    bool any_move = false;
+    for (int i = 0; i < list.count; i++) {
+        if (!make_legal_move(board, list.moves[i])) continue;
+        any_move = true;
+        *decided |= 1 << converted_value(job, board);
+        unmake_move(board, list.moves[i]);
+    }
+    return any_move;
+}
+
+// Flags and successor count of a position, from one look at its moves. A drawing capture or
+// promotion counts as a successor that never wins.
+static void init_position(TbJob* job, uint64_t index, Board* board) {
+    uint8_t state = WORK_UNKNOWN;
+    if (!setup_board(job->table, index, board)) {
+        state = WORK_ILLEGAL;
+    } else if (board_index(job->table, board) != index) {
+        state = WORK_ALIAS;
+    }
+    atomic_store_explicit(&job->dtz[index], DTZ_UNKNOWN, memory_order_relaxed);
+    if (state != WORK_UNKNOWN) {
+        atomic_store_explicit(&job->state[index], state, memory_order_relaxed);
+        return;
+    }
+    
+    int decided = 0;
+    bool any_move = conversions(job, board, &decided);
+    uint64_t list[MAX_MOVES];
+    int count = successors(job, board, true, list, &decided);
+    int draw = (decided >> WORK_DRAW) & 1;
+    
+    if (decided & (1 << WORK_LOSS)) {
+        state = WORK_WIN | WORK_PENDING | WORK_ZEROING;
+    } else if (!any_move && count == 0 && !decided) {
+        if (is_in_check(board, board->side_to_move)) {
+            state = WORK_LOSS | WORK_PENDING;
+            atomic_store_explicit(&job->dtz[index], 0, memory_order_relaxed);
+        } else {
+            state = WORK_DRAW;
+        }
+    } else if (count + draw == 0) {
+        state = WORK_LOSS | WORK_PENDING;
+    }
+    atomic_store_explicit(&job->count[index], (uint8_t)(count + draw), memory_order_relaxed);
+    atomic_store_explicit(&job->state[index], state, memory_order_relaxed);
+}
+
+// Positions one move before this one within the table (so no captures or promotions), each
+// once. Without `pawns` only piece moves, which keep the DTZ running. A double push whose
+// en passant captures decide the position is left out: init_position scores it.
+static int predecessors(TbJob* job, Board* board, bool pawns, Predecessor* out) {
+    Color us = board->side_to_move;
+    Color them = (us == WHITE) ? BLACK : WHITE;
+    int count = 0;
+    
+    for (PieceType type = pawns ? PAWN : KNIGHT; type <= KING; type++) {
+        Bitboard pieces = board->pieces[them][type];
+        while (pieces) {
+            Square to = pop_lsb(&pieces);
+            Bitboard empty = ~board->all_occupied;
+            Bitboard origins;
+            Square double_origin = NO_SQUARE;
+            int effect = EP_NONE;
+            
+            switch (type) {
+                case PAWN: {
+                    // Pushes only; a pawn on its start rank has not moved
+                    int back = (them == WHITE) ? -8 : 8;
+                    int rank = square_rank(to);
+                    origins = 0ULL;
+                    if (rank != ((them == WHITE) ? 1 : 6) && (empty & square_bb(to + back))) {
+                        origins = square_bb(to + back);
+                        if (rank == ((them == WHITE) ? 3 : 4) && (empty & square_bb(to + 2 * back))) {
+                            int value;
+                            board->en_passant_square = to + back;
+                            effect = en_passant_effect(job, board, &value);
+                            board->en_passant_square = NO_SQUARE;
+                            if (effect != EP_DECIDED) {
+                                double_origin = to + 2 * back;
+                                origins |= square_bb(double_origin);
+                            }
+                        }
+                    }
+                    break;
+                }
+                case KNIGHT: origins = knight_attacks(to) & empty; break;
+                case BISHOP: origins = bishop_attacks(to, board->all_occupied) & empty; break;
+                case ROOK: origins = rook_attacks(to, board->all_occupied) & empty; break;
+                case QUEEN: origins = queen_attacks(to, board->all_occupied) & empty; break;
+                default: origins = king_attacks(to) & empty; break;
+            }
+            
+            while (origins) {
+                Square from = pop_lsb(&origins);
+                Bitboard move = square_bb(from) | square_bb(to);
+                board->pieces[them][type] ^= move;
+                board->occupied[them] ^= move;
+                board->all_occupied ^= move;
+                board->side_to_move = them;
+                
+                if (!is_in_check(board, us)) {
+                    uint64_t index = board_index(job->table, board);
+                    int i = 0;
+                    while (i < count && out[i].index != index) i++;
+                    if (i == count) {
+                        out[count].index = index;
+                        out[count].pawn = type == PAWN;
+                        out[count].drawn = from == double_origin && effect == EP_DRAWN;
+                        count++;
+                    }
+                }
+                
+                board->pieces[them][type] ^= move;
+                board->occupied[them] ^= move;
+                board->all_occupied ^= move;
+                board->side_to_move = us;
+            }
+        }
+    }
+    return count;
+}
+
+// A lost position wins every predecessor; a won one counts down each predecessor's successors
+static void propagate_wdl(TbJob* job, Board* board, int value) {
+    Predecessor list[MAX_MOVES];
+    int count = predecessors(job, board, true, list);
+    
+    for (int i = 0; i < count; i++) {
+        uint64_t index = list[i].index;
+        if (value == WORK_LOSS) {
+            if (list[i].drawn) continue;
+            uint8_t flags = list[i].pawn ? WORK_ZEROING : 0;
+            uint8_t expected = WORK_UNKNOWN;
+            if (!atomic_compare_exchange_strong_explicit(&job->state[index], &expected,
+                                                         WORK_WIN | WORK_PENDING | flags,
+                                                         memory_order_relaxed, memory_order_relaxed)) {
+                atomic_fetch_or_explicit(&job->state[index], flags, memory_order_relaxed);
+            }
+        } else if ((atomic_load_explicit(&job->state[index], memory_order_relaxed) & WORK_VALUE) == WORK_UNKNOWN &&
+                   atomic_fetch_sub_explicit(&job->count[index], 1, memory_order_relaxed) == 1) {
+            atomic_store_explicit(&job->state[index], WORK_LOSS | WORK_PENDING, memory_order_relaxed);
+        }
+    }
+}
+
+// DTZ 1 for a zeroing win or a loss with only zeroing moves (mates have 0). Other losses count
+// the piece moves whose DTZ they still need.
+static void init_dtz(TbJob* job, uint64_t index, Board* board, int value) {
+    int dtz = atomic_load_explicit(&job->dtz[index], memory_order_relaxed);
+    if (value == WORK_WIN) {
+        if (atomic_load_explicit(&job->state[index], memory_order_relaxed) & WORK_ZEROING) dtz = 1;
+    } else if (dtz != 0) {
+        setup_board(job->table, index, board);
+        uint64_t list[MAX_MOVES];
+        int decided = 0;
+        int count = successors(job, board, false, list, &decided);
+        atomic_store_explicit(&job->count[index], (uint8_t)count, memory_order_relaxed);
+        if (count == 0) dtz = 1;
+    }
+    atomic_store_explicit(&job->dtz[index], (uint16_t)dtz, memory_order_relaxed);
+}
+
+// A loss at this DTZ gives its winning predecessors still without one the next DTZ; a win
+// counts down its losing predecessors, the last win a loss waits for setting its DTZ
+static bool propagate_dtz(TbJob* job, Board* board, int value) {
+    Predecessor list[MAX_MOVES];
+    int count = predecessors(job, board, false, list);
+    uint16_t next = (uint16_t)(job->level + 1);
+    bool changed = false;
+    
+    for (int i = 0; i < count; i++) {
+        uint64_t index = list[i].index;
+        int predecessor = atomic_load_explicit(&job->state[index], memory_order_relaxed) & WORK_VALUE;
+        if (value == WORK_LOSS && predecessor == WORK_WIN) {
+            uint16_t expected = DTZ_UNKNOWN;
+            changed |= atomic_compare_exchange_strong_explicit(&job->dtz[index], &expected, next,
+                                                               memory_order_relaxed, memory_order_relaxed);
+        } else if (value == WORK_WIN && predecessor == WORK_LOSS &&
+                   atomic_load_explicit(&job->dtz[index], memory_order_relaxed) == DTZ_UNKNOWN &&
+                   atomic_fetch_sub_explicit(&job->count[index], 1, memory_order_relaxed) == 1) {
+            atomic_store_explicit(&job->dtz[index], next, memory_order_relaxed);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Entry byte; the other indices of a position copy its entry
+static uint8_t work_entry(TbJob* job, uint64_t index, Board* board, int value) {
+    if (value == WORK_ILLEGAL) {
+        return TB_ENTRY_ILLEGAL;
+    }
+    if (value == WORK_ALIAS) {
+        setup_board(job->table, index, board);
+        index = board_index(job->table, board);
+        value = atomic_load_explicit(&job->state[index], memory_order_relaxed) & WORK_VALUE;
+    }
+    
+    int dtz = atomic_load_explicit(&job->dtz[index], memory_order_relaxed);
+    if (value == WORK_WIN) return encode_entry(1, dtz);
+    if (value == WORK_LOSS) return encode_entry(-1, dtz);
+    return encode_entry(0, 0);
+}
+
+static void* tb_worker(void* arg) {
+    TbJob* job = (TbJob*)arg;
+    Board* board = malloc(sizeof(Board));
+    if (!board) return NULL;
+    
+    for (;;) {
+        uint64_t start = atomic_fetch_add(&job->next_chunk, 1) * TB_CHUNK;
+        if (start >= job->table->entries) break;
+        uint64_t end = start + TB_CHUNK;
+        if (end > job->table->entries) end = job->table->entries;
+        
+        bool changed = false;
+        for (uint64_t index = start; index < end; index++) {
+            if (job->phase == PHASE_INIT) {
+                init_position(job, index, board);
+                continue;
+            }
+            
+            int state = atomic_load_explicit(&job->state[index], memory_order_relaxed);
+            int value = state & WORK_VALUE;
+            bool decided = value == WORK_WIN || value == WORK_LOSS;
+            
+            if (job->phase == PHASE_WDL) {
+                // Claimed by one thread; positions decided meanwhile may come up in this pass
+                if ((state & WORK_PENDING) &&
+                    (atomic_fetch_and_explicit(&job->state[index], (uint8_t)~WORK_PENDING, memory_order_relaxed) & WORK_PENDING)) {
+                    setup_board(job->table, index, board);
+                    propagate_wdl(job, board, value);
+                    changed = true;
+                }
+            } else if (job->phase == PHASE_DTZ_INIT) {
+                if (decided) init_dtz(job, index, board, value);
+            } else if (job->phase == PHASE_DTZ) {
+                if (decided && atomic_load_explicit(&job->dtz[index], memory_order_relaxed) == job->level) {
+                    setup_board(job->table, index, board);
+                    changed |= propagate_dtz(job, board, value);
+                }
+            } else {
+                job->data[index] = work_entry(job, index, board, value);
+            }
+        }
+        
+        if (changed) {
+            atomic_store_explicit(&job->changed, true, memory_order_relaxed);
+        }
+    }
+    
+    free(board);
+    return NULL;
+}
+
+// One pass over all positions; the calling thread works too
+static bool run_pass(TbJob* job, int threads) {
+    atomic_store(&job->next_chunk, 0);
+    atomic_store(&job->changed, false);
+    
+    run_workers(tb_worker, job, 0, threads);
+    return atomic_load(&job->changed);
+}
+
+
+// Generation
+
+static bool write_table(const Tablebase* table, const char* dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.ztb", dir, table->name);
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    
+    TbFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TB_FILE_MAGIC, 4);
+    header.version = TB_FILE_VERSION;
+    strcpy(header.name, table->name);
+    header.entries = table->entries;
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(table->data, 1, table->entries, file) == table->entries;
+    return fclose(file) == 0 && ok;
+}
+
+static bool generate_counts(const int counts[2][5], const char* dir, int threads, TbReportFunc report);
+
+// Makes sure the table for some material exists (unless it is a dead draw)
+static bool ensure_table(const int counts[2][5], const char* dir, int threads, TbReportFunc report) {
+    if (insufficient_counts(counts)) {
+        return true;
+    }
+    int canonical[2][5];
+    canonical_counts(counts, canonical);
+    Tablebase table;
+    init_table(&table, canonical);
+    return find_table(table.key) || generate_counts(canonical, dir, threads, report);
+}
+
+// Every material a position of this table can convert into
+static bool ensure_dependencies(const int counts[2][5], const char* dir, int threads, TbReportFunc report) {
+    for (int side = 0; side < 2; side++) {
+        for (int piece = PAWN; piece <= QUEEN; piece++) {
+            if (!counts[side][piece]) continue;
+            
+            // Captures
+            int sub[2][5];
+            memcpy(sub, counts, sizeof(sub));
+            sub[side][piece]--;
+            if (!ensure_table(sub, dir, threads, report)) return false;
+            
+            if (piece != PAWN) continue;
+            
+            // Promotions, with or without a capture
+            for (int promoted = KNIGHT; promoted <= QUEEN; promoted++) {
+                memcpy(sub, counts, sizeof(sub));
+                sub[side][PAWN]--;
+                sub[side][promoted]++;
+                if (!ensure_table(sub, dir, threads, report)) return false;
+                
+                for (int captured = KNIGHT; captured <= QUEEN; captured++) {
+                    if (!sub[1 - side][captured]) continue;
+                    sub[1 - side][captured]--;
+                    bool ok = ensure_table(sub, dir, threads, report);
+                    sub[1 - side][captured]++;
+                    if (!ok) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool generate_counts(const int counts[2][5], const char* dir, int threads, TbReportFunc report) {
+    if (!ensure_dependencies(counts, dir, threads, report)) {
+        return false;
+    }
+    
+    uint64_t start = get_time_ms();
+    
+    Tablebase table;
+    init_table(&table, counts);
+    TbJob job = {
+        .table = &table,
+        .state = malloc(table.entries * sizeof(_Atomic uint8_t)),
+        .count = malloc(table.entries * sizeof(_Atomic uint8_t)),
+        .dtz = malloc(table.entries * sizeof(_Atomic uint16_t))
+    };
+    if (!job.state || !job.count || !job.dtz) {
+        free(job.state);
+        free(job.count);
+        free(job.dtz);
+        return false;
+    }
+    
+    TbGenStats stats;
+    memset(&stats, 0, sizeof(stats));
+    
+    job.phase = PHASE_INIT;
+    run_pass(&job, threads);
+    
+    job.phase = PHASE_WDL;
+    while (run_pass(&job, threads)) {
+        stats.passes++;
+    }
+    stats.passes++;
+    
+    // DTZ one ply per pass: the first passes (mates, then zeroing moves) may be all that is found
+    job.phase = PHASE_DTZ_INIT;
+    run_pass(&job, threads);
+    job.phase = PHASE_DTZ;
+    bool changed = true;
+    for (job.level = 0; job.level <= 1 || changed; job.level++) {
+        changed = run_pass(&job, threads);
+        stats.passes++;
+    }
+    
+    // The counts make room for the entries
+    free(job.count);
+    job.data = atomic_load(&job.failed) ? NULL : malloc(table.entries);
+    if (!job.data) {
+        free(job.state);
+        free(job.dtz);
+        return false;
+    }
+    job.phase = PHASE_ENTRIES;
+    run_pass(&job, threads);
+    
+    for (uint64_t index = 0; index < table.entries; index++) {
+        uint8_t entry = job.data[index];
+        if (entry == TB_ENTRY_ILLEGAL) continue;
+        if (entry == 0) {
+            stats.draws++;
+            continue;
+        }
+        if (entry < 128) stats.wins++;
+        else stats.losses++;
+        
+        int value = atomic_load_explicit(&job.state[index], memory_order_relaxed) & WORK_VALUE;
+        int dtz = atomic_load_explicit(&job.dtz[index], memory_order_relaxed);
+        if (value != WORK_ALIAS && dtz > stats.max_dtz) stats.max_dtz = dtz;
+    }
+    free(job.state);
+    free(job.dtz);
+    
+    table.data = job.data;
+    stats.entries = table.entries;
+    stats.milliseconds = get_time_ms() - start;
+    
+    if (!write_table(&table, dir) || !register_table(&table)) {
+        free(job.data);
+        return false;
+    }
+    if (report) {
+        report(table.name, &stats);
+    }
+    return true;
+}
+
+bool generate_tablebase(const char* signature, const char* dir, int threads, TbReportFunc report) {
+    int counts[2][5], canonical[2][5];
+    if (!parse_signature(signature, counts)) {
+        return false;
+    }
+    if (threads < 1) threads = 1;
+    if (threads > MAX_TB_THREADS) threads = MAX_TB_THREADS;
+    
+    canonical_counts(counts, canonical);
+    Tablebase table;
+    init_table(&table, canonical);
+    if (find_table(table.key)) {
+        return true;
+    }
+    return generate_counts(canonical, dir, threads, report);
+}
+
+
+// Loading
+
+static bool load_table(const char* path, const char* name) {
+    int counts[2][5], canonical[2][5];
+    if (!parse_signature(name, counts)) {
+        return false;
+    }
+    canonical_counts(counts, canonical);
+    Tablebase table;
+    init_table(&table, canonical);
+    if (strcmp(table.name, name) != 0 || find_table(table.key)) {
+        return false;
+    }
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != sizeof(TbFileHeader) + table.entries) {
+        close(fd);
+        return false;
+    }
+    
+    // The mapping stays valid after the descriptor is closed
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    
+    const TbFileHeader* header = (const TbFileHeader*)map;
+    if (memcmp(header->magic, TB_FILE_MAGIC, 4) != 0 || header->version != TB_FILE_VERSION ||
+        header->entries != table.entries || strcmp(header->name, table.name) != 0) {
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+    
+    table.data = (const uint8_t*)map + sizeof(TbFileHeader);
+    table.map = map;
+    table.map_length = (size_t)st.st_size;
+    if (!register_table(&table)) {
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+    return true;
+}
+
+int load_tablebases(const char* dir) {
+    DIR* handle = opendir(dir);
+    if (!handle) {
+        return -1;
+    }
+    
+    int loaded = 0;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length < 5 || length - 4 >= TB_SIGNATURE_LENGTH || strcmp(entry->d_name + length - 4, ".ztb") != 0) {
+            continue;
+        }
+        
+        char name[TB_SIGNATURE_LENGTH];
+        memcpy(name, entry->d_name, length - 4);
+        name[length - 4] = '\0';
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (load_table(path, name)) {
+            loaded++;
+        }
+    }
+    
+    closedir(handle);
+    return loaded;
+}
+
+void free_tablebases(void) {
+    for (int i = 0; i < table_count; i++) {
+        if (tables[i].map) {
+            munmap(tables[i].map, tables[i].map_length);
+        } else {
+            free((void*)tables[i].data);
+        }
+    }
+    table_count = 0;
+    tb_max_pieces = 0;
+}
+
+
+// Probe Latency
+
+#define LATENCY_BOARDS 256
+
+double tablebase_probe_latency(int table, int samples) {
+    if (table < 0 || table >= table_count || samples <= 0) {
+        return 0.0;
+    }
+    
+    Board* boards = malloc(LATENCY_BOARDS * sizeof(Board));
+    if (!boards) {
+        return 0.0;
+    }
+    
+    // Random legal positions of the table
+    const Tablebase* tb = &tables[table];
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    int count = 0;
+    for (int attempt = 0; attempt < 1000000 && count < LATENCY_BOARDS; attempt++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        if (setup_board(tb, seed % tb->entries, &boards[count])) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        free(boards);
+        return 0.0;
+    }
+    
+    struct timespec start, end;
+    volatile int sink = 0;
+    TbResult result;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < samples; i++) {
+        if (probe_tablebase(&boards[i % count], &result)) {
+            sink += result.dtz;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(boards);
+    
+    double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+    return ns / samples;
+}
@@ -0,0 +1,76 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "types.h"
+#include "board.h"
+
+// Endgame tablebases: win/draw/loss and distance to zeroing for every position of a material
+// signature such as "KRvKP" (3 to 5 pieces), generated locally by retrograde analysis and
+// memory-mapped from <signature>.ztb files.
+//
+// DTZ counts the plies to the next capture or pawn move, or to mate, under best play (the
+// winner shortest, the loser longest). The fifty-move rule is not taken into account, and
+// positions with castling rights or an en passant square are never probed.
+//
+// A file is one byte per index: the side to move, the white king's slot under the board
+// symmetries, then every other piece among the squares still free (pawns among ranks 2-7).
+// The largest tables, five pieces with one pawn (such as KQRvKP), have 697M entries: a 665 MB file,
+// and 4 bytes per entry (2.6 GB) while generating. Five pieces without pawns take 286M entries.
+
+#define TB_MAX_PIECES 5
+#define TB_MAX_TABLES 512
+#define TB_SIGNATURE_LENGTH 16
+
+// Search score of a tablebase win, less the DTZ: above known wins, below mate scores
+#define TB_WIN_SCORE 20000
+
+typedef struct {
+    int wdl;    // 1 win, 0 draw, -1 loss for the side to move
+    int dtz;    // Plies to a zeroing move or mate (0 when mated); saturates at 126
+} TbResult;
+
+typedef struct {
+    uint64_t milliseconds;
+    uint64_t entries;                // Table size, legal or not
+    uint64_t wins, draws, losses;    // Legal positions, from the side to move's view
+    int max_dtz;
+    int passes;                      // Win/draw/loss passes plus DTZ passes
+} TbGenStats;
+
+// Called after each table is generated, including smaller tables a signature converts into
+typedef void (*TbReportFunc)(const char* signature, const TbGenStats* stats);
+
+// Generates a signature and any missing tables it converts into (by captures and promotions),
+// writing <dir>/<signature>.ztb for each. Returns false on a bad signature, an I/O error or a
+// capture or promotion into material that has no table.
+bool generate_tablebase(const char* signature, const char* dir, int threads, TbReportFunc report);
+
+// Canonical signature ("KQvKR"; the stronger side first), false if it cannot be parsed
+bool canonical_signature(const char* signature, char* out);
+
+// All signatures with 3 up to max_pieces pieces, in an order where every table's dependencies
+// come first. Returns the count.
+int tablebase_signatures(int max_pieces, char signatures[][TB_SIGNATURE_LENGTH], int max_count);
+
+// Memory-maps every .ztb file in a directory. Returns the number of tables loaded, -1 if the
+// directory cannot be read.
+int load_tablebases(const char* dir);
+void free_tablebases(void);
+
+// Largest piece count among the available tables (0 without tables)
+extern int tb_max_pieces;
+
+// Result for the board's material, false without a table (or with castling rights / en passant)
+bool probe_tablebase(const Board* board, TbResult* result);
+
+// Search score of a probe result for the side to move
+int tablebase_score(const TbResult* result);
+
+// Available tables (loaded or generated)
+int tablebase_count(void);
+const char* tablebase_name(int table);
+
+// Average probe time in nanoseconds over random legal positions of a table
+double tablebase_probe_latency(int table, int samples);
+
+#endif // TABLEBASE_H
@@ -1,29 +1,203 @@
+#define _DEFAULT_SOURCE
+
 #include "transposition.h"
+#include "board.h"
+#include "util.h"
+#include "zobrist.h"
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Upper bound on the threads zeroing the table
+#define MAX_CLEAR_THREADS 64
+
+// Smaller tables are zeroed on the calling thread
+#define PARALLEL_CLEAR_BYTES (64 * 1024 * 1024)
+
+
+// Parallel Zeroing
+
+typedef struct {
+    uint8_t* begin;
+    size_t length;
+} ClearTask;
+
+static void* clear_worker(void* arg) {
+    ClearTask* task = (ClearTask*)arg;
+    memset(task->begin, 0, task->length);
+    return NULL;
+}
+
+// Splits the memory on huge page boundaries; the calling thread takes the first slice
+static void zero_memory(void* memory, size_t bytes) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (bytes < PARALLEL_CLEAR_BYTES || cores < 1) ? 1 : (int)cores;
+    if (threads > MAX_CLEAR_THREADS) threads = MAX_CLEAR_THREADS;
+    
+    ClearTask tasks[MAX_CLEAR_THREADS];
+    size_t pages = (bytes + TT_ALIGNMENT - 1) / TT_ALIGNMENT;
+    for (int i = 0; i < threads; i++) {
+        size_t begin = pages * i / threads * TT_ALIGNMENT;
+        size_t end = pages * (i + 1) / threads * TT_ALIGNMENT;
+        if (end > bytes) end = bytes;
+        tasks[i].begin = (uint8_t*)memory + begin;
+        tasks[i].length = end > begin ? end - begin : 0;
+    }
+    
+    run_workers(clear_worker, tasks, sizeof(ClearTask), threads);
+}
 
 
 // Initialize transposition table
 
-void init_tt(TranspositionTable* tt, size_t size_mb) {
-    size_t num_entries = (size_mb * 1024 * 1024) / sizeof(TTEntry);
-    tt->entries = (TTEntry*)calloc(num_entries, sizeof(TTEntry));
+// Anonymous mapping of bytes (a multiple of TT_ALIGNMENT) on a TT_ALIGNMENT boundary: maps one
+// page more than needed and unmaps the slack on both sides
+static void* map_aligned(size_t bytes) {
+    size_t padded = bytes + TT_ALIGNMENT;
+    uint8_t* raw = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)raw + TT_ALIGNMENT - 1) & ~(uintptr_t)(TT_ALIGNMENT - 1));
+    if (aligned > raw) {
+        munmap(raw, (size_t)(aligned - raw));
+    }
+    size_t tail = (size_t)(raw + padded - (aligned + bytes));
+    if (tail) {
+        munmap(aligned + bytes, tail);
+    }
+    return aligned;
+}
+
+// Whether the kernel backs the mapping holding memory with huge pages: its AnonHugePages line
+// in /proc/self/smaps, since madvise() also succeeds when transparent huge pages are disabled
+static bool backed_by_huge_pages(const void* memory) {
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps) {
+        return false;
+    }
+    
+    char line[4096];
+    bool in_mapping = false;
+    unsigned long huge_kb = 0;
+    while (fgets(line, sizeof(line), smaps)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (in_mapping) break;
+            in_mapping = (uintptr_t)memory >= start && (uintptr_t)memory < end;
+        } else if (in_mapping && sscanf(line, "AnonHugePages: %lu kB", &huge_kb) == 1) {
+            break;
+        }
+    }
+    fclose(smaps);
+    return huge_kb > 0;
+}
+
+bool init_tt(TranspositionTable* tt, size_t size_mb) {
+    tt->entries = NULL;
+    tt->size = 0;
+    tt->current_age = 0;
+    tt->huge_pages = false;
+    tt->allocated_bytes = 0;
+    tt->mapped_bytes = 0;
+    reset_tt_stats(tt);
+#ifdef DEBUG
+    tt->positions = NULL;
+#endif
+    return resize_tt(tt, size_mb);
+}
+
+bool resize_tt(TranspositionTable* tt, size_t size_mb) {
+    size_t num_entries = (size_mb * 1024 * 1024) / sizeof(TTSlot);
+    size_t bytes = (num_entries * sizeof(TTSlot) + TT_ALIGNMENT - 1) / TT_ALIGNMENT * TT_ALIGNMENT;
+    if (num_entries == 0) {
+        free_tt(tt);
+        return true;
+    }
+
+#ifdef DEBUG
+    _Atomic uint64_t* positions = calloc(num_entries, sizeof(uint64_t));
+    if (!positions) {
+        return false;
+    }
+#endif
+    
+    // The table's own memory is kept when it is large enough; a smaller table gives back the
+    // huge pages past its end
+    if (tt->entries && tt->allocated_bytes >= bytes) {
+        if (tt->allocated_bytes > bytes) {
+            munmap((uint8_t*)tt->entries + bytes, tt->allocated_bytes - bytes);
+            tt->allocated_bytes = bytes;
+        }
+#ifdef DEBUG
+        free(tt->positions);
+        tt->positions = positions;
+#endif
+        tt->size = num_entries;
+        clear_tt(tt);
+        return true;
+    }
+    
+    void* memory = map_aligned(bytes);
+    if (!memory) {
+#ifdef DEBUG
+        free(positions);
+#endif
+        return false;
+    }
+    
+    // Without transparent huge pages the table simply stays on normal pages
+#ifdef MADV_HUGEPAGE
+    madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+    
+    // The mapping reads as zeros already: this is the first touch, faulting the pages in
+    // on every core rather than during the search
+    zero_memory(memory, bytes);
+    bool huge_pages = backed_by_huge_pages(memory);
+    
+    free_tt(tt);
+#ifdef DEBUG
+    tt->positions = positions;
+#endif
+    tt->entries = (TTSlot*)memory;
     tt->size = num_entries;
     tt->current_age = 0;
+    tt->huge_pages = huge_pages;
+    tt->allocated_bytes = bytes;
+    return true;
 }
 
 void free_tt(TranspositionTable* tt) {
-    if (tt->entries) {
-        free(tt->entries);
-        tt->entries = NULL;
+    if (tt->entries && tt->mapped_bytes) {
+        munmap((uint8_t*)tt->entries - TT_FILE_HEADER_SIZE, tt->mapped_bytes);
+    } else if (tt->entries) {
+        munmap(tt->entries, tt->allocated_bytes);
     }
+    tt->entries = NULL;
     tt->size = 0;
+    tt->allocated_bytes = 0;
+    tt->mapped_bytes = 0;
+#ifdef DEBUG
+    free(tt->positions);
+    tt->positions = NULL;
+#endif
 }
 
 void clear_tt(TranspositionTable* tt) {
     if (tt->entries) {
-        memset(tt->entries, 0, tt->size * sizeof(TTEntry));
+        zero_memory(tt->entries, tt->size * sizeof(TTSlot));
+    }
+#ifdef DEBUG
+    if (tt->positions) {
+        memset(tt->positions, 0, tt->size * sizeof(uint64_t));
     }
+#endif
     tt->current_age = 0;
 }
 
@@ -32,21 +206,240 @@ void age_tt(TranspositionTable* tt) {
 }
 
 
+// Snapshots
+
+#define TT_FILE_MAGIC "ZZTTSNAP"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;       // TT_LAYOUT_VERSION
+    uint32_t slot_size;     // sizeof(TTSlot)
+    uint64_t zobrist;       // zobrist_fingerprint()
+    uint64_t size;          // Slots
+    uint8_t current_age;
+} TTFileHeader;
+
+bool save_tt(const TranspositionTable* tt, const char* path) {
+    if (!tt->entries || tt->size == 0) {
+        return false;
+    }
+    
+    uint8_t header[TT_FILE_HEADER_SIZE] = { 0 };
+    TTFileHeader fields = {
+        .version = TT_LAYOUT_VERSION,
+        .slot_size = sizeof(TTSlot),
+        .zobrist = zobrist_fingerprint(),
+        .size = tt->size,
+        .current_age = tt->current_age
+    };
+    memcpy(fields.magic, TT_FILE_MAGIC, sizeof(fields.magic));
+    memcpy(header, &fields, sizeof(fields));
+    
+    // A crash while writing leaves the previous snapshot in place
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return false;
+    }
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+              fwrite((const void*)tt->entries, sizeof(TTSlot), tt->size, file) == tt->size;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+bool load_tt(TranspositionTable* tt, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    TTFileHeader header;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                 memcmp(header.magic, TT_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == TT_LAYOUT_VERSION && header.slot_size == sizeof(TTSlot) &&
+                 header.zobrist == zobrist_fingerprint() && header.size > 0 &&
+                 header.size <= ((uint64_t)st.st_size - TT_FILE_HEADER_SIZE) / sizeof(TTSlot) &&
+                 (uint64_t)st.st_size == TT_FILE_HEADER_SIZE + header.size * sizeof(TTSlot);
+    
+    // Private mapping: stores copy the touched pages, other processes keep sharing the rest
+    void* mapping = MAP_FAILED;
+    if (valid) {
+        mapping = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+#ifdef DEBUG
+    _Atomic uint64_t* positions = calloc((size_t)header.size, sizeof(uint64_t));
+    if (!positions) {
+        munmap(mapping, (size_t)st.st_size);
+        return false;
+    }
+#endif
+    
+    free_tt(tt);
+    tt->entries = (TTSlot*)((uint8_t*)mapping + TT_FILE_HEADER_SIZE);
+    tt->size = (size_t)header.size;
+    tt->current_age = header.current_age;
+    tt->huge_pages = false;
+    tt->mapped_bytes = (size_t)st.st_size;
+#ifdef DEBUG
+    tt->positions = positions;
+#endif
+    return true;
+}
+
+
+// Entry Packing
+
+static uint64_t pack_entry(int score, Move best_move, int depth, TTFlag flag, uint8_t age) {
+    return (uint64_t)(uint16_t)score | (uint64_t)best_move << 16 | (uint64_t)(uint8_t)depth << 32 |
+           (uint64_t)flag << 40 | (uint64_t)age << 48;
+}
+
+static void unpack_entry(uint64_t hash, uint64_t data, TTEntry* entry) {
+    entry->hash = hash;
+    entry->score = (int16_t)(uint16_t)data;
+    entry->best_move = (Move)(data >> 16);
+    entry->depth = (uint8_t)(data >> 32);
+    entry->flag = (uint8_t)(data >> 40);
+    entry->age = (uint8_t)(data >> 48);
+}
+
+
+// Statistics
+
+// Slots sampled by tt_hashfull()
+#define HASHFULL_SAMPLE 1000
+
+// A plain load and store: cheaper than a locked increment, and only loses counts under contention
+static inline void count(_Atomic uint64_t* counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+int tt_hashfull(const TranspositionTable* tt) {
+    size_t sample = tt->size < HASHFULL_SAMPLE ? tt->size : HASHFULL_SAMPLE;
+    if (!tt->entries || sample == 0) {
+        return 0;
+    }
+    
+    size_t used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        uint64_t key = atomic_load_explicit(&tt->entries[i].key, memory_order_relaxed);
+        uint64_t data = atomic_load_explicit(&tt->entries[i].data, memory_order_relaxed);
+        if ((key || data) && (uint8_t)(data >> 48) == tt->current_age) {
+            used++;
+        }
+    }
+    return (int)(used * 1000 / sample);
+}
+
+void get_tt_stats(const TranspositionTable* tt, TTStats* stats) {
+    const TTCounters* counters = &tt->counters;
+    stats->probes = atomic_load_explicit(&counters->probes, memory_order_relaxed);
+    stats->hits = atomic_load_explicit(&counters->hits, memory_order_relaxed);
+    stats->stores = atomic_load_explicit(&counters->stores, memory_order_relaxed);
+    stats->stored_empty = atomic_load_explicit(&counters->stored_empty, memory_order_relaxed);
+    stats->stored_age = atomic_load_explicit(&counters->stored_age, memory_order_relaxed);
+    stats->stored_depth = atomic_load_explicit(&counters->stored_depth, memory_order_relaxed);
+    stats->collisions = atomic_load_explicit(&counters->collisions, memory_order_relaxed);
+    uint64_t written = stats->stored_empty + stats->stored_age + stats->stored_depth;
+    stats->rejected = stats->stores > written ? stats->stores - written : 0;
+    stats->hashfull = tt_hashfull(tt);
+}
+
+void reset_tt_stats(TranspositionTable* tt) {
+    TTCounters* counters = &tt->counters;
+    atomic_store(&counters->probes, 0);
+    atomic_store(&counters->hits, 0);
+    atomic_store(&counters->stores, 0);
+    atomic_store(&counters->stored_empty, 0);
+    atomic_store(&counters->stored_age, 0);
+    atomic_store(&counters->stored_depth, 0);
+    atomic_store(&counters->collisions, 0);
+}
+
+#ifdef DEBUG
+// Digest of the whole position with its own mixing, so that two positions sharing a Zobrist
+// hash (a true collision) almost never share it too. Never 0, which marks an unknown position.
+static uint64_t position_digest(const Board* board) {
+    uint64_t digest = 0x243F6A8885A308D3ULL;
+    for (int color = 0; color < 2; color++) {
+        for (int piece = 0; piece < 6; piece++) {
+            digest = (digest ^ board->pieces[color][piece]) * 0x9E3779B97F4A7C15ULL;
+            digest ^= digest >> 29;
+        }
+    }
+    digest ^= (uint64_t)board->side_to_move | (uint64_t)board->castling_rights << 8 |
+              (uint64_t)board->en_passant_square << 16;
+    digest *= 0xBF58476D1CE4E5B9ULL;
+    digest ^= digest >> 31;
+    return digest ? digest : 1;
+}
+
+void record_tt_position(TranspositionTable* tt, const Board* board) {
+    if (!tt->entries || !tt->positions || tt->size == 0) {
+        return;
+    }
+    
+    // Only if the store was kept
+    size_t index = board->hash % tt->size;
+    TTSlot* slot = &tt->entries[index];
+    uint64_t data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    uint64_t key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+    if ((key ^ data) == board->hash) {
+        atomic_store_explicit(&tt->positions[index], position_digest(board), memory_order_relaxed);
+    }
+}
+#endif
+
+
 // Lookup and store
 
-TTEntry* probe_tt(const TranspositionTable* tt, uint64_t hash) {
+bool probe_tt(TranspositionTable* tt, const Board* board, TTEntry* entry) {
     if (!tt->entries || tt->size == 0) {
-        return NULL;
+        return false;
     }
     
-    size_t index = hash % tt->size;
-    TTEntry* entry = &tt->entries[index];
+    count(&tt->counters.probes);
     
-    if (entry->hash == hash) {
-        return entry;
+    uint64_t hash = board->hash;
+    size_t index = hash % tt->size;
+    TTSlot* slot = &tt->entries[index];
+    uint64_t data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    uint64_t key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+    if ((key ^ data) != hash) {
+        return false;
+    }
+    count(&tt->counters.hits);
+#ifdef DEBUG
+    uint64_t digest = tt->positions ? atomic_load_explicit(&tt->positions[index], memory_order_relaxed) : 0;
+    if (digest && digest != position_digest(board)) {
+        count(&tt->counters.collisions);
     }
+#endif
     
-    return NULL;
+    unpack_entry(hash, data, entry);
+    if (entry->best_move && !is_pseudo_legal(board, entry->best_move)) {
+        entry->best_move = 0;
+    }
+    return true;
+}
+
+void prefetch_tt(const TranspositionTable* tt, uint64_t hash) {
+    if (tt->entries && tt->size) {
+        __builtin_prefetch(&tt->entries[hash % tt->size]);
+    }
 }
 
 void store_tt(TranspositionTable* tt, uint64_t hash, int score, Move best_move, int depth, TTFlag flag) {
@@ -54,18 +447,35 @@ void store_tt(TranspositionTable* tt, uint64_t hash, int score, Move best_move,
         return;
     }
     
+    count(&tt->counters.stores);
     size_t index = hash % tt->size;
-    TTEntry* entry = &tt->entries[index];
+    TTSlot* slot = &tt->entries[index];
+    uint64_t old_key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+    uint64_t old_data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    TTEntry old;
+    unpack_entry(old_key ^ old_data, old_data, &old);
     
     // Always replace or depth-preferred replacement
-    if (entry->hash == 0 || entry->age != tt->current_age || depth >= entry->depth) {
-        entry->hash = hash;
-        entry->score = (int16_t)score;
-        entry->best_move = best_move;
-        entry->depth = (uint8_t)depth;
-        entry->flag = (uint8_t)flag;
-        entry->age = tt->current_age;
+    _Atomic uint64_t* reason;
+    if (old_key == 0 && old_data == 0) {
+        reason = &tt->counters.stored_empty;
+    } else if (old.age != tt->current_age) {
+        reason = &tt->counters.stored_age;
+    } else if (depth >= old.depth) {
+        reason = &tt->counters.stored_depth;
+    } else {
+        return;
+    }
+    count(reason);
+    
+    uint64_t data = pack_entry(score, best_move, depth, flag, tt->current_age);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->key, hash ^ data, memory_order_relaxed);
+#ifdef DEBUG
+    if (tt->positions) {
+        atomic_store_explicit(&tt->positions[index], 0, memory_order_relaxed);
     }
+#endif
 }
 
 
@@ -3,9 +3,18 @@
 
 #include "types.h"
 #include "moves.h"
+#include <stdatomic.h>
 #include <stddef.h>
 
-// Transposition table entry
+// Stored entry: two 64-bit words written with relaxed atomics, the key XOR-ed with the data.
+// Several threads may store to the same slot at once; a slot left with the key of one store
+// and the data of another fails the key check and reads as a miss.
+typedef struct {
+    _Atomic uint64_t key;   // hash ^ data
+    _Atomic uint64_t data;  // score | best_move << 16 | depth << 32 | flag << 40 | age << 48
+} TTSlot;
+
+// Transposition table entry, as decoded by probe_tt()
 typedef struct {
     uint64_t hash;      // Zobrist hash of position
     int16_t score;      // Evaluation score
@@ -15,26 +24,101 @@ typedef struct {
     uint8_t age;        // Search age for replacement scheme
 } TTEntry;
 
+// Counters, kept with relaxed loads and stores rather than atomic increments: exact for one
+// thread, a few updates may be lost when threads share the table
+typedef struct {
+    _Atomic uint64_t probes;
+    _Atomic uint64_t hits;              // Key verified
+    _Atomic uint64_t stores;            // store_tt() calls
+    _Atomic uint64_t stored_empty;      // Writes by reason: the slot was empty,
+    _Atomic uint64_t stored_age;        // held an entry of an older search,
+    _Atomic uint64_t stored_depth;      // or one searched no deeper
+    _Atomic uint64_t collisions;        // DEBUG builds: hits on another position with the same hash
+} TTCounters;
+
+// Snapshot of the counters (get_tt_stats)
+typedef struct {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t stored_empty;
+    uint64_t stored_age;
+    uint64_t stored_depth;
+    uint64_t rejected;      // Stores that kept a deeper entry of the current search
+    uint64_t collisions;
+    int hashfull;           // tt_hashfull()
+} TTStats;
+
 // Transposition table
 typedef struct {
-    TTEntry* entries;
+    TTSlot* entries;
     size_t size;
     uint8_t current_age;
+    bool huge_pages;    // The kernel backed the table with transparent huge pages when it was mapped
+    size_t allocated_bytes; // Length of the table's own mapping (0 for a snapshot)
+    size_t mapped_bytes;    // Non-zero when the slots live in a snapshot mapped by load_tt()
+#ifdef DEBUG
+    _Atomic uint64_t* positions;    // Per slot, a digest of the stored position independent of its hash
+#endif
+    _Alignas(64) TTCounters counters;   // A cache line of their own: written on every probe, while
+                                        // the fields above are only read during a search
 } TranspositionTable;
 
+// Alignment of the table, the size of an x86-64 huge page
+#define TT_ALIGNMENT (2 * 1024 * 1024)
+
+// Snapshot files: bump the version whenever TTSlot or the data packing changes. The header is
+// a page long so that the slots of a loaded snapshot can be mapped in place.
+#define TT_LAYOUT_VERSION 2
+#define TT_FILE_HEADER_SIZE 4096
+
 // Initialize and cleanup
-void init_tt(TranspositionTable* tt, size_t size_mb);
+// The table is 2 MB aligned and asks for huge pages, then is zeroed by one thread per core
+// (first touch), so the pages of a large table are faulted in in parallel. resize_tt() may be
+// called between searches: it empties the table, keeps the memory when the new size fits in it
+// (unmapping the pages past a smaller table) and otherwise maps a new table before releasing
+// the old one, which is kept if that fails. clear_tt() also zeroes large tables on every core.
+// init_tt() returns false, leaving an empty table, when the memory cannot be mapped.
+bool init_tt(TranspositionTable* tt, size_t size_mb);
+bool resize_tt(TranspositionTable* tt, size_t size_mb);
 void free_tt(TranspositionTable* tt);
 void clear_tt(TranspositionTable* tt);
 void age_tt(TranspositionTable* tt);
 
 // Lookup and store
-TTEntry* probe_tt(const TranspositionTable* tt, uint64_t hash);
+// probe_tt() copies out the entry for the board's hash; a best move that is not pseudo-legal
+// in the position (a key collision) is returned as 0.
+bool probe_tt(TranspositionTable* tt, const Board* board, TTEntry* entry);
+void prefetch_tt(const TranspositionTable* tt, uint64_t hash);   // Starts loading the entry into cache
 void store_tt(TranspositionTable* tt, uint64_t hash, int score, 
               Move best_move, int depth, TTFlag flag);
 
+// Statistics
+// tt_hashfull() is the permille of the first 1000 slots written by the current search (age).
+// The counters cover every probe and store since init_tt() or reset_tt_stats(); clear_tt()
+// keeps them. Collisions are only counted in DEBUG builds, where store_tt() callers also pass
+// each stored position to record_tt_position().
+int tt_hashfull(const TranspositionTable* tt);
+void get_tt_stats(const TranspositionTable* tt, TTStats* stats);
+void reset_tt_stats(TranspositionTable* tt);
+#ifdef DEBUG
+void record_tt_position(TranspositionTable* tt, const Board* board);
+#endif
+
+// Snapshots
+// save_tt() writes a header (Zobrist key fingerprint, layout version, slot count, age) and the
+// slots, through a temporary file renamed over path; call it while no search is running.
+// load_tt() checks the header and maps the file copy-on-write in place of the table, which takes
+// the snapshot's size: pages are read on first probe and shared through the page cache, and
+// stores never reach the file. Both return false on an I/O error or a mismatched header,
+// load_tt() leaving the table as it was.
+bool save_tt(const TranspositionTable* tt, const char* path);
+bool load_tt(TranspositionTable* tt, const char* path);
+
 // Utility functions
 bool tt_cutoff(const TTEntry* entry, int depth, int alpha, int beta, int* score);
+// Mate scores count plies from the root; stored entries count them from their own position.
+// adjust_mate_score() converts a score at ply for storing, unadjust_mate_score() back on probing.
 int adjust_mate_score(int score, int ply);
 int unadjust_mate_score(int score, int ply);
 
@@ -0,0 +1,401 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tune.h"
+#include "bitboard.h"
+#include "board.h"
+#include "evaluation.h"
+#include "packed.h"
+#include "search.h"
+#include "util.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Upper bound on the worker pool size
+#define MAX_TUNE_THREADS MAX_WORKERS
+
+// Adam constants
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+
+
+// Worker Pool
+
+// One slice of the training set; workers fill in loss and gradient
+typedef struct {
+    const TuneData* data;
+    const double* params;
+    double k;
+    size_t begin;
+    size_t end;
+    double loss;
+    double* gradient;           // NULL for loss only
+    const PackedPosition* positions;  // Loading only
+    TuneEntry* entries;               // Loading only
+} TuneTask;
+
+static int clamp_threads(int threads, size_t count) {
+    if (threads < 1) threads = 1;
+    if (threads > MAX_TUNE_THREADS) threads = MAX_TUNE_THREADS;
+    if ((size_t)threads > count) threads = count > 0 ? (int)count : 1;
+    return threads;
+}
+
+static void split_tasks(TuneTask* tasks, int threads, size_t count) {
+    for (int i = 0; i < threads; i++) {
+        tasks[i].begin = count * i / threads;
+        tasks[i].end = count * (i + 1) / threads;
+    }
+}
+
+
+// Feature Extraction
+
+void make_tune_entry(const Board* board, GameResult result, TuneEntry* entry) {
+    PackedPosition packed;
+    pack_position(board, &packed);
+    
+    memset(entry, 0, sizeof(TuneEntry));
+    entry->occupied = packed.occupied;
+    memcpy(entry->pieces, packed.pieces, sizeof(entry->pieces));
+    entry->phase = (uint16_t)get_game_phase(board);
+    entry->mobility = (int16_t)evaluate_mobility(board);
+    entry->result = (result == WHITE_WINS) ? 2 : (result == BLACK_WINS) ? 0 : 1;
+    
+    // Same terms as evaluate_pawn_structure() and evaluate_king_safety(), as counts
+    int doubled = 0, isolated = 0, open_file = 0;
+    for (int file = 0; file < 8; file++) {
+        Bitboard fmask = file_mask(file);
+        Bitboard adjacent_files = 0ULL;
+        if (file > 0) adjacent_files |= file_mask(file - 1);
+        if (file < 7) adjacent_files |= file_mask(file + 1);
+        
+        int white_pawns = popcount(board->pieces[WHITE][PAWN] & fmask);
+        int black_pawns = popcount(board->pieces[BLACK][PAWN] & fmask);
+        if (white_pawns > 1) doubled += white_pawns - 1;
+        if (black_pawns > 1) doubled -= black_pawns - 1;
+        
+        if (white_pawns && !(board->pieces[WHITE][PAWN] & adjacent_files)) isolated++;
+        if (black_pawns && !(board->pieces[BLACK][PAWN] & adjacent_files)) isolated--;
+    }
+    
+    Bitboard pawns = board->pieces[WHITE][PAWN] | board->pieces[BLACK][PAWN];
+    Square white_king = get_king_square(board, WHITE);
+    Square black_king = get_king_square(board, BLACK);
+    if (white_king != NO_SQUARE && !(pawns & file_mask(square_file(white_king)))) open_file++;
+    if (black_king != NO_SQUARE && !(pawns & file_mask(square_file(black_king)))) open_file--;
+    
+    entry->doubled = (int8_t)doubled;
+    entry->isolated = (int8_t)isolated;
+    entry->king_open_file = (int8_t)open_file;
+}
+
+static void* load_worker(void* arg) {
+    TuneTask* task = (TuneTask*)arg;
+    Board* board = malloc(sizeof(Board));
+    
+    for (size_t i = task->begin; i < task->end; i++) {
+        const PackedPosition* packed = &task->positions[i];
+        TuneEntry* entry = &task->entries[i];
+        
+        // Unusable positions are marked and squeezed out afterwards
+        entry->result = 0xFF;
+        if (packed->result == ONGOING || !unpack_position(packed, board) ||
+            is_in_check(board, board->side_to_move)) {
+            continue;
+        }
+        make_tune_entry(board, (GameResult)packed->result, entry);
+    }
+    
+    free(board);
+    return NULL;
+}
+
+bool load_tune_data(TuneData* data, const char* path, int threads) {
+    memset(data, 0, sizeof(TuneData));
+    
+    PackedMap map;
+    if (!packed_map_open(&map, path)) {
+        return false;
+    }
+    const PackedPosition* positions = packed_map_positions(&map);
+    if (!positions) {
+        packed_map_close(&map);
+        return false;
+    }
+    
+    size_t count = map.count;
+    data->entries = malloc((count > 0 ? count : 1) * sizeof(TuneEntry));
+    if (!data->entries) {
+        packed_map_close(&map);
+        return false;
+    }
+    
+    // Mobility needs move generation, so feature extraction runs on all workers
+    threads = clamp_threads(threads, count);
+    TuneTask tasks[MAX_TUNE_THREADS];
+    split_tasks(tasks, threads, count);
+    for (int i = 0; i < threads; i++) {
+        tasks[i].positions = positions;
+        tasks[i].entries = data->entries;
+    }
+    run_workers(load_worker, tasks, sizeof(TuneTask), threads);
+    packed_map_close(&map);
+    
+    for (size_t i = 0; i < count; i++) {
+        if (data->entries[i].result != 0xFF) {
+            data->entries[data->count++] = data->entries[i];
+        }
+    }
+    return true;
+}
+
+void free_tune_data(TuneData* data) {
+    free(data->entries);
+    data->entries = NULL;
+    data->count = 0;
+}
+
+
+// Parameters
+
+void init_tune_params(double* params, const EvalParams* eval) {
+    for (int piece_type = PAWN; piece_type <= QUEEN; piece_type++) {
+        params[TUNE_MATERIAL + piece_type] = eval->material[piece_type];
+    }
+    for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+        for (int sq = 0; sq < 64; sq++) {
+            params[TUNE_PST_MG + piece_type * 64 + sq] = eval->pst_mg[piece_type][sq];
+            params[TUNE_PST_EG + piece_type * 64 + sq] = eval->pst_eg[piece_type][sq];
+        }
+    }
+    
+    params[TUNE_DOUBLED] = eval->doubled_pawn;
+    params[TUNE_ISOLATED] = eval->isolated_pawn;
+    params[TUNE_KING_OPEN_FILE] = eval->king_open_file;
+    params[TUNE_MOBILITY] = eval->mobility / 256.0;
+}
+
+void tune_params_to_eval(const double* params, EvalParams* eval) {
+    // Settings that are not tuned keep their defaults
+    default_eval_params(eval);
+    for (int piece_type = PAWN; piece_type <= QUEEN; piece_type++) {
+        eval->material[piece_type] = (int)lround(params[TUNE_MATERIAL + piece_type]);
+    }
+    for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+        for (int sq = 0; sq < 64; sq++) {
+            eval->pst_mg[piece_type][sq] = (int)lround(params[TUNE_PST_MG + piece_type * 64 + sq]);
+            eval->pst_eg[piece_type][sq] = (int)lround(params[TUNE_PST_EG + piece_type * 64 + sq]);
+        }
+    }
+    
+    eval->doubled_pawn = (int)lround(params[TUNE_DOUBLED]);
+    eval->isolated_pawn = (int)lround(params[TUNE_ISOLATED]);
+    eval->king_open_file = (int)lround(params[TUNE_KING_OPEN_FILE]);
+    eval->mobility = (int)lround(params[TUNE_MOBILITY] * 256.0);
+}
+
+// Evaluation from White's point of view; with a gradient, adds scale * d(eval)/d(param)
+static double entry_eval(const double* params, const TuneEntry* entry, double* gradient, double scale) {
+    double score = 0.0, mg = 0.0, eg = 0.0;
+    double mg_weight = entry->phase / 256.0;
+    double eg_weight = 1.0 - mg_weight;
+    
+    Bitboard occupied = entry->occupied;
+    for (int i = 0; occupied; i++) {
+        Square sq = pop_lsb(&occupied);
+        int code = (entry->pieces[i >> 1] >> ((i & 1) * 4)) & 0xF;
+        int piece_type = code & 7;
+        bool white = (code >> 3) == WHITE;
+        double sign = white ? 1.0 : -1.0;
+        int pst_index = piece_type * 64 + (white ? sq : mirror_square(sq));
+        
+        mg += sign * params[TUNE_PST_MG + pst_index];
+        eg += sign * params[TUNE_PST_EG + pst_index];
+        if (piece_type != KING) {
+            score += sign * params[TUNE_MATERIAL + piece_type];
+        }
+        
+        if (gradient) {
+            gradient[TUNE_PST_MG + pst_index] += scale * sign * mg_weight;
+            gradient[TUNE_PST_EG + pst_index] += scale * sign * eg_weight;
+            if (piece_type != KING) {
+                gradient[TUNE_MATERIAL + piece_type] += scale * sign;
+            }
+        }
+    }
+    
+    score += mg * mg_weight + eg * eg_weight;
+    score += params[TUNE_DOUBLED] * entry->doubled;
+    score += params[TUNE_ISOLATED] * entry->isolated;
+    score += params[TUNE_KING_OPEN_FILE] * entry->king_open_file;
+    score += params[TUNE_MOBILITY] * entry->mobility;
+    
+    if (gradient) {
+        gradient[TUNE_DOUBLED] += scale * entry->doubled;
+        gradient[TUNE_ISOLATED] += scale * entry->isolated;
+        gradient[TUNE_KING_OPEN_FILE] += scale * entry->king_open_file;
+        gradient[TUNE_MOBILITY] += scale * entry->mobility;
+    }
+    return score;
+}
+
+double tune_evaluate(const double* params, const TuneEntry* entry) {
+    return entry_eval(params, entry, NULL, 0.0);
+}
+
+
+// Loss and Gradient
+
+static inline double sigmoid(double k, double score) {
+    return 1.0 / (1.0 + exp(-k * score));
+}
+
+static void* loss_worker(void* arg) {
+    TuneTask* task = (TuneTask*)arg;
+    const TuneEntry* entries = task->data->entries;
+    double loss = 0.0;
+    
+    for (size_t i = task->begin; i < task->end; i++) {
+        double target = entries[i].result * 0.5;
+        double s = sigmoid(task->k, tune_evaluate(task->params, &entries[i]));
+        double error = s - target;
+        loss += error * error;
+        
+        // d(error^2)/d(eval); the parameter part is added by a second pass through the entry
+        if (task->gradient) {
+            entry_eval(task->params, &entries[i], task->gradient, 2.0 * error * s * (1.0 - s) * task->k);
+        }
+    }
+    
+    task->loss = loss;
+    return NULL;
+}
+
+// Sum of squared errors over all entries, and optionally the summed gradient
+static double compute_loss(const TuneData* data, const double* params, double k, int threads, double* gradient) {
+    threads = clamp_threads(threads, data->count);
+    TuneTask tasks[MAX_TUNE_THREADS];
+    double* gradients = NULL;
+    
+    if (gradient) {
+        gradients = calloc((size_t)threads * TUNE_PARAM_COUNT, sizeof(double));
+    }
+    
+    split_tasks(tasks, threads, data->count);
+    for (int i = 0; i < threads; i++) {
+        tasks[i].data = data;
+        tasks[i].params = params;
+        tasks[i].k = k;
+        tasks[i].gradient = gradients ? gradients + (size_t)i * TUNE_PARAM_COUNT : NULL;
+    }
+    run_workers(loss_worker, tasks, sizeof(TuneTask), threads);
+    
+    double loss = 0.0;
+    for (int i = 0; i < threads; i++) {
+        loss += tasks[i].loss;
+    }
+    if (gradient) {
+        memset(gradient, 0, TUNE_PARAM_COUNT * sizeof(double));
+        for (int i = 0; i < threads; i++) {
+            for (int p = 0; p < TUNE_PARAM_COUNT; p++) {
+                gradient[p] += tasks[i].gradient[p];
+            }
+        }
+        free(gradients);
+    }
+    return loss;
+}
+
+double tune_loss(const TuneData* data, const double* params, double k, int threads) {
+    if (data->count == 0) return 0.0;
+    return compute_loss(data, params, k, threads, NULL) / data->count;
+}
+
+double find_best_k(const TuneData* data, const double* params, int threads) {
+    // Golden-section search; the loss is unimodal in k
+    const double ratio = 0.6180339887498949;
+    double low = 0.0, high = 0.05;
+    double a = high - ratio * (high - low);
+    double b = low + ratio * (high - low);
+    double loss_a = tune_loss(data, params, a, threads);
+    double loss_b = tune_loss(data, params, b, threads);
+    
+    for (int i = 0; i < 40; i++) {
+        if (loss_a < loss_b) {
+            high = b;
+            b = a;
+            loss_b = loss_a;
+            a = high - ratio * (high - low);
+            loss_a = tune_loss(data, params, a, threads);
+        } else {
+            low = a;
+            a = b;
+            loss_a = loss_b;
+            b = low + ratio * (high - low);
+            loss_b = tune_loss(data, params, b, threads);
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+
+// Optimisation
+
+double run_tuner(const TuneData* data, double* params, TuneParams* tune_params,
+                 TuneProgressFunc progress, void* user_data) {
+    if (data->count == 0) {
+        return 0.0;
+    }
+    if (tune_params->k <= 0.0) {
+        tune_params->k = find_best_k(data, params, tune_params->threads);
+    }
+    
+    double* gradient = malloc(TUNE_PARAM_COUNT * sizeof(double));
+    double* m = calloc(TUNE_PARAM_COUNT, sizeof(double));
+    double* v = calloc(TUNE_PARAM_COUNT, sizeof(double));
+    double loss = 0.0;
+    uint64_t start = get_time_ms();
+    
+    for (int epoch = 1; epoch <= tune_params->epochs; epoch++) {
+        loss = compute_loss(data, params, tune_params->k, tune_params->threads, gradient) / data->count;
+        
+        double correction1 = 1.0 - pow(ADAM_BETA1, epoch);
+        double correction2 = 1.0 - pow(ADAM_BETA2, epoch);
+        for (int p = 0; p < TUNE_PARAM_COUNT; p++) {
+            double g = gradient[p] / data->count;
+            m[p] = ADAM_BETA1 * m[p] + (1.0 - ADAM_BETA1) * g;
+            v[p] = ADAM_BETA2 * v[p] + (1.0 - ADAM_BETA2) * g * g;
+            params[p] -= tune_params->learning_rate * (m[p] / correction1) /
+                         (sqrt(v[p] / correction2) + ADAM_EPSILON);
+        }
+        
+        if (progress && tune_params->report_every > 0 &&
+            (epoch % tune_params->report_every == 0 || epoch == tune_params->epochs)) {
+            uint64_t elapsed = get_time_ms() - start;
+            TuneProgress report = {
+                .epoch = epoch,
+                .loss = loss,
+                .k = tune_params->k,
+                .epochs_per_second = elapsed ? epoch * 1000.0 / elapsed : 0.0
+            };
+            progress(&report, user_data);
+        }
+    }
+    
+    free(v);
+    free(m);
+    free(gradient);
+    return tune_loss(data, params, tune_params->k, tune_params->threads);
+}
+
+
+// Output
+
+bool write_tune_params(const double* params, const char* path) {
+    EvalParams eval;
+    tune_params_to_eval(params, &eval);
+    return save_eval_params(&eval, path);
+}
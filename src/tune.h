@@ -0,0 +1,83 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "types.h"
+#include "board.h"
+#include "evaluation.h"
+#include <stddef.h>
+
+// Texel tuning of the evaluation weights
+// evaluate() is linear in its weights apart from the game phase, which is kept fixed,
+// so every position is reduced once to the features the weights multiply.
+
+// Parameter vector layout (mirrors EvalParams)
+#define TUNE_MATERIAL        0      // [5] pawn..queen values
+#define TUNE_PST_MG          5      // [6][64] midgame tables
+#define TUNE_PST_EG          389    // [6][64] endgame tables
+#define TUNE_DOUBLED         773    // Per doubled pawn (negative = penalty)
+#define TUNE_ISOLATED        774    // Per file with an isolated pawn
+#define TUNE_KING_OPEN_FILE  775    // King on a file without pawns
+#define TUNE_MOBILITY        776    // Per legal move, in centipawns
+#define TUNE_PARAM_COUNT     777
+
+// A training position in 32 bytes (all features from White's point of view)
+typedef struct {
+    Bitboard occupied;
+    uint8_t pieces[16];     // Same nibble packing as PackedPosition
+    uint16_t phase;         // get_game_phase(), 0..256
+    int16_t mobility;       // White minus Black legal moves
+    int8_t doubled;         // White minus Black doubled pawns
+    int8_t isolated;        // White minus Black isolated pawn files
+    int8_t king_open_file;  // White minus Black kings on open files
+    uint8_t result;         // 0 = Black won, 1 = draw, 2 = White won
+} TuneEntry;
+
+_Static_assert(sizeof(TuneEntry) == 32, "TuneEntry must be 32 bytes");
+
+// Loaded training set
+typedef struct {
+    TuneEntry* entries;
+    size_t count;
+} TuneData;
+
+// Tuner settings
+typedef struct {
+    int threads;
+    int epochs;
+    double learning_rate;   // Adam step size (centipawns)
+    double k;               // Sigmoid scale, 0 = fit to the data before tuning
+    int report_every;       // Progress callback interval in epochs (0 = none)
+} TuneParams;
+
+// Progress after an epoch
+typedef struct {
+    int epoch;
+    double loss;
+    double k;
+    double epochs_per_second;
+} TuneProgress;
+
+typedef void (*TuneProgressFunc)(const TuneProgress* progress, void* user_data);
+
+// Loading (packed position files; positions in check or without a result are skipped)
+bool load_tune_data(TuneData* data, const char* path, int threads);
+void free_tune_data(TuneData* data);
+void make_tune_entry(const Board* board, GameResult result, TuneEntry* entry);
+
+// Parameters (converted from and to EvalParams, see evaluation.h)
+void init_tune_params(double* params, const EvalParams* eval);
+void tune_params_to_eval(const double* params, EvalParams* eval);
+double tune_evaluate(const double* params, const TuneEntry* entry);
+
+// Mean squared error of sigmoid(k * eval) against the results
+double tune_loss(const TuneData* data, const double* params, double k, int threads);
+double find_best_k(const TuneData* data, const double* params, int threads);
+
+// Adam optimisation of all parameters, returns the final loss
+double run_tuner(const TuneData* data, double* params, TuneParams* tune_params,
+                 TuneProgressFunc progress, void* user_data);
+
+// Write the parameters as a file for load_eval_params()
+bool write_tune_params(const double* params, const char* path);
+
+#endif // TUNE_H
@@ -97,10 +97,17 @@ typedef enum {
 #define TT_SIZE_MB 64
 #define TT_ENTRIES ((TT_SIZE_MB * 1024 * 1024) / sizeof(TTEntry))
 
+// Evaluation cache size (rounded down to a power of 2 entries)
+#define EVAL_CACHE_SIZE_MB 4
+
 // Move ordering score ranges
 #define SCORE_HASH_MOVE     10000000
 #define SCORE_MVV_LVA_BASE  1000000
 #define SCORE_KILLER_1      100000
 #define SCORE_KILLER_2      10000
+#define SCORE_COUNTER_MOVE  9000    // Above any sum of the history tables (3 * HISTORY_MAX)
+
+// Bound of every history table entry
+#define HISTORY_MAX         2048
 
 #endif // TYPES_H
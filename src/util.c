@@ -0,0 +1,39 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "util.h"
+#include <pthread.h>
+#include <time.h>
+
+
+// Timing
+
+uint64_t get_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+
+// Worker Threads
+
+void run_workers(void* (*work)(void*), void* args, size_t arg_size, int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > MAX_WORKERS) threads = MAX_WORKERS;
+    
+    pthread_t workers[MAX_WORKERS];
+    bool spawned[MAX_WORKERS] = { false };
+    for (int i = 1; i < threads; i++) {
+        void* arg = (char*)args + i * arg_size;
+        spawned[i] = pthread_create(&workers[i], NULL, work, arg) == 0;
+        if (!spawned[i]) {
+            work(arg);
+        }
+    }
+    work(args);
+    
+    for (int i = 1; i < threads; i++) {
+        if (spawned[i]) {
+            pthread_join(workers[i], NULL);
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#include "types.h"
+#include <stddef.h>
+
+// Monotonic wall clock in milliseconds
+uint64_t get_time_ms(void);
+
+// Most threads run_workers() starts at once
+#define MAX_WORKERS 256
+
+// Runs work() on threads workers (clamped to 1..MAX_WORKERS) and waits for all of them. Worker i
+// gets args + i * arg_size, or args itself when arg_size is 0 (workers sharing one job). The
+// calling thread runs worker 0, and runs any worker that cannot be spawned as well.
+void run_workers(void* (*work)(void*), void* args, size_t arg_size, int threads);
+
+#endif // UTIL_H
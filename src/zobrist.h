@@ -7,14 +7,28 @@
 // Zobrist hash initialization
 void init_zobrist(void);
 
+// Digest of every search key, identifying the key set (checked by saved transposition tables)
+uint64_t zobrist_fingerprint(void);
+
 // Hash computation
 uint64_t compute_hash(const Board* board);
+uint64_t compute_material_key(const Board* board);
+
+// Opening book key with the Polyglot layout: 64 * kind + square for pieces (kind 0 black pawn,
+// 1 white pawn, ... 11 white king), then castling (768-771), the en passant file (772-779, only
+// when a pawn of the side to move can capture there) and White to move (780)
+#define POLYGLOT_RANDOM_COUNT 781
+uint64_t compute_polyglot_key(const Board* board);
 void update_hash_move(Board* board, Move move);
 
+// Hash of the position after a move, without making it (used to prefetch the child's TT entry)
+uint64_t hash_after_move(const Board* board, Move move);
+
 // Zobrist keys
 extern uint64_t piece_keys[2][6][64];
 extern uint64_t castling_keys[16];
 extern uint64_t en_passant_keys[64];
 extern uint64_t side_key;
+extern const uint64_t polyglot_random[POLYGLOT_RANDOM_COUNT];
 
 #endif // ZOBRIST_H
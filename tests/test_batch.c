@@ -0,0 +1,114 @@
+// test_batch.c
+// Test suite for batch.c
+
+#include "../src/batch.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include "../src/transposition.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+static const char* test_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "3q2k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+    "rnbqkb1r/pppp1ppp/5n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 0 1",
+    "4k3/8/8/8/8/8/4P3/4K3 b - - 0 1"
+};
+#define TEST_FEN_COUNT 6
+
+typedef struct {
+    int seen[TEST_FEN_COUNT];
+    Move best[TEST_FEN_COUNT];
+    uint64_t nodes;
+} Collected;
+
+static void collect_result(const BatchResult* result, void* user_data) {
+    Collected* collected = (Collected*)user_data;
+    assert(result->index >= 0 && result->index < TEST_FEN_COUNT);
+    assert(result->fen == test_fens[result->index]);
+    collected->seen[result->index]++;
+    collected->best[result->index] = result->best_move;
+    collected->nodes += result->nodes;
+}
+
+void test_batch_all_positions_reported() {
+    init_bitboards();
+    init_zobrist();
+    
+    TranspositionTable tt;
+    assert(init_tt(&tt, 4));
+    
+    BatchParams params = {0};
+    params.depth = 2;
+    params.threads = 3;
+    params.tt = &tt;
+    
+    Collected collected;
+    memset(&collected, 0, sizeof(collected));
+    
+    uint64_t nodes = analyse_batch(test_fens, TEST_FEN_COUNT, &params, collect_result, &collected);
+    
+    assert(nodes == collected.nodes);
+    assert(nodes > 0);
+    
+    for (int i = 0; i < TEST_FEN_COUNT; i++) {
+        assert(collected.seen[i] == 1);
+        
+        Board board;
+        set_fen(&board, test_fens[i]);
+        assert(collected.best[i] != 0);
+        assert(is_legal(&board, collected.best[i]));
+    }
+    
+    // Rook takes the undefended queen
+    assert(collected.best[1] == encode_move(D1, D8, CAPTURE));
+    // Scholar's mate
+    assert(collected.best[4] == encode_move(H5, F7, CAPTURE));
+    
+    free_tt(&tt);
+}
+
+void test_batch_node_limit() {
+    init_bitboards();
+    init_zobrist();
+    
+    TranspositionTable tt;
+    assert(init_tt(&tt, 4));
+    
+    BatchParams params = {0};
+    params.depth = 10;
+    params.max_nodes = 2000;
+    params.threads = 2;
+    params.clear_tt = true;
+    params.tt = &tt;
+    
+    Collected collected;
+    memset(&collected, 0, sizeof(collected));
+    
+    analyse_batch(test_fens, TEST_FEN_COUNT, &params, collect_result, &collected);
+    
+    for (int i = 0; i < TEST_FEN_COUNT; i++) {
+        assert(collected.seen[i] == 1);
+        assert(collected.best[i] != 0);
+    }
+    
+    // Each search stops close to the limit
+    assert(collected.nodes <= (uint64_t)TEST_FEN_COUNT * (2000 + 1));
+    
+    free_tt(&tt);
+}
+
+int main() {
+    printf("Running batch tests...\n");
+    
+    test_batch_all_positions_reported();
+    test_batch_node_limit();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,269 @@
+// test_bitbase.c
+// Test suite for bitbase.c
+
+#include "../src/bitbase.h"
+#include "../src/endgame.h"
+#include "../src/evaluation.h"
+#include "../src/search.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include "../src/movegen.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FEN of a KPK position with White holding the pawn
+static void kpk_fen(char* fen, Square white_king, Square pawn, Square black_king, Color stm) {
+    char squares[64];
+    memset(squares, 0, sizeof(squares));
+    squares[white_king] = 'K';
+    squares[pawn] = 'P';
+    squares[black_king] = 'k';
+    
+    char* out = fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            char piece = squares[make_square(rank, file)];
+            if (!piece) {
+                empty++;
+                continue;
+            }
+            if (empty) *out++ = (char)('0' + empty);
+            empty = 0;
+            *out++ = piece;
+        }
+        if (empty) *out++ = (char)('0' + empty);
+        if (rank > 0) *out++ = '/';
+    }
+    sprintf(out, " %c - - 0 1", stm == WHITE ? 'w' : 'b');
+}
+
+// Legal position: kings apart, nothing shared, the side not to move not in check
+static bool kpk_legal(Square white_king, Square pawn, Square black_king, Color stm) {
+    if (square_distance(white_king, black_king) <= 1 || white_king == pawn || black_king == pawn) return false;
+    return !(stm == WHITE && (pawn_attacks(pawn, WHITE) & square_bb(black_king)));
+}
+
+
+// Exhaustive Search
+// Independent of the bitbase: plays legal moves on a Board. White wins by promoting
+// to a piece the black king cannot take at once (the bitbase's notion of a win).
+
+#define SOLVE_KEY(board) ((unsigned)(board)->side_to_move | (get_king_square(board, WHITE) << 1) | \
+                          (get_king_square(board, BLACK) << 7) | (lsb((board)->pieces[WHITE][PAWN]) << 13))
+
+static uint8_t win_depth[1 << 19];      // Smallest depth proven to win, 0xFF for none
+static uint8_t no_win_depth[1 << 19];   // Largest depth proven not to win, plus one
+
+static bool white_wins(Board* board, int depth) {
+    if (!board->pieces[WHITE][PAWN] || depth == 0) return false;
+    
+    unsigned key = SOLVE_KEY(board);
+    if (win_depth[key] <= depth) return true;
+    if (no_win_depth[key] > depth) return false;
+    
+    MoveList list;
+    generate_moves(board, &list);
+    bool white = board->side_to_move == WHITE;
+    bool win = !white;
+    bool any_move = false;
+    
+    for (int i = 0; i < list.count; i++) {
+        Move move = list.moves[i];
+        if (!make_move_if_legal(board, move)) continue;
+        any_move = true;
+        
+        bool result;
+        if (is_promotion(move)) {
+            Square to = move_to(move);
+            result = square_distance(get_king_square(board, BLACK), to) > 1 ||
+                     square_distance(get_king_square(board, WHITE), to) == 1;
+        } else {
+            result = white_wins(board, depth - 1);
+        }
+        unmake_move(board, move);
+        
+        if (result == white) {
+            win = white;
+            break;
+        }
+    }
+    
+    // Stalemate
+    if (!any_move) win = false;
+    
+    if (win) {
+        win_depth[key] = (uint8_t)depth;
+    } else {
+        no_win_depth[key] = (uint8_t)(depth + 1);
+    }
+    return win;
+}
+
+
+// Tests
+
+// Runs first: the bitbase is generated by the first probe, without init_evaluation()
+void test_kpk_probe_before_init() {
+    init_bitboards();
+    init_zobrist();
+    
+    assert(kpk_probe(E1, E5, A8, WHITE));
+    
+    Board board;
+    set_fen(&board, "8/8/8/4k3/8/8/4P3/4K3 b - - 0 1");
+    assert(is_kpk(&board) && !kpk_is_win(&board, WHITE));
+    set_fen(&board, "4k3/8/8/8/8/4p3/8/K7 b - - 0 1");
+    assert(is_kpk(&board) && kpk_is_win(&board, BLACK));
+}
+
+void test_kpk_known_positions() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Outside the square of the pawn, unless Black moves first
+    assert(kpk_probe(E1, E5, A8, WHITE));
+    assert(!kpk_probe(E1, E5, A8, BLACK));
+    
+    // Rook pawn with the defending king in the corner
+    assert(!kpk_probe(A1, H3, H8, WHITE));
+    
+    // King on the sixth in front of the pawn wins whoever moves; on the fifth, the opposition decides
+    assert(kpk_probe(E6, E5, E8, WHITE));
+    assert(kpk_probe(E6, E5, E8, BLACK));
+    assert(kpk_probe(E5, E4, E7, BLACK));
+    assert(!kpk_probe(E5, E4, E7, WHITE));
+    
+    // Key square in front of the pawn wins regardless of the move
+    assert(kpk_probe(D6, E4, E8, WHITE));
+    assert(kpk_probe(D6, E4, E8, BLACK));
+    
+    // Board probes flip Black's pawn to White
+    Board board;
+    set_fen(&board, "4k2K/8/8/8/8/4p3/8/8 w - - 0 1");
+    assert(is_kpk(&board));
+    assert(kpk_is_win(&board, BLACK));
+    set_fen(&board, "8/8/8/8/8/4k3/4p3/4K3 w - - 0 1");
+    assert(!kpk_is_win(&board, BLACK));
+    set_fen(&board, "8/8/8/8/8/4k3/4p3/4KN2 w - - 0 1");
+    assert(!is_kpk(&board));
+}
+
+void test_kpk_threads_agree() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Every probe result, single-threaded
+    static bool single[2][64][64][64];
+    generate_kpk_bitbase(1);
+    KpkStats stats;
+    get_kpk_stats(&stats);
+    int wins = stats.wins;
+    assert(stats.threads == 1 && stats.passes > 0 && wins > 0);
+    
+    for (int stm = WHITE; stm <= BLACK; stm++)
+        for (Square wk = 0; wk < 64; wk++)
+            for (Square bk = 0; bk < 64; bk++)
+                for (Square pawn = A2; pawn <= H7; pawn++)
+                    single[stm][wk][bk][pawn] = kpk_probe(wk, pawn, bk, (Color)stm);
+    
+    // The same bitbase with several threads racing on the shared results
+    generate_kpk_bitbase(4);
+    get_kpk_stats(&stats);
+    assert(stats.threads == 4 && stats.wins == wins);
+    
+    for (int stm = WHITE; stm <= BLACK; stm++)
+        for (Square wk = 0; wk < 64; wk++)
+            for (Square bk = 0; bk < 64; bk++)
+                for (Square pawn = A2; pawn <= H7; pawn++)
+                    assert(single[stm][wk][bk][pawn] == kpk_probe(wk, pawn, bk, (Color)stm));
+    
+    // Mirrored files give mirrored results
+    for (Square wk = 0; wk < 64; wk++)
+        for (Square bk = 0; bk < 64; bk++)
+            assert(kpk_probe(wk, C5, bk, WHITE) == kpk_probe(wk ^ 7, F5, bk ^ 7, WHITE));
+}
+
+void test_kpk_exhaustive_search() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Every legal position with the pawn on files a-d; the longest wins fit in the depth
+    const int depth = 41;
+    memset(win_depth, 0xFF, sizeof(win_depth));
+    memset(no_win_depth, 0, sizeof(no_win_depth));
+    int checked = 0, wins = 0;
+    
+    for (int rank = 6; rank >= 1; rank--) {
+        for (int file = 0; file < 4; file++) {
+            Square pawn = make_square(rank, file);
+            for (int stm = WHITE; stm <= BLACK; stm++) {
+                for (Square wk = 0; wk < 64; wk++) {
+                    for (Square bk = 0; bk < 64; bk++) {
+                        if (!kpk_legal(wk, pawn, bk, (Color)stm)) continue;
+                        
+                        char fen[128];
+                        kpk_fen(fen, wk, pawn, bk, (Color)stm);
+                        Board board;
+                        set_fen(&board, fen);
+                        
+                        bool expected = kpk_probe(wk, pawn, bk, (Color)stm);
+                        assert(white_wins(&board, depth) == expected);
+                        checked++;
+                        wins += expected;
+                    }
+                }
+            }
+        }
+    }
+    
+    KpkStats stats;
+    get_kpk_stats(&stats);
+    assert(wins == stats.wins);
+    printf("  %d positions verified (%d wins)\n", checked, wins);
+}
+
+void test_kpk_evaluation_and_search() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Exact draw and win scores
+    Board board;
+    set_fen(&board, "8/8/8/8/8/8/4P3/4K2k w - - 0 1");
+    assert(evaluate(&board) > KNOWN_WIN);
+    set_fen(&board, "8/4k3/8/4K3/4P3/8/8/8 w - - 0 1");
+    assert(evaluate(&board) == 0);
+    
+    // The search stops at every KPK child instead of searching it out
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    SearchParams params = { .max_depth = 6, .use_quiescence = true, .tt = &tt };
+    SearchInfo info;
+    set_fen(&board, "8/8/8/8/8/8/4P3/4K2k w - - 0 1");
+    iterative_deepening(&board, 6, &info, &params);
+    assert(info.bitbase_hits > 0);
+    assert(info.pv_lines[0].score > KNOWN_WIN);
+    assert(info.nodes_searched < 200);
+    free_tt(&tt);
+}
+
+int main() {
+    printf("Running bitbase tests...\n");
+    
+    test_kpk_probe_before_init();
+    test_kpk_known_positions();
+    test_kpk_threads_agree();
+    test_kpk_exhaustive_search();
+    test_kpk_evaluation_and_search();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
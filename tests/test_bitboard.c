@@ -95,6 +95,42 @@ void test_sliding_pieces() {
     assert(popcount(queen) == 27);
 }
 
+// Reference ray walk for sliding attacks
+static Bitboard ray_attacks(Square sq, Bitboard occupied, const int dirs[4][2]) {
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int r = square_rank(sq) + dirs[d][0];
+        int f = square_file(sq) + dirs[d][1];
+        while (r >= 0 && r < 8 && f >= 0 && f < 8) {
+            Square to = make_square(r, f);
+            attacks |= square_bb(to);
+            if (occupied & square_bb(to)) break;
+            r += dirs[d][0];
+            f += dirs[d][1];
+        }
+    }
+    return attacks;
+}
+
+void test_magic_attacks_all_squares() {
+    init_bitboards();
+    
+    const int rook_dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    const int bishop_dirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 20000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        Bitboard occupied = state & (state >> 17);
+        Square sq = (Square)(i & 63);
+        
+        assert(rook_attacks(sq, occupied) == ray_attacks(sq, occupied, rook_dirs));
+        assert(bishop_attacks(sq, occupied) == ray_attacks(sq, occupied, bishop_dirs));
+    }
+}
+
 void test_masks() {
     Bitboard rank0 = rank_mask(0);
     assert(popcount(rank0) == 8);
@@ -109,6 +145,26 @@ void test_masks() {
     assert(popcount(anti_diag) == 8);
 }
 
+void test_between_and_line() {
+    init_bitboards();
+    
+    // Same rank
+    assert(between_bb(A1, D1) == (square_bb(B1) | square_bb(C1)));
+    assert(popcount(line_bb(A1, D1)) == 8);
+    
+    // Same diagonal, either order
+    assert(between_bb(H8, E5) == (square_bb(G7) | square_bb(F6)));
+    assert(between_bb(E5, H8) == between_bb(H8, E5));
+    assert(line_bb(E5, H8) == (diagonal_mask(E5) | square_bb(E5)));
+    
+    // Adjacent squares have nothing between them
+    assert(between_bb(E4, E5) == 0ULL);
+    
+    // Unaligned squares
+    assert(between_bb(A1, B3) == 0ULL);
+    assert(line_bb(A1, B3) == 0ULL);
+}
+
 int main() {
     printf("Running bitboard tests...\n");
     
@@ -117,6 +173,8 @@ int main() {
     test_lsb();
     test_attack_tables();
     test_sliding_pieces();
+    test_magic_attacks_all_squares();
+    test_between_and_line();
     test_masks();
     
     printf("All tests passed.\n");
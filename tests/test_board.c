@@ -286,6 +286,59 @@ void test_promotion() {
     assert(piece_on(&board, E8) == NO_PIECE_TYPE);
 }
 
+void test_promotion_capture() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    set_fen(&board, "3r4/4P3/8/8/8/8/8/4K2k w - - 0 1");
+    uint64_t hash_before = board.hash;
+    
+    // Capture the rook while promoting
+    Move promo = encode_move(E7, D8, PROMOTION_QUEEN);
+    make_move(&board, promo);
+    
+    assert(piece_on(&board, D8) == QUEEN);
+    assert(color_on(&board, D8) == WHITE);
+    assert(board.pieces[BLACK][ROOK] == 0ULL);
+    assert(board.halfmove_clock == 0);
+    assert(board.hash == compute_hash(&board));
+    
+    unmake_move(&board, promo);
+    
+    assert(piece_on(&board, E7) == PAWN);
+    assert(piece_on(&board, D8) == ROOK);
+    assert(color_on(&board, D8) == BLACK);
+    assert(board.hash == hash_before);
+}
+
+void test_compact_history() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    init_board(&board);
+    
+    // Shuffle knights for far more plies than the undo stack holds
+    Move moves[4] = {
+        encode_move(G1, F3, NORMAL), encode_move(G8, F6, NORMAL),
+        encode_move(F3, G1, NORMAL), encode_move(F6, G8, NORMAL)
+    };
+    
+    for (int i = 0; i < 4 * MAX_PLY; i++) {
+        if (board.history_index >= MAX_PLY - 1) {
+            compact_history(&board);
+            assert(board.undo_index == 0);
+            assert(board.history_index <= MAX_PLY / 2);
+        }
+        make_move(&board, moves[i % 4]);
+    }
+    
+    // Repetitions are still detected after compaction
+    assert(is_repetition(&board));
+    assert(board.position_history[board.history_index - 1] == board.hash);
+}
+
 void test_castling_rights_update() {
     init_bitboards();
     init_zobrist();
@@ -410,6 +463,55 @@ void test_repetition_detection() {
     assert(is_repetition(&board) == true);
 }
 
+void test_gives_check() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    CheckInfo info;
+    
+    // Direct check by a knight, quiet knight move
+    set_fen(&board, "4k3/8/8/8/8/8/8/4K1N1 w - - 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(G1, F3, NORMAL)) == false);
+    set_fen(&board, "4k3/8/8/8/8/5N2/8/4K3 w - - 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(F3, D6, NORMAL)) == true);
+    
+    // Discovered check: the bishop uncovers the rook, unless it stays on the file
+    set_fen(&board, "4k3/8/8/8/4B3/8/8/K3R3 w - - 0 1");
+    init_check_info(&board, &info);
+    assert(info.blockers == square_bb(E4));
+    assert(gives_check(&board, &info, encode_move(E4, B1, NORMAL)) == true);
+    
+    set_fen(&board, "4k3/8/8/8/4N3/8/8/K3R3 w - - 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(E4, G5, NORMAL)) == true);
+    
+    set_fen(&board, "4k3/8/8/8/4Q3/8/8/K3R3 w - - 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(E4, E5, NORMAL)) == true);
+    assert(gives_check(&board, &info, encode_move(E4, A4, NORMAL)) == true);
+    assert(gives_check(&board, &info, encode_move(E4, H4, NORMAL)) == true);
+    
+    // Promotion checks along the file the pawn leaves
+    set_fen(&board, "1k6/4P3/8/8/8/8/8/K7 w - - 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(E7, E8, PROMOTION_QUEEN)) == true);
+    assert(gives_check(&board, &info, encode_move(E7, E8, PROMOTION_KNIGHT)) == false);
+    assert(gives_check(&board, &info, encode_move(E7, E8, PROMOTION_ROOK)) == true);
+    
+    // En passant uncovers a rank check through both pawns
+    set_fen(&board, "8/8/8/k2pP2R/8/8/8/4K3 w - d6 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(E5, D6, EN_PASSANT)) == true);
+    
+    // Castling checks with the rook
+    set_fen(&board, "5k2/8/8/8/8/8/8/4K2R w K - 0 1");
+    init_check_info(&board, &info);
+    assert(gives_check(&board, &info, encode_move(E1, G1, CASTLE_KINGSIDE)) == true);
+}
+
 int main() {
     printf("Running board tests...\n");
     
@@ -419,11 +521,14 @@ int main() {
     test_piece_queries();
     test_attack_detection();
     test_check_detection();
+    test_gives_check();
     test_make_unmake_simple();
     test_make_unmake_capture();
     test_castling();
     test_en_passant();
     test_promotion();
+    test_promotion_capture();
+    test_compact_history();
     test_castling_rights_update();
     test_halfmove_clock();
     test_insufficient_material();
@@ -0,0 +1,252 @@
+// test_book.c
+// Test suite for book.c
+
+#include "../src/book.h"
+#include "../src/zobrist.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/moves.h"
+#include "../src/movegen.h"
+#include "../src/notation.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GAMES_PGN "tests/fixtures/games.pgn"
+#define BOOK_PATH "/tmp/zugzwang_test_book.bin"
+#define BOOK_PATH_THREADS "/tmp/zugzwang_test_book_threads.bin"
+
+static uint64_t polyglot_key_of(const char* fen) {
+    Board board;
+    set_fen(&board, fen);
+    return compute_polyglot_key(&board);
+}
+
+// A book entry in file order: big-endian key, move, weight, learn
+static void write_entry(FILE* file, uint64_t key, uint16_t move, uint16_t weight) {
+    uint8_t bytes[BOOK_ENTRY_SIZE] = { 0 };
+    for (int i = 0; i < 8; i++) bytes[i] = (uint8_t)(key >> (56 - 8 * i));
+    bytes[8] = (uint8_t)(move >> 8);
+    bytes[9] = (uint8_t)move;
+    bytes[10] = (uint8_t)(weight >> 8);
+    bytes[11] = (uint8_t)weight;
+    fwrite(bytes, 1, BOOK_ENTRY_SIZE, file);
+}
+
+typedef struct {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+} TestEntry;
+
+static uint16_t book_move(Square from, Square to, int promotion) {
+    return (uint16_t)(to | (from << 6) | (promotion << 12));
+}
+
+static bool files_equal(const char* a, const char* b) {
+    FILE* fa = fopen(a, "rb");
+    FILE* fb = fopen(b, "rb");
+    assert(fa && fb);
+    bool equal = true;
+    int ca, cb;
+    do {
+        ca = fgetc(fa);
+        cb = fgetc(fb);
+        if (ca != cb) equal = false;
+    } while (equal && ca != EOF);
+    fclose(fa);
+    fclose(fb);
+    return equal;
+}
+
+
+// Tests
+
+void test_polyglot_key() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Independent of the search keys, and it follows the position
+    Board board;
+    init_board(&board);
+    uint64_t start = compute_polyglot_key(&board);
+    assert(start != compute_hash(&board));
+    assert(start != polyglot_key_of("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1"));
+    assert(start != polyglot_key_of("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w Kkq - 0 1"));
+    
+    // Transpositions share a key; the clocks do not count
+    assert(polyglot_key_of("rnbqkb1r/pppppppp/5n2/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 2 2") ==
+           polyglot_key_of("rnbqkb1r/pppppppp/5n2/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 0 9"));
+    
+    // The en passant file counts only when a pawn can capture
+    assert(polyglot_key_of("rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2") ==
+           polyglot_key_of("rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2"));
+    assert(polyglot_key_of("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3") !=
+           polyglot_key_of("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq - 0 3"));
+    
+    // Keys follow the layout: a white pawn on e4 is kind 1, square 28
+    Board e4;
+    set_fen(&e4, "4k3/8/8/8/4P3/8/8/4K3 b - - 0 1");
+    Board none;
+    set_fen(&none, "4k3/8/8/8/8/8/8/4K3 b - - 0 1");
+    assert((compute_polyglot_key(&e4) ^ compute_polyglot_key(&none)) == polyglot_random[64 * 1 + E4]);
+    
+    // The reference keys from the Polyglot format description
+    assert(start == 0x463B96181691FC9CULL);
+    assert(polyglot_key_of("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1") == 0x823C9B50FD114196ULL);
+    assert(polyglot_key_of("rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2") == 0x0756B94461C50FB0ULL);
+    assert(polyglot_key_of("rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2") == 0x662FAFB965DB29D4ULL);
+    assert(polyglot_key_of("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3") == 0x22A48B5A8E47FF78ULL);
+    assert(polyglot_key_of("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3") == 0x652A607CA3F242C1ULL);
+    assert(polyglot_key_of("rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4") == 0x00FDD303C946BDD9ULL);
+    assert(polyglot_key_of("rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3") == 0x3C8123EA7B067637ULL);
+    assert(polyglot_key_of("rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4") == 0x5C3F9B829B279560ULL);
+}
+
+void test_probe_handmade_book() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Start position: e2e4 (weight 3) and d2d4 (weight 1); castling written as the king taking the rook
+    const char* castle_fen = "r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R w KQkq - 0 1";
+    uint64_t start = polyglot_key_of(START_FEN);
+    uint64_t castle = polyglot_key_of(castle_fen);
+    
+    TestEntry entries[] = {
+        { start, book_move(E2, E4, 0), 3 },
+        { start, book_move(D2, D4, 0), 1 },
+        { start, book_move(E2, E5, 0), 50 },    // Not a legal move, never returned
+        { castle, book_move(E1, H1, 0), 1 },
+        { castle, book_move(E1, A1, 0), 1 }
+    };
+    
+    // Sorted by key
+    int count = (int)(sizeof(entries) / sizeof(entries[0]));
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (entries[j].key < entries[i].key) {
+                TestEntry tmp = entries[i];
+                entries[i] = entries[j];
+                entries[j] = tmp;
+            }
+        }
+    }
+    FILE* file = fopen(BOOK_PATH, "wb");
+    assert(file);
+    for (int i = 0; i < count; i++) write_entry(file, entries[i].key, entries[i].move, entries[i].weight);
+    fclose(file);
+    
+    Book book;
+    assert(book_open(&book, BOOK_PATH));
+    assert(book.count == (uint64_t)count);
+    
+    Board board;
+    init_board(&board);
+    BookMove moves[BOOK_MAX_MOVES];
+    int found = book_moves(&book, &board, moves, BOOK_MAX_MOVES);
+    assert(found == 2);
+    assert(moves[0].move == encode_move(E2, E4, NORMAL) && moves[0].weight == 3);
+    assert(moves[1].move == encode_move(D2, D4, NORMAL) && moves[1].weight == 1);
+    
+    // Weighted picks
+    uint64_t seed = 12345;
+    int e4 = 0;
+    for (int i = 0; i < 400; i++) {
+        Move move = book_probe(&book, &board, &seed);
+        assert(move == encode_move(E2, E4, NORMAL) || move == encode_move(D2, D4, NORMAL));
+        e4 += move == encode_move(E2, E4, NORMAL);
+    }
+    assert(e4 > 240 && e4 < 360);
+    
+    // Castling moves decode to the engine's castling moves
+    set_fen(&board, castle_fen);
+    found = book_moves(&book, &board, moves, BOOK_MAX_MOVES);
+    assert(found == 2);
+    for (int i = 0; i < found; i++) {
+        MoveFlags flags = move_flags(moves[i].move);
+        assert(flags == CASTLE_KINGSIDE || flags == CASTLE_QUEENSIDE);
+    }
+    
+    // Out of book
+    set_fen(&board, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    assert(book_probe(&book, &board, &seed) == 0);
+    book_close(&book);
+    
+    // Not a book
+    assert(!book_open(&book, GAMES_PGN));
+    assert(!book_open(&book, "/nonexistent/book.bin"));
+}
+
+void test_build_book() {
+    init_bitboards();
+    init_zobrist();
+    
+    const char* paths[] = { GAMES_PGN };
+    BookBuildParams params = { .threads = 1, .max_ply = 16, .min_games = 1 };
+    BookBuildStats stats;
+    assert(build_book(paths, 1, BOOK_PATH, &params, &stats));
+    assert(stats.games > 0 && stats.positions > 0 && stats.entries > 0);
+    assert(stats.entries <= stats.positions);
+    
+    // The workers' counts merge into the same file
+    params.threads = 4;
+    BookBuildStats threaded;
+    assert(build_book(paths, 1, BOOK_PATH_THREADS, &params, &threaded));
+    assert(threaded.games == stats.games && threaded.entries == stats.entries);
+    assert(files_equal(BOOK_PATH, BOOK_PATH_THREADS));
+    
+    Book book;
+    assert(book_open(&book, BOOK_PATH));
+    assert(book.count == stats.entries);
+    
+    // Sorted by key
+    for (uint64_t i = 1; i < book.count; i++) {
+        assert(memcmp(book.data + (i - 1) * BOOK_ENTRY_SIZE, book.data + i * BOOK_ENTRY_SIZE, 8) <= 0);
+    }
+    
+    // The first game opens 1. e4 and White wins it: at least 2 points; heaviest moves first
+    Board board;
+    init_board(&board);
+    BookMove moves[BOOK_MAX_MOVES];
+    int found = book_moves(&book, &board, moves, BOOK_MAX_MOVES);
+    assert(found > 1);
+    bool has_e4 = false;
+    for (int i = 0; i < found; i++) {
+        if (moves[i].move == encode_move(E2, E4, NORMAL)) has_e4 = moves[i].weight >= 2;
+        if (i > 0) assert(moves[i - 1].weight >= moves[i].weight);
+    }
+    assert(has_e4);
+    
+    // Every book move of the line is legal
+    uint64_t seed = 42;
+    for (int ply = 0; ply < 8; ply++) {
+        Move move = book_probe(&book, &board, &seed);
+        if (!move) break;
+        assert(is_legal(&board, move));
+        make_move(&board, move);
+    }
+    book_close(&book);
+    
+    // Rare moves are left out
+    params.min_games = 1000;
+    assert(build_book(paths, 1, BOOK_PATH, &params, &stats));
+    assert(stats.entries == 0);
+    
+    const char* missing[] = { "/nonexistent/games.pgn" };
+    assert(!build_book(missing, 1, BOOK_PATH, &params, &stats));
+    
+    remove(BOOK_PATH);
+    remove(BOOK_PATH_THREADS);
+}
+
+int main() {
+    printf("Running book tests...\n");
+    
+    test_polyglot_key();
+    test_probe_handmade_book();
+    test_build_book();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
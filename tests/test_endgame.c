@@ -0,0 +1,132 @@
+// test_endgame.c
+// Test suite for endgame.c
+
+#include "../src/endgame.h"
+#include "../src/material.h"
+#include "../src/evaluation.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include <stdio.h>
+#include <assert.h>
+
+static int eval_fen(const char* fen) {
+    Board board;
+    set_fen(&board, fen);
+    return evaluate(&board);
+}
+
+void test_relative_square() {
+    assert(relative_square(WHITE, E2) == E2);
+    assert(relative_square(BLACK, E2) == E7);
+    assert(relative_square(BLACK, A8) == A1);
+}
+
+void test_kxk() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Known win, better with the lone king on the edge
+    int centre = eval_fen("8/8/8/4k3/8/8/8/KR6 w - - 0 1");
+    int edge = eval_fen("4k3/8/8/8/8/8/8/KR6 w - - 0 1");
+    assert(centre > KNOWN_WIN);
+    assert(edge > centre);
+    
+    // Same score from the losing side
+    assert(eval_fen("4k3/8/8/8/8/8/8/KR6 b - - 0 1") == -edge);
+}
+
+void test_kbnk() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Light-squared bishop: h1 and a8 are the mating corners
+    int right_corner = eval_fen("k7/8/8/8/8/8/8/KBN5 w - - 0 1");
+    int wrong_corner = eval_fen("7k/8/8/8/8/8/8/KBN5 w - - 0 1");
+    int centre = eval_fen("8/8/8/4k3/8/8/8/KBN5 w - - 0 1");
+    assert(centre > KNOWN_WIN);
+    assert(right_corner > wrong_corner);
+    assert(wrong_corner > KNOWN_WIN);
+}
+
+void test_krkp() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Our king in front of the pawn wins
+    int won = eval_fen("8/8/8/8/8/3k4/4p3/4K2R w - - 0 1");
+    assert(won > 400);
+    
+    // Pawn on the seventh supported by its king, our king far away: close to a draw
+    int drawish = eval_fen("K7/8/8/8/8/8/4pk2/7R w - - 0 1");
+    assert(drawish < 200);
+    assert(won > drawish);
+}
+
+void test_kpk() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Defending king outside the square
+    assert(eval_fen("k7/8/8/4P3/8/8/8/4K3 w - - 0 1") > KNOWN_WIN);
+    
+    // Rook pawn with the king in the corner
+    assert(eval_fen("7k/8/8/8/8/7P/8/K7 w - - 0 1") == 0);
+    
+    // Our king on a key square
+    assert(eval_fen("4k3/8/3K4/8/4P3/8/8/8 b - - 0 1") < -KNOWN_WIN);
+    
+    // Opposition: drawn with White to move, won with Black to move
+    assert(eval_fen("8/4k3/8/4K3/4P3/8/8/8 w - - 0 1") == 0);
+    assert(eval_fen("8/4k3/8/4K3/4P3/8/8/8 b - - 0 1") < -KNOWN_WIN);
+    
+    // Wins grow as the pawn advances
+    assert(eval_fen("k7/8/4P3/8/8/8/8/4K3 w - - 0 1") > eval_fen("k7/8/8/4P3/8/8/8/4K3 w - - 0 1"));
+    
+    // Mirrored for Black
+    assert(eval_fen("4k2K/8/8/8/8/4p3/8/8 w - - 0 1") < -KNOWN_WIN);
+}
+
+void test_scale_factors() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Two knights against a bare king are a draw
+    assert(eval_fen("8/8/8/4k3/8/8/8/KNN5 w - - 0 1") == 0);
+    
+    // A lone minor piece is a draw too
+    assert(eval_fen("8/8/8/4k3/8/8/8/KB6 w - - 0 1") == 0);
+    
+    // Opposite-colored bishops shrink a one-pawn edge
+    Board board;
+    set_fen(&board, "8/5k2/3b4/3p4/3P4/2PB4/5K2/8 w - - 0 1");
+    int scaled = evaluate(&board);
+    int unscaled = evaluate_material(&board) + evaluate_piece_square(&board) + evaluate_mobility(&board) / 2 +
+                   evaluate_pawn_structure(&board) + evaluate_king_safety(&board);
+    assert(scaled > 0);
+    assert(scaled < unscaled);
+    assert(scale_opposite_bishops(&board, WHITE) == 16);
+    
+    // Same-colored bishops are not scaled
+    set_fen(&board, "8/5k2/4b3/3p4/3P4/2PB4/5K2/8 w - - 0 1");
+    assert(scale_opposite_bishops(&board, WHITE) == SCALE_NORMAL);
+}
+
+int main() {
+    printf("Running endgame tests...\n");
+    
+    test_relative_square();
+    test_kxk();
+    test_kbnk();
+    test_krkp();
+    test_kpk();
+    test_scale_factors();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
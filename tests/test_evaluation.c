@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 void test_piece_values() {
     assert(piece_value(PAWN) == 100);
@@ -179,11 +181,11 @@ void test_evaluation_symmetry() {
     init_zobrist();
     
     Board board1, board2;
-
+    
     // White pawn on e4, White to move
     set_fen(&board1, "4k3/8/8/8/4P3/8/8/4K3 w - - 0 1");
     int score1 = evaluate(&board1);
-
+    
     // Same position, Black to move
     set_fen(&board2, "4k3/8/8/8/4P3/8/8/4K3 b - - 0 1");
     int score2 = evaluate(&board2);
@@ -205,6 +207,272 @@ void test_evaluation_consistency() {
     assert(score1 == score2);
 }
 
+void test_combined_tables() {
+    // The compiled-in parameters are active before init_evaluation(), derived tables included
+    EvalParams before = eval_params;
+    init_evaluation();
+    assert(memcmp(&before, &eval_params, sizeof(EvalParams)) == 0);
+    
+    // Black's entries are White's, mirrored and negated
+    for (int piece_type = PAWN; piece_type <= KING; piece_type++) {
+        for (int sq = 0; sq < 64; sq++) {
+            assert(eval_params.psq_mg[WHITE][piece_type][sq] == eval_params.pst_mg[piece_type][sq]);
+            assert(eval_params.psq_mg[BLACK][piece_type][sq] == -eval_params.psq_mg[WHITE][piece_type][mirror_square(sq)]);
+            assert(eval_params.psq_eg[BLACK][piece_type][sq] == -eval_params.psq_eg[WHITE][piece_type][mirror_square(sq)]);
+        }
+    }
+    assert(eval_params.pst_mg[KING][G1] == king_pst_midgame[G1]);
+    assert(eval_params.pst_eg[KING][E4] == king_pst_endgame[E4]);
+    assert(eval_params.pst_eg[KNIGHT][D4] == knight_pst[D4]);
+}
+
+void test_eval_params_file() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    const char* path = "/tmp/zugzwang_test_eval_params.txt";
+    Board board;
+    set_fen(&board, "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4");
+    int default_score = evaluate(&board);
+    
+    // Round trip of the defaults
+    EvalParams params;
+    assert(save_eval_params(&eval_params, path));
+    assert(load_eval_params(&params, path));
+    set_eval_params(&params);
+    assert(evaluate(&board) == default_score);
+    
+    // Partial file: missing entries keep their defaults
+    FILE* file = fopen(path, "w");
+    fprintf(file, "# Knights are worth more\nmaterial 100 400 330 500 900\nmobility 0\n");
+    fclose(file);
+    assert(load_eval_params(&params, path));
+    assert(params.material[KNIGHT] == 400);
+    assert(params.pst_mg[PAWN][E4] == pawn_pst[E4]);
+    set_eval_params(&params);
+    set_fen(&board, "4k3/p7/8/8/8/8/P7/1N2K3 w - - 0 1");
+    int knight_score = evaluate(&board);
+    init_evaluation();
+    assert(knight_score - evaluate(&board) == 80 - evaluate_mobility(&board) / 2);
+    
+    // Unknown names and short tables are rejected
+    file = fopen(path, "w");
+    fprintf(file, "pst_mg_pawn 1 2 3\n");
+    fclose(file);
+    assert(!load_eval_params(&params, path));
+    file = fopen(path, "w");
+    fprintf(file, "bishop_pair 50\n");
+    fclose(file);
+    assert(!load_eval_params(&params, path));
+    assert(!load_eval_params(&params, "/nonexistent/zugzwang_params.txt"));
+    remove(path);
+}
+
+void test_trace_evaluate() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    const char* fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 4 4",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "4k3/pp3ppp/8/8/8/8/PP4PP/4K3 w - - 0 1"
+    };
+    
+    // The trace adds up to evaluate() and each term matches its component
+    for (int i = 0; i < 4; i++) {
+        Board board;
+        set_fen(&board, fens[i]);
+        EvalTrace trace;
+        trace_evaluate(&board, &trace);
+        
+        int white_score = evaluate(&board) * (board.side_to_move == WHITE ? 1 : -1);
+        assert(trace.total == white_score);
+        assert(trace.terms[EVAL_MATERIAL] == evaluate_material(&board));
+        assert(trace.terms[EVAL_PIECE_SQUARE] == evaluate_piece_square(&board));
+        assert(trace.mobility[WHITE] - trace.mobility[BLACK] == evaluate_mobility(&board));
+        assert(trace.terms[EVAL_PAWNS] == evaluate_pawn_structure(&board));
+        assert(trace.terms[EVAL_KING_SAFETY] == evaluate_king_safety(&board));
+        assert(trace.phase == get_game_phase(&board));
+    }
+    
+    // Symmetric position: both sides get the same per-side values
+    Board board;
+    set_fen(&board, fens[0]);
+    EvalTrace trace;
+    trace_evaluate(&board, &trace);
+    assert(trace.material[WHITE] == trace.material[BLACK]);
+    assert(trace.material[WHITE] == 8 * 100 + 2 * 320 + 2 * 330 + 2 * 500 + 900);
+    assert(trace.pst_mg[WHITE] == trace.pst_mg[BLACK]);
+    assert(trace.pst_eg[WHITE] == trace.pst_eg[BLACK]);
+    assert(trace.mobility[WHITE] == 20 && trace.mobility[BLACK] == 20);
+    
+    // Doubled, isolated pawns on the a-file for White only
+    set_fen(&board, "4k3/pp6/8/8/8/P7/P7/4K3 w - - 0 1");
+    trace_evaluate(&board, &trace);
+    assert(trace.pawns[WHITE] == eval_params.doubled_pawn + eval_params.isolated_pawn);
+    assert(trace.pawns[BLACK] == 0);
+    assert(trace.king_safety[WHITE] == eval_params.king_open_file);
+}
+
+void test_evaluate_window() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    const char* fens[] = {
+        "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 4 4",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "4k3/7p/8/8/8/8/8/QQ2K3 w - - 0 1"
+    };
+    
+    for (int i = 0; i < 3; i++) {
+        Board board;
+        set_fen(&board, fens[i]);
+        int score = evaluate(&board);
+        
+        // Inside the window the result is exact
+        assert(evaluate_window(&board, score - 1, score + 1) == score);
+        assert(evaluate_window(&board, -INFINITE, INFINITE) == score);
+        
+        // Far outside, the lazy result is on the same side of the window as the full score
+        int low = score - 1000, high = score + 1000;
+        assert(evaluate_window(&board, low - 10, low) >= low);
+        assert(evaluate_window(&board, high, high + 10) <= high);
+    }
+    
+    // With a zero margin mobility is skipped whenever the partial score is outside
+    EvalParams params = eval_params;
+    params.lazy_margin = 0;
+    set_eval_params(&params);
+    Board board;
+    set_fen(&board, fens[2]);
+    int partial = evaluate_material(&board) + evaluate_piece_square(&board) +
+                  evaluate_pawn_structure(&board) + evaluate_king_safety(&board);
+    assert(evaluate_window(&board, partial - 100, partial - 50) == partial);
+    assert(evaluate(&board) != partial);
+    
+    // The scale factor is the one of the side favoured after mobility: here the bishop outmoves
+    // the rook by enough to turn the score White's way, and a lone bishop cannot win
+    params.lazy_margin = 150;
+    params.mobility = 256 * 100;
+    set_eval_params(&params);
+    set_fen(&board, "6kr/8/8/8/3B4/8/8/2K5 w - - 0 1");
+    partial = evaluate_material(&board) + evaluate_piece_square(&board) +
+              evaluate_pawn_structure(&board) + evaluate_king_safety(&board);
+    assert(partial < 0 && partial + evaluate_mobility(&board) * 100 > 0);
+    assert(evaluate(&board) == 0);
+    assert(evaluate_window(&board, -INFINITE, INFINITE) == 0);
+    init_evaluation();
+}
+
+static const char* cache_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 4 4",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+};
+
+void test_eval_cache() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Uncached reference scores
+    init_eval_cache(0);
+    assert(eval_cache_entries() == 0);
+    int expected[4];
+    for (int i = 0; i < 4; i++) {
+        Board board;
+        set_fen(&board, cache_fens[i]);
+        expected[i] = evaluate(&board);
+    }
+    
+    // 1 MB holds 2^17 entries; 3 MB rounds down to 2^18
+    assert(init_eval_cache(3));
+    assert(eval_cache_entries() == (1 << 18));
+    assert(init_eval_cache(1));
+    assert(eval_cache_entries() == (1 << 17));
+    
+    reset_eval_cache_stats();
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < 4; i++) {
+            Board board;
+            set_fen(&board, cache_fens[i]);
+            assert(evaluate(&board) == expected[i]);
+            assert(evaluate_window(&board, -INFINITE, INFINITE) == expected[i]);
+        }
+    }
+    EvalCacheStats stats;
+    get_eval_cache_stats(&stats);
+    assert(stats.probes == 16);
+    assert(stats.hits == 12);
+    
+    // New parameters invalidate the cached scores
+    EvalParams params = eval_params;
+    params.material[PAWN] = 150;
+    set_eval_params(&params);
+    Board board;
+    set_fen(&board, "4k3/8/8/8/8/8/PP6/4K3 w - - 0 1");
+    init_evaluation();
+    int before = evaluate(&board);
+    assert(evaluate(&board) == before);
+    set_eval_params(&params);
+    assert(evaluate(&board) == before + 100);
+    init_evaluation();
+    assert(evaluate(&board) == before);
+    
+    free_eval_cache();
+}
+
+static int cache_expected[4];
+static int cache_thread_failures;
+
+static void* evaluate_repeatedly(void* arg) {
+    (void)arg;
+    int failures = 0;
+    for (int pass = 0; pass < 500; pass++) {
+        for (int i = 0; i < 4; i++) {
+            Board board;
+            set_fen(&board, cache_fens[i]);
+            if (evaluate(&board) != cache_expected[i]) failures++;
+            if (evaluate_window(&board, -INFINITE, INFINITE) != cache_expected[i]) failures++;
+        }
+        
+        // Periodic clears race with the other threads' stores
+        if (pass % 50 == 0) clear_eval_cache();
+    }
+    __atomic_add_fetch(&cache_thread_failures, failures, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+void test_eval_cache_threads() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    init_eval_cache(0);
+    for (int i = 0; i < 4; i++) {
+        Board board;
+        set_fen(&board, cache_fens[i]);
+        cache_expected[i] = evaluate(&board);
+    }
+    
+    // Four threads share one cache and keep rewriting the same entries
+    assert(init_eval_cache(1));
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, evaluate_repeatedly, NULL);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(cache_thread_failures == 0);
+    free_eval_cache();
+}
+
 int main() {
     printf("Running evaluation tests...\n");
     
@@ -220,6 +488,12 @@ int main() {
     test_full_evaluation();
     test_evaluation_symmetry();
     test_evaluation_consistency();
+    test_combined_tables();
+    test_eval_params_file();
+    test_trace_evaluate();
+    test_evaluate_window();
+    test_eval_cache();
+    test_eval_cache_threads();
     
     printf("All tests passed.\n");
     return 0;
@@ -0,0 +1,155 @@
+// test_material.c
+// Test suite for material.c and the incremental material key
+
+#include "../src/material.h"
+#include "../src/endgame.h"
+#include "../src/evaluation.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include "../src/movegen.h"
+#include <stdio.h>
+#include <assert.h>
+
+void test_material_key_counts() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    init_board(&board);
+    assert(board.material_key == compute_material_key(&board));
+    assert(material_count(board.material_key, WHITE, PAWN) == 8);
+    assert(material_count(board.material_key, BLACK, KNIGHT) == 2);
+    assert(material_count(board.material_key, WHITE, QUEEN) == 1);
+    
+    // Kings are not counted
+    set_fen(&board, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    assert(board.material_key == 0);
+}
+
+// Walks every legal move to the given depth, checking the incremental key on the way
+static void walk_keys(Board* board, int depth) {
+    assert(board->material_key == compute_material_key(board));
+    if (depth == 0) return;
+    
+    MoveList list;
+    generate_moves(board, &list);
+    for (int i = 0; i < list.count; i++) {
+        uint64_t key = board->material_key;
+        if (!make_move_if_legal(board, list.moves[i])) continue;
+        walk_keys(board, depth - 1);
+        unmake_move(board, list.moves[i]);
+        assert(board->material_key == key);
+    }
+}
+
+void test_material_key_incremental() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Captures, promotions (with capture), en passant and castling
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1"
+    };
+    
+    for (int i = 0; i < 3; i++) {
+        Board board;
+        set_fen(&board, fens[i]);
+        walk_keys(&board, 3);
+    }
+    
+    // En passant removes a pawn of the side not to move
+    Board board;
+    set_fen(&board, fens[2]);
+    make_move(&board, encode_move(E4, D3, EN_PASSANT));
+    assert(material_count(board.material_key, WHITE, PAWN) == 0);
+    assert(material_count(board.material_key, BLACK, PAWN) == 1);
+    
+    // Promotion swaps a pawn for the new piece
+    set_fen(&board, fens[1]);
+    make_move(&board, encode_move(H2, H1, PROMOTION_ROOK));
+    assert(material_count(board.material_key, BLACK, PAWN) == 2);
+    assert(material_count(board.material_key, BLACK, ROOK) == 1);
+    assert(material_count(board.material_key, WHITE, KNIGHT) == 1);
+}
+
+void test_probe_material() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    clear_material_table();
+    
+    Board board;
+    init_board(&board);
+    const MaterialEntry* entry = probe_material(&board);
+    assert(entry->key == board.material_key);
+    assert(entry->material == evaluate_material(&board));
+    assert(entry->phase == get_game_phase(&board));
+    assert(entry->endgame == NULL);
+    assert(material_scale(entry, &board, WHITE) == SCALE_NORMAL);
+    
+    // The entry follows the parameters
+    EvalParams params = eval_params;
+    params.material[PAWN] = 150;
+    set_eval_params(&params);
+    set_fen(&board, "4k3/8/8/8/8/8/PP6/4K3 w - - 0 1");
+    assert(probe_material(&board)->material == 300);
+    init_evaluation();
+    assert(probe_material(&board)->material == 200);
+}
+
+void test_endgame_classification() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    Board board;
+    set_fen(&board, "8/8/8/4k3/8/8/8/KBN5 w - - 0 1");
+    const MaterialEntry* entry = probe_material(&board);
+    assert(entry->endgame == evaluate_kbnk && entry->strong == WHITE);
+    
+    set_fen(&board, "8/8/8/4k3/8/8/4p3/K6R w - - 0 1");
+    entry = probe_material(&board);
+    assert(entry->endgame == evaluate_krkp && entry->strong == WHITE);
+    
+    set_fen(&board, "8/8/8/4k3/8/8/4p3/K7 w - - 0 1");
+    entry = probe_material(&board);
+    assert(entry->endgame == evaluate_kpk && entry->strong == BLACK);
+    
+    set_fen(&board, "8/8/8/4k3/8/8/8/KQ6 w - - 0 1");
+    entry = probe_material(&board);
+    assert(entry->endgame == evaluate_kxk && entry->strong == WHITE);
+    
+    // Two knights cannot force mate: no evaluator, drawn scale
+    set_fen(&board, "8/8/8/4k3/8/8/8/KNN5 w - - 0 1");
+    entry = probe_material(&board);
+    assert(entry->endgame == NULL);
+    assert(material_scale(entry, &board, WHITE) == SCALE_DRAW);
+    
+    // Rook against minor without pawns is hard to win
+    set_fen(&board, "8/8/8/4k3/8/3b4/8/KR6 w - - 0 1");
+    entry = probe_material(&board);
+    assert(entry->endgame == NULL);
+    assert(material_scale(entry, &board, WHITE) < SCALE_NORMAL);
+    assert(material_scale(entry, &board, BLACK) == SCALE_DRAW);
+    
+    // Opposite-colored bishops
+    set_fen(&board, "8/5k2/3b4/3p4/3P4/2PB4/5K2/8 w - - 0 1");
+    entry = probe_material(&board);
+    assert(material_scale(entry, &board, WHITE) < SCALE_NORMAL);
+}
+
+int main() {
+    printf("Running material tests...\n");
+    
+    test_material_key_counts();
+    test_material_key_incremental();
+    test_probe_material();
+    test_endgame_classification();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
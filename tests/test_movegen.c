@@ -197,7 +197,7 @@ void test_move_ordering() {
     generate_moves(&board, &list);
     
     Move hash_move = encode_move(E2, E4, NORMAL);
-    order_moves(&board, &list, hash_move, 0);
+    order_moves(&board, &list, hash_move, NULL);
     
     // Hash move should be first
     assert(list.moves[0] == hash_move);
@@ -222,6 +222,59 @@ void test_scored_move_list() {
     assert(list.moves[2].score == 50);
 }
 
+void test_has_legal_move() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    init_board(&board);
+    assert(has_legal_move(&board) == true);
+    
+    // Checkmate
+    set_fen(&board, "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+    assert(has_legal_move(&board) == false);
+    
+    // Stalemate
+    set_fen(&board, "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+    assert(has_legal_move(&board) == false);
+    
+    // Only a pawn can move
+    set_fen(&board, "7k/5Q2/6K1/8/8/8/p7/8 b - - 0 1");
+    assert(has_legal_move(&board) == true);
+}
+
+void test_gives_check_matches_make_move() {
+    init_bitboards();
+    init_zobrist();
+    
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/8/8/k2pP2R/8/8/8/4K3 w - d6 0 1",
+        "3k4/1P6/8/8/8/8/8/R3K2R w KQ - 0 1"
+    };
+    
+    for (int f = 0; f < 6; f++) {
+        Board board;
+        set_fen(&board, fens[f]);
+        
+        CheckInfo info;
+        init_check_info(&board, &info);
+        
+        MoveList list;
+        generate_moves(&board, &list);
+        
+        for (int i = 0; i < list.count; i++) {
+            Board temp;
+            copy_board(&temp, &board);
+            make_move(&temp, list.moves[i]);
+            assert(gives_check(&board, &info, list.moves[i]) == is_in_check(&temp, temp.side_to_move));
+        }
+    }
+}
+
 int main() {
     printf("Running movegen tests...\n");
     
@@ -236,6 +289,8 @@ int main() {
     test_en_passant_generation();
     test_pawn_promotion();
     test_generate_captures_only();
+    test_has_legal_move();
+    test_gives_check_matches_make_move();
     test_mvv_lva_scoring();
     test_move_ordering();
     test_scored_move_list();
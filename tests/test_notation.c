@@ -142,6 +142,81 @@ void test_algebraic_parsing() {
     assert(piece_on(&board, move_from(parsed)) == KNIGHT);
 }
 
+void test_algebraic_parsing_forms() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    // Two knights can reach d2
+    set_fen(&board, "4k3/8/8/8/8/5N2/8/1N2K3 w - - 0 1");
+    assert(algebraic_to_move(&board, "Nbd2") == encode_move(B1, D2, NORMAL));
+    assert(algebraic_to_move(&board, "Nfd2") == encode_move(F3, D2, NORMAL));
+    assert(algebraic_to_move(&board, "Nd2") == 0);  // Ambiguous
+    
+    // Pinned knight: the only legal knight move to d2 needs no disambiguation
+    set_fen(&board, "4k3/8/8/3b4/8/5N2/8/1N5K w - - 0 1");
+    assert(algebraic_to_move(&board, "Nd2") == encode_move(B1, D2, NORMAL));
+    
+    // Check suffixes, captures, en passant, promotion with capture
+    set_fen(&board, "3r3k/4P3/8/3pP3/8/8/8/4K3 w - d6 0 1");
+    assert(algebraic_to_move(&board, "exd6") == encode_move(E5, D6, EN_PASSANT));
+    assert(algebraic_to_move(&board, "exd8=Q+") == encode_move(E7, D8, PROMOTION_QUEEN));
+    assert(algebraic_to_move(&board, "e8=N") == encode_move(E7, E8, PROMOTION_KNIGHT));
+    assert(algebraic_to_move(&board, "e8") == 0);  // Promotion piece is required
+    
+    // Castling in both spellings, coordinate notation fallback
+    set_fen(&board, "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+    assert(algebraic_to_move(&board, "O-O") == encode_move(E1, G1, CASTLE_KINGSIDE));
+    assert(algebraic_to_move(&board, "0-0-0") == encode_move(E1, C1, CASTLE_QUEENSIDE));
+    assert(algebraic_to_move(&board, "a1a8") == encode_move(A1, A8, CAPTURE));
+    assert(algebraic_to_move(&board, "Zz9") == 0);
+}
+
+// Round-trip every legal move of random playouts through SAN
+void test_algebraic_round_trip_fuzz() {
+    init_bitboards();
+    init_zobrist();
+    
+    const char* starts[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+    };
+    
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    int checked = 0;
+    
+    for (int game = 0; game < 24; game++) {
+        Board board;
+        set_fen(&board, starts[game % 4]);
+        
+        for (int ply = 0; ply < 80; ply++) {
+            MoveList list;
+            generate_moves(&board, &list);
+            if (list.count == 0) break;
+            
+            for (int i = 0; i < list.count; i++) {
+                char str[16];
+                move_to_algebraic(&board, list.moves[i], str);
+                assert(algebraic_to_move(&board, str) == list.moves[i]);
+                checked++;
+            }
+            
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            make_move(&board, list.moves[state % list.count]);
+            
+            if (board.history_index >= MAX_PLY - 1) {
+                compact_history(&board);
+            }
+        }
+    }
+    
+    assert(checked > 10000);
+}
+
 void test_move_list_printing() {
     init_bitboards();
     init_zobrist();
@@ -156,6 +231,64 @@ void test_move_list_printing() {
     print_move_list(&board, &list);
 }
 
+void test_algebraic_check_annotations() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    char str[16];
+    
+    // Back rank mate
+    set_fen(&board, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+    move_to_algebraic(&board, encode_move(A1, A8, NORMAL), str);
+    assert(strcmp(str, "Ra8#") == 0);
+    
+    // Plain check
+    move_to_algebraic(&board, encode_move(A1, A4, NORMAL), str);
+    assert(strcmp(str, "Ra4") == 0);
+    set_fen(&board, "6k1/5p1p/8/8/8/8/8/R5K1 w - - 0 1");
+    move_to_algebraic(&board, encode_move(A1, A8, NORMAL), str);
+    assert(strcmp(str, "Ra8+") == 0);
+    
+    // Discovered check
+    set_fen(&board, "4k3/8/8/8/4N3/8/8/K3R3 w - - 0 1");
+    move_to_algebraic(&board, encode_move(E4, C3, NORMAL), str);
+    assert(strcmp(str, "Nc3+") == 0);
+    
+    // Castling with check
+    set_fen(&board, "5k2/8/8/8/8/8/8/4K2R w K - 0 1");
+    move_to_algebraic(&board, encode_move(E1, G1, CASTLE_KINGSIDE), str);
+    assert(strcmp(str, "O-O+") == 0);
+}
+
+void test_algebraic_disambiguation_forms() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    char str[16];
+    
+    // Knights on different files: file suffices
+    set_fen(&board, "4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1");
+    move_to_algebraic(&board, encode_move(B1, D2, NORMAL), str);
+    assert(strcmp(str, "Nbd2") == 0);
+    
+    // Rooks on the same file: rank
+    set_fen(&board, "4k3/R7/8/8/8/8/8/R3K3 w - - 0 1");
+    move_to_algebraic(&board, encode_move(A1, A4, NORMAL), str);
+    assert(strcmp(str, "R1a4") == 0);
+    
+    // Three queens: file and rank
+    set_fen(&board, "8/7k/8/8/8/Q7/8/Q1Q3K1 w - - 0 1");
+    move_to_algebraic(&board, encode_move(A1, B2, NORMAL), str);
+    assert(strcmp(str, "Qa1b2") == 0);
+    
+    // A pinned knight does not count as a second mover
+    set_fen(&board, "4k3/4r3/8/8/8/8/4N3/2N1K3 w - - 0 1");
+    move_to_algebraic(&board, encode_move(C1, D3, NORMAL), str);
+    assert(strcmp(str, "Nd3") == 0);
+}
+
 int main() {
     printf("Running notation tests...\n");
     
@@ -166,7 +299,11 @@ int main() {
     test_algebraic_castling();
     test_algebraic_promotion();
     test_algebraic_disambiguation();
+    test_algebraic_check_annotations();
+    test_algebraic_disambiguation_forms();
     test_algebraic_parsing();
+    test_algebraic_parsing_forms();
+    test_algebraic_round_trip_fuzz();
     test_move_list_printing();
     
     printf("All tests passed.\n");
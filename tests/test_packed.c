@@ -0,0 +1,221 @@
+// test_packed.c
+// Test suite for packed.c
+
+#include "../src/packed.h"
+#include "../src/pgn.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE "/tmp/zugzwang_test_packed.bin"
+
+static PgnGame game;
+
+static void assert_round_trip(const char* fen) {
+    Board board, decoded;
+    set_fen(&board, fen);
+    
+    PackedPosition packed;
+    pack_position(&board, &packed);
+    memset(&decoded, 0xAB, sizeof(Board));
+    assert(unpack_position(&packed, &decoded));
+    
+    char out[128];
+    get_fen(&decoded, out);
+    assert(strcmp(out, fen) == 0);
+    assert(decoded.hash == board.hash);
+    assert(decoded.all_occupied == board.all_occupied);
+    assert(decoded.occupied[WHITE] == board.occupied[WHITE]);
+    assert(decoded.history_index == 1);
+    assert(decoded.undo_index == 0);
+}
+
+void test_position_round_trip() {
+    init_bitboards();
+    init_zobrist();
+    
+    assert(sizeof(PackedPosition) == 32);
+    
+    assert_round_trip(START_FEN);
+    assert_round_trip("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    assert_round_trip("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+    assert_round_trip("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - - 37 112");
+    assert_round_trip("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+}
+
+void test_position_fields() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    set_fen(&board, "r3k2r/8/8/8/4Pp2/8/8/R3K2R b Kq e3 12 40");
+    
+    PackedPosition packed;
+    pack_position(&board, &packed);
+    assert(packed.state == (BLACK | (WHITE_KINGSIDE | BLACK_QUEENSIDE) << 1));
+    assert(packed.en_passant_square == E3);
+    assert(packed.halfmove_clock == 12);
+    assert(packed.fullmove_number == 40);
+    assert(packed.result == ONGOING);
+    assert(packed.score == PACKED_NO_SCORE);
+    
+    // Invalid piece code is rejected
+    packed.pieces[0] |= 0x7;
+    Board decoded;
+    assert(!unpack_position(&packed, &decoded));
+}
+
+void test_positions_file() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Write the positions of a short game in two bulk calls
+    const Move moves[4] = {
+        encode_move(E2, E4, NORMAL), encode_move(E7, E5, NORMAL),
+        encode_move(G1, F3, NORMAL), encode_move(B8, C6, NORMAL)
+    };
+    PackedPosition positions[5];
+    Board board;
+    init_board(&board);
+    for (int i = 0; i < 5; i++) {
+        pack_position(&board, &positions[i]);
+        positions[i].score = (int16_t)(i * 10);
+        if (i < 4) make_move(&board, moves[i]);
+    }
+    
+    PackedWriter writer;
+    assert(packed_writer_open(&writer, TEST_FILE, PACKED_POSITIONS));
+    assert(packed_write_positions(&writer, positions, 2));
+    assert(packed_write_positions(&writer, positions + 2, 3));
+    assert(!packed_write_game(&writer, &positions[0], moves, 4));
+    assert(packed_writer_close(&writer));
+    
+    // Buffered reader
+    PackedReader reader;
+    PackedPosition read[8];
+    assert(packed_reader_open(&reader, TEST_FILE));
+    assert(reader.kind == PACKED_POSITIONS);
+    assert(reader.count == 5);
+    assert(packed_read_positions(&reader, read, 8) == 5);
+    assert(memcmp(read, positions, sizeof(positions)) == 0);
+    assert(packed_read_positions(&reader, read, 8) == 0);
+    packed_reader_close(&reader);
+    
+    // Memory map
+    PackedMap map;
+    assert(packed_map_open(&map, TEST_FILE));
+    assert(map.count == 5);
+    const PackedPosition* mapped = packed_map_positions(&map);
+    assert(mapped != NULL);
+    assert(mapped[4].score == 40);
+    
+    Board decoded;
+    assert(unpack_position(&mapped[4], &decoded));
+    assert(decoded.hash == board.hash);
+    packed_map_close(&map);
+    
+    remove(TEST_FILE);
+}
+
+void test_games_file_from_pgn() {
+    init_bitboards();
+    init_zobrist();
+    
+    long long count = packed_convert_pgn("tests/fixtures/games.pgn", TEST_FILE, PACKED_GAMES);
+    assert(count == 63);
+    
+    PgnReader pgn;
+    assert(pgn_open(&pgn, "tests/fixtures/games.pgn"));
+    
+    PackedMap map;
+    assert(packed_map_open(&map, TEST_FILE));
+    assert(map.kind == PACKED_GAMES);
+    assert(map.count == 63);
+    
+    PackedReader reader;
+    assert(packed_reader_open(&reader, TEST_FILE));
+    
+    static Move moves[PGN_MAX_PLIES];
+    PackedPosition start;
+    PackedGameView view;
+    int games = 0;
+    
+    // Every game replays to the same final position as the PGN reader
+    while (pgn_read_game(&pgn, &game)) {
+        assert(packed_map_next_game(&map, &view));
+        assert(view.move_count == game.move_count);
+        assert(view.start->result == game.result);
+        assert(memcmp(view.moves, game.moves, game.move_count * sizeof(Move)) == 0);
+        
+        int read = packed_read_game(&reader, &start, moves, PGN_MAX_PLIES);
+        assert(read == game.move_count);
+        assert(memcmp(&start, view.start, sizeof(PackedPosition)) == 0);
+        
+        Board board;
+        assert(unpack_position(view.start, &board));
+        for (int i = 0; i < view.move_count; i++) {
+            make_move(&board, view.moves[i]);
+            if (board.history_index >= MAX_PLY - 1) {
+                compact_history(&board);
+            }
+        }
+        assert(board.hash == game.board.hash);
+        games++;
+    }
+    assert(games == 63);
+    assert(!packed_map_next_game(&map, &view));
+    assert(packed_read_game(&reader, &start, moves, PGN_MAX_PLIES) == -1);
+    
+    packed_reader_close(&reader);
+    packed_map_close(&map);
+    pgn_close(&pgn);
+    remove(TEST_FILE);
+}
+
+void test_convert_fen() {
+    init_bitboards();
+    init_zobrist();
+    
+    const char* fen_path = "/tmp/zugzwang_test_packed.fen";
+    FILE* file = fopen(fen_path, "w");
+    assert(file != NULL);
+    fprintf(file, "%s\n\n%s\r\n", START_FEN, "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1");
+    fclose(file);
+    
+    assert(packed_convert_fen(fen_path, TEST_FILE) == 2);
+    
+    PackedMap map;
+    assert(packed_map_open(&map, TEST_FILE));
+    assert(map.count == 2);
+    
+    Board board;
+    char fen[128];
+    assert(unpack_position(&packed_map_positions(&map)[1], &board));
+    get_fen(&board, fen);
+    assert(strcmp(fen, "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1") == 0);
+    packed_map_close(&map);
+    
+    // Not a packed file
+    assert(!packed_map_open(&map, fen_path));
+    
+    remove(fen_path);
+    remove(TEST_FILE);
+}
+
+int main() {
+    printf("Running packed tests...\n");
+    
+    test_position_round_trip();
+    test_position_fields();
+    test_positions_file();
+    test_games_file_from_pgn();
+    test_convert_fen();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,146 @@
+// test_pgn.c
+// Test suite for pgn.c
+
+#include "../src/pgn.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include "../src/movegen.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static PgnGame game;
+
+void test_pgn_memory_game() {
+    init_bitboards();
+    init_zobrist();
+    
+    const char* pgn =
+        "[Event \"Test\"]\n"
+        "[White \"A \\\"quoted\\\" name\"]\n"
+        "[Result \"0-1\"]\n"
+        "\n"
+        "1. f3 e5 {weak} 2. g4?? (2. e4 Nf6) 2... Qh4# $4 0-1\n";
+    
+    PgnReader reader;
+    pgn_open_memory(&reader, pgn, strlen(pgn));
+    
+    assert(pgn_read_game(&reader, &game));
+    assert(game.tag_count == 3);
+    assert(strcmp(pgn_tag(&game, "Event"), "Test") == 0);
+    assert(strcmp(pgn_tag(&game, "White"), "A \"quoted\" name") == 0);
+    assert(pgn_tag(&game, "Date") == NULL);
+    
+    assert(!game.error);
+    assert(game.result == BLACK_WINS);
+    assert(game.move_count == 4);
+    assert(game.moves[3] == encode_move(D8, H4, NORMAL));
+    
+    // Fool's mate: no legal replies
+    MoveList list;
+    generate_moves(&game.board, &list);
+    assert(list.count == 0);
+    assert(is_in_check(&game.board, WHITE));
+    
+    assert(!pgn_read_game(&reader, &game));
+    pgn_close(&reader);
+}
+
+void test_pgn_fen_and_errors() {
+    init_bitboards();
+    init_zobrist();
+    
+    const char* pgn =
+        "[FEN \"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\"]\n"
+        "1. e4 Kd7 2. e5 *\n"
+        "\n"
+        "[Event \"Broken\"]\n"
+        "1. e4 e5 2. Ke3 Nf6 3. d4 1-0\n"
+        "\n"
+        "1. e4 f5 2. Qh5 a6 3. Qe8 1-0\n"
+        "\n"
+        "1. e4 e5 2. Qh5 Nc6 3. Qxe5+ Nge7 4. Bc4 Nd5 1-0\n"
+        "\n"
+        "1. d4 d5 1/2-1/2\n";
+    
+    PgnReader reader;
+    pgn_open_memory(&reader, pgn, strlen(pgn));
+    
+    assert(pgn_read_game(&reader, &game));
+    assert(strcmp(game.start_fen, "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1") == 0);
+    assert(game.move_count == 3);
+    assert(game.result == ONGOING);
+    assert(piece_on(&game.board, E5) == PAWN);
+    
+    // Illegal move: keeps the moves before it and finishes the game
+    assert(pgn_read_game(&reader, &game));
+    assert(game.error);
+    assert(game.move_count == 2);
+    assert(game.result == WHITE_WINS);
+    
+    // A single candidate still has to be legal: ignoring a check, moving a pinned knight
+    assert(pgn_read_game(&reader, &game));
+    assert(game.error);
+    assert(game.move_count == 3);
+    assert(pgn_read_game(&reader, &game));
+    assert(game.error);
+    assert(game.move_count == 7);
+    
+    // Game without tags
+    assert(pgn_read_game(&reader, &game));
+    assert(!game.error);
+    assert(game.tag_count == 0);
+    assert(game.move_count == 2);
+    assert(game.result == DRAW);
+    
+    assert(!pgn_read_game(&reader, &game));
+    pgn_close(&reader);
+}
+
+void test_pgn_fixture_file() {
+    init_bitboards();
+    init_zobrist();
+    
+    PgnReader reader;
+    assert(pgn_open(&reader, "tests/fixtures/games.pgn"));
+    
+    int games = 0;
+    int moves = 0;
+    while (pgn_read_game(&reader, &game)) {
+        assert(!game.error);
+        
+        // Every game ends where its result says it does
+        if (game.result == WHITE_WINS || game.result == BLACK_WINS) {
+            MoveList list;
+            generate_moves(&game.board, &list);
+            assert(list.count == 0);
+            assert(is_in_check(&game.board, game.board.side_to_move));
+        }
+        
+        if (games == 0) {
+            assert(strcmp(pgn_tag(&game, "White"), "Paul Morphy") == 0);
+            assert(game.move_count == 33);
+        }
+        
+        games++;
+        moves += game.move_count;
+    }
+    pgn_close(&reader);
+    
+    assert(games == 63);
+    assert(moves > 10000);
+}
+
+int main() {
+    printf("Running pgn tests...\n");
+    
+    test_pgn_memory_game();
+    test_pgn_fen_and_errors();
+    test_pgn_fixture_file();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
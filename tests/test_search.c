@@ -31,34 +31,50 @@ void test_init_search() {
 
 void test_clear_heuristics() {
     // Set some values
-    killer_moves[0][0] = encode_move(E2, E4, NORMAL);
-    killer_moves[0][1] = encode_move(D2, D4, NORMAL);
     history_table[WHITE][E2][E4] = 100;
     
     clear_heuristics();
     
-    assert(killer_moves[0][0] == 0);
-    assert(killer_moves[0][1] == 0);
     assert(history_table[WHITE][E2][E4] == 0);
 }
 
+void test_search_stack() {
+    SearchStack stack[SEARCH_STACK_SIZE];
+    stack[5].killers[0] = encode_move(E2, E4, NORMAL);
+    stack[5].in_check = true;
+    
+    init_search_stack(stack);
+    
+    for (int i = 0; i < SEARCH_STACK_SIZE; i++) {
+        assert(stack[i].killers[0] == 0 && stack[i].killers[1] == 0);
+        assert(stack[i].current_move == 0 && !stack[i].in_check);
+    }
+}
+
 void test_update_killers() {
-    clear_heuristics();
+    SearchStack stack[SEARCH_STACK_SIZE];
+    init_search_stack(stack);
+    SearchStack* ss = stack + 1;
     
     Move move1 = encode_move(E2, E4, NORMAL);
     Move move2 = encode_move(D2, D4, NORMAL);
     Move move3 = encode_move(G1, F3, NORMAL);
     
-    update_killers(move1, 0);
-    assert(killer_moves[0][0] == move1);
+    update_killers(ss, move1);
+    assert(ss->killers[0] == move1);
     
-    update_killers(move2, 0);
-    assert(killer_moves[0][0] == move2);
-    assert(killer_moves[0][1] == move1);
+    update_killers(ss, move2);
+    assert(ss->killers[0] == move2);
+    assert(ss->killers[1] == move1);
     
-    update_killers(move3, 0);
-    assert(killer_moves[0][0] == move3);
-    assert(killer_moves[0][1] == move2);
+    update_killers(ss, move3);
+    assert(ss->killers[0] == move3);
+    assert(ss->killers[1] == move2);
+    
+    // Other plies keep their own
+    update_killers(ss, move3);
+    assert(ss->killers[1] == move2);
+    assert((ss + 1)->killers[0] == 0);
 }
 
 void test_update_history() {
@@ -66,11 +82,74 @@ void test_update_history() {
     
     Move move = encode_move(E2, E4, NORMAL);
     
-    update_history(move, WHITE, 5);
-    assert(history_table[WHITE][E2][E4] == 25);  // depth^2 = 5^2 = 25
+    // Gravity: the full bonus from zero, less as the entry nears the bound
+    update_history(move, WHITE, history_bonus(3));
+    assert(history_table[WHITE][E2][E4] == 32 * 9);
+    update_history(move, WHITE, 288);
+    assert(history_table[WHITE][E2][E4] == 288 + 288 - 288 * 288 / HISTORY_MAX);
+    
+    // Bounded on both sides however often it is updated
+    for (int i = 0; i < 1000; i++) {
+        update_history(move, WHITE, history_bonus(20));
+        assert(history_table[WHITE][E2][E4] <= HISTORY_MAX);
+    }
+    assert(history_table[WHITE][E2][E4] > HISTORY_MAX * 9 / 10);
+    for (int i = 0; i < 1000; i++) {
+        update_history(move, WHITE, -history_bonus(20));
+        assert(history_table[WHITE][E2][E4] >= -HISTORY_MAX);
+    }
+    assert(history_table[WHITE][E2][E4] < -HISTORY_MAX * 9 / 10);
+    assert(history_bonus(100) == HISTORY_MAX / 2);
+}
+
+void test_update_quiet_stats() {
+    init_bitboards();
+    init_zobrist();
+    clear_heuristics();
+    
+    // After 1. e4, Black's Nf6 refuted it where d6 and c6 had failed
+    Board board;
+    init_board(&board);
+    SearchStack stack[SEARCH_STACK_SIZE];
+    init_search_stack(stack);
+    SearchStack* ss = stack + 1;
+    Move e4 = encode_move(E2, E4, NORMAL);
+    ss->current_move = e4;
+    ss->moved_piece = WHITE * 6 + PAWN;
+    ss->continuation = &continuation_history[ss->moved_piece][E4];
+    make_move(&board, e4);
+    
+    Move nf6 = encode_move(G8, F6, NORMAL);
+    Move failed[2] = { encode_move(D7, D6, NORMAL), encode_move(C7, C6, NORMAL) };
+    update_quiet_stats(&board, ss + 1, 1, nf6, failed, 2, 4);
+    
+    int bonus = history_bonus(4);
+    assert((ss + 1)->killers[0] == nf6);
+    assert(counter_moves[WHITE * 6 + PAWN][E4] == nf6);
+    assert(history_table[BLACK][G8][F6] == bonus);
+    assert(history_table[BLACK][D7][D6] == -bonus && history_table[BLACK][C7][C6] == -bonus);
+    assert(continuation_history[WHITE * 6 + PAWN][E4][BLACK * 6 + KNIGHT][F6] == bonus);
+    assert(continuation_history[WHITE * 6 + PAWN][E4][BLACK * 6 + PAWN][D6] == -bonus);
+    
+    // Ordering after 1. e4: the counter move first among the quiets, then by history
+    MoveList list;
+    generate_moves(&board, &list);
+    OrderContext context = {
+        .killers = (ss + 1)->killers,
+        .counter_move = counter_moves[WHITE * 6 + PAWN][E4],
+        .continuation = { ss->continuation, NULL }
+    };
+    (ss + 1)->killers[0] = 0;
+    assert(score_move(&board, nf6, 0, &context) == SCORE_COUNTER_MOVE);
+    assert(score_move(&board, failed[0], 0, &context) == -2 * bonus);
+    assert(score_move(&board, failed[0], 0, NULL) == -bonus);
+    order_moves(&board, &list, 0, &context);
+    assert(list.moves[0] == nf6);
+    assert(list.moves[list.count - 1] == failed[0] || list.moves[list.count - 1] == failed[1]);
     
-    update_history(move, WHITE, 3);
-    assert(history_table[WHITE][E2][E4] == 34);  // 25 + 9 = 34
+    clear_heuristics();
+    assert(counter_moves[WHITE * 6 + PAWN][E4] == 0);
+    assert(continuation_history[WHITE * 6 + PAWN][E4][BLACK * 6 + KNIGHT][F6] == 0);
 }
 
 void test_is_draw() {
@@ -88,17 +167,22 @@ void test_is_draw() {
     assert(is_draw(&board));
 }
 
-void test_evaluate_terminal() {
+void test_terminal_nodes() {
     init_bitboards();
     init_zobrist();
     
     Board board;
-    // Checkmate position: Black is checkmated
+    SearchInfo info;
+    init_search(&info);
+    SearchParams params = {0};
+    
+    // White is checkmated: mated at the node's ply
     set_fen(&board, "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+    assert(negamax(&board, 2, -INFINITE, INFINITE, 3, &info, &params) == -MATE_SCORE + 3);
     
-    int score = evaluate_terminal(&board, 0);
-    // Should return checkmate score
-    assert(score < -MATE_SCORE + 100);
+    // Black is stalemated
+    set_fen(&board, "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+    assert(negamax(&board, 2, -INFINITE, INFINITE, 0, &info, &params) == DRAW_SCORE);
 }
 
 void test_should_stop_search() {
@@ -142,7 +226,7 @@ void test_find_best_move_opening() {
     
     // FIX #3: Add transposition table (required for find_best_move)
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     SearchInfo info;
     SearchParams params = {0};
@@ -188,7 +272,7 @@ void test_iterative_deepening() {
     
     // FIX #4: Add transposition table (required for iterative_deepening)
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     SearchInfo info;
     SearchParams params = {0};
@@ -217,7 +301,7 @@ void test_extract_pv_empty() {
     int length;
     
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     extract_pv(&board, &tt, pv, &length);
     
@@ -235,9 +319,10 @@ void test_negamax_with_transposition_table() {
     init_board(&board);
     
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     SearchInfo info;
+    init_search(&info);
     SearchParams params = {0};
     params.use_quiescence = false;
     params.use_aspiration = false;
@@ -260,6 +345,8 @@ void test_search_consistency() {
     init_board(&board);
     
     SearchInfo info1, info2;
+    init_search(&info1);
+    init_search(&info2);
     SearchParams params = {0};
     params.use_quiescence = false;
     params.use_aspiration = false;
@@ -272,15 +359,140 @@ void test_search_consistency() {
     assert(score1 == score2);
 }
 
+void test_multi_pv() {
+    init_bitboards();
+    init_zobrist();
+    
+    Board board;
+    // White can win the queen with Rxd8; every other line is much worse
+    set_fen(&board, "3q2k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1");
+    
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    
+    SearchInfo info;
+    SearchParams params = {0};
+    params.use_quiescence = false;
+    params.multi_pv = 3;
+    params.tt = &tt;
+    
+    Move best_move = iterative_deepening(&board, 2, &info, &params);
+    
+    assert(info.pv_line_count == 3);
+    assert(best_move == encode_move(D1, D8, CAPTURE));
+    assert(info.pv_lines[0].pv[0] == best_move);
+    
+    // Lines are distinct, sorted by score, and searched to full depth
+    for (int i = 0; i < info.pv_line_count; i++) {
+        assert(info.pv_lines[i].depth == 2);
+        assert(info.pv_lines[i].pv_length >= 1);
+        assert(is_legal(&board, info.pv_lines[i].pv[0]));
+        for (int j = 0; j < i; j++) {
+            assert(info.pv_lines[i].pv[0] != info.pv_lines[j].pv[0]);
+            assert(info.pv_lines[i].score <= info.pv_lines[j].score);
+        }
+    }
+    
+    free_tt(&tt);
+}
+
+void test_mate_scores_through_tt() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Mate in 2: 1. Ra6 bxa6 2. b7#
+    Board board;
+    set_fen(&board, "kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1");
+    
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    SearchInfo info;
+    SearchParams params = {0};
+    params.use_quiescence = true;
+    params.tt = &tt;
+    
+    Move best_move = iterative_deepening(&board, 6, &info, &params);
+    assert(best_move == encode_move(A1, A6, NORMAL));
+    assert(info.pv_lines[0].score == MATE_SCORE - 3);
+    
+    // One ply on, the entries stored a ply deeper still give the right distance
+    make_move(&board, best_move);
+    int score = negamax(&board, 5, -INFINITE, INFINITE, 0, &info, &params);
+    assert(score == -MATE_SCORE + 2);
+    assert(info.tt_cutoffs > 0);
+    
+    free_tt(&tt);
+}
+
+void test_mate_distance_pruning() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    Board board;
+    init_board(&board);
+    SearchInfo info;
+    init_search(&info);
+    SearchParams params = {0};
+    params.use_quiescence = true;
+    
+    // At ply 2 nothing scores above a mate at ply 3: a window above that returns at once
+    int score = negamax(&board, 5, MATE_SCORE - 3, MATE_SCORE - 1, 2, &info, &params);
+    assert(score == MATE_SCORE - 3);
+    assert(info.nodes_searched == 1);
+    
+    // Likewise below being mated at ply 2
+    init_search(&info);
+    score = negamax(&board, 5, -MATE_SCORE, -MATE_SCORE + 2, 2, &info, &params);
+    assert(score == -MATE_SCORE + 2);
+    assert(info.nodes_searched == 1);
+}
+
+void test_converts_won_endgame() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // King and queen against king, with one table kept through the game as in play
+    Board board;
+    set_fen(&board, "8/8/3k4/8/8/8/8/3QK3 w - - 0 1");
+    TranspositionTable tt;
+    assert(init_tt(&tt, 4));
+    SearchParams params = {0};
+    params.use_quiescence = true;
+    params.tt = &tt;
+    
+    int plies = 0;
+    MoveList list;
+    generate_moves(&board, &list);
+    while (list.count > 0 && plies < 40) {
+        assert(!is_draw(&board));
+        SearchInfo info;
+        Move move = iterative_deepening(&board, 6, &info, &params);
+        make_move(&board, move);
+        generate_moves(&board, &list);
+        plies++;
+    }
+    
+    // Mated by White within 10 moves
+    assert(list.count == 0 && is_in_check(&board, BLACK));
+    assert(plies <= 19);
+    
+    free_tt(&tt);
+}
+
 int main() {
     printf("Running search tests...\n");
     
     test_init_search();
     test_clear_heuristics();
+    test_search_stack();
     test_update_killers();
     test_update_history();
+    test_update_quiet_stats();
     test_is_draw();
-    test_evaluate_terminal();
+    test_terminal_nodes();
     test_should_stop_search();
     test_negamax_finds_mate_in_one();
     test_find_best_move_opening();
@@ -289,6 +501,10 @@ int main() {
     test_extract_pv_empty();
     test_negamax_with_transposition_table();
     test_search_consistency();
+    test_multi_pv();
+    test_mate_scores_through_tt();
+    test_mate_distance_pruning();
+    test_converts_won_endgame();
     
     printf("All tests passed.\n");
     return 0;
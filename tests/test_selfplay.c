@@ -0,0 +1,115 @@
+// test_selfplay.c
+// Test suite for selfplay.c
+
+#include "../src/selfplay.h"
+#include "../src/packed.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include <stdio.h>
+#include <assert.h>
+
+#define TEST_FILE "/tmp/zugzwang_test_selfplay.bin"
+
+static SelfPlayParams small_params(void) {
+    SelfPlayParams params;
+    init_selfplay_params(&params);
+    params.output_path = TEST_FILE;
+    params.nodes_per_move = 300;
+    params.tt_mb = 1;
+    params.random_plies = 4;
+    params.max_plies = 40;
+    params.report_ms = 0;
+    return params;
+}
+
+void test_selfplay_records() {
+    init_bitboards();
+    init_zobrist();
+    
+    SelfPlayParams params = small_params();
+    params.threads = 2;
+    params.games = 3;
+    
+    SelfPlayStats stats;
+    assert(run_selfplay(&params, &stats, NULL, NULL));
+    assert(stats.games == 3);
+    assert(stats.white_wins + stats.black_wins + stats.draws == 3);
+    assert(stats.positions > 0);
+    assert(stats.nodes > 0);
+    
+    PackedMap map;
+    assert(packed_map_open(&map, TEST_FILE));
+    assert(map.kind == PACKED_POSITIONS);
+    assert(map.count == stats.positions);
+    
+    // Every record is a labelled, scored, quiet position
+    const PackedPosition* positions = packed_map_positions(&map);
+    for (uint64_t i = 0; i < map.count; i++) {
+        Board board;
+        assert(unpack_position(&positions[i], &board));
+        assert(positions[i].result == WHITE_WINS || positions[i].result == BLACK_WINS ||
+               positions[i].result == DRAW);
+        assert(positions[i].score != PACKED_NO_SCORE);
+        assert(!is_in_check(&board, board.side_to_move));
+    }
+    packed_map_close(&map);
+    remove(TEST_FILE);
+}
+
+void test_selfplay_adjudication() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Any non-zero score for two plies ends the game
+    SelfPlayParams params = small_params();
+    params.games = 2;
+    params.resign_score = 1;
+    params.resign_plies = 2;
+    params.draw_plies = 0;
+    params.quiet_only = false;
+    
+    SelfPlayStats stats;
+    assert(run_selfplay(&params, &stats, NULL, NULL));
+    assert(stats.games == 2);
+    assert(stats.adjudicated + stats.draws >= 2);
+    assert(stats.positions <= 2 * (uint64_t)(params.max_plies - params.random_plies));
+    remove(TEST_FILE);
+}
+
+static void stop_at_first_report(const SelfPlayStats* stats, void* user_data) {
+    (void)stats;
+    *(int*)user_data += 1;
+    stop_selfplay();
+}
+
+void test_selfplay_stop() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Unlimited games, stopped from the progress callback
+    SelfPlayParams params = small_params();
+    params.report_ms = 200;
+    
+    int reports = 0;
+    SelfPlayStats stats;
+    assert(run_selfplay(&params, &stats, stop_at_first_report, &reports));
+    assert(reports >= 1);
+    
+    PackedMap map;
+    assert(packed_map_open(&map, TEST_FILE));
+    assert(map.count == stats.positions);
+    packed_map_close(&map);
+    remove(TEST_FILE);
+}
+
+int main() {
+    printf("Running selfplay tests...\n");
+    
+    test_selfplay_records();
+    test_selfplay_adjudication();
+    test_selfplay_stop();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
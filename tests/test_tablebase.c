@@ -0,0 +1,327 @@
+// test_tablebase.c
+// Test suite for tablebase.c
+
+#include "../src/tablebase.h"
+#include "../src/bitbase.h"
+#include "../src/evaluation.h"
+#include "../src/search.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include "../src/movegen.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define TB_TEST_DIR "/tmp/zugzwang_tb_test"
+
+static TbGenStats reported[8];
+static char reported_names[8][TB_SIGNATURE_LENGTH];
+static int report_count = 0;
+
+static void record_stats(const char* signature, const TbGenStats* stats) {
+    if (report_count < 8) {
+        strcpy(reported_names[report_count], signature);
+        reported[report_count] = *stats;
+        report_count++;
+    }
+}
+
+static const TbGenStats* stats_of(const char* signature) {
+    for (int i = 0; i < report_count; i++) {
+        if (strcmp(reported_names[i], signature) == 0) return &reported[i];
+    }
+    return NULL;
+}
+
+static void probe_fen(const char* fen, TbResult* result) {
+    Board board;
+    set_fen(&board, fen);
+    assert(probe_tablebase(&board, result));
+}
+
+// FEN of a three-piece position with White holding the piece
+static void piece_fen(char* fen, Square white_king, char piece, Square square, Square black_king, Color stm) {
+    char squares[64];
+    memset(squares, 0, sizeof(squares));
+    squares[white_king] = 'K';
+    squares[square] = piece;
+    squares[black_king] = 'k';
+    
+    char* out = fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            char at = squares[make_square(rank, file)];
+            if (!at) {
+                empty++;
+                continue;
+            }
+            if (empty) *out++ = (char)('0' + empty);
+            empty = 0;
+            *out++ = at;
+        }
+        if (empty) *out++ = (char)('0' + empty);
+        if (rank > 0) *out++ = '/';
+    }
+    sprintf(out, " %c - - 0 1", stm == WHITE ? 'w' : 'b');
+}
+
+
+// Tests
+
+void test_signatures() {
+    char out[TB_SIGNATURE_LENGTH];
+    assert(canonical_signature("KQvK", out) && strcmp(out, "KQvK") == 0);
+    assert(canonical_signature("KvKQ", out) && strcmp(out, "KQvK") == 0);
+    assert(canonical_signature("KPvKR", out) && strcmp(out, "KRvKP") == 0);
+    assert(canonical_signature("KNQvK", out) && strcmp(out, "KQNvK") == 0);
+    assert(!canonical_signature("KQK", out));
+    assert(!canonical_signature("KQvKX", out));
+    assert(!canonical_signature("KQRBNvK", out));
+    
+    // 3 pieces: KQvK, KRvK and KPvK; the minor pieces cannot mate
+    static char all[TB_MAX_TABLES][TB_SIGNATURE_LENGTH];
+    int count = tablebase_signatures(3, all, TB_MAX_TABLES);
+    assert(count == 3);
+    
+    // Every table comes after the tables it converts into
+    count = tablebase_signatures(4, all, TB_MAX_TABLES);
+    assert(count > 3);
+    int kqvk = -1, kpvk = -1, kqvkp = -1;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(all[i], "KQvK") == 0) kqvk = i;
+        if (strcmp(all[i], "KPvK") == 0) kpvk = i;
+        if (strcmp(all[i], "KQvKP") == 0) kqvkp = i;
+    }
+    assert(kqvk >= 0 && kpvk >= 0 && kqvkp >= 0);
+    assert(kqvk < kpvk && kpvk < kqvkp);
+}
+
+void test_generate_pawnless() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    free_tablebases();
+    mkdir(TB_TEST_DIR, 0755);
+    
+    assert(generate_tablebase("KQvK", TB_TEST_DIR, 2, record_stats));
+    const TbGenStats* kqvk = stats_of("KQvK");
+    assert(kqvk && kqvk->wins > 0 && kqvk->losses > 0);
+    
+    // Longest queen mate is 10 moves
+    assert(kqvk->max_dtz == 20);
+    
+    // The black king and the queen are coded among the squares left free
+    assert(kqvk->entries == 2 * 10 * 63 * 62);
+    
+    // Mate in one, and mated
+    TbResult result;
+    probe_fen("k7/8/1K6/8/8/8/8/6Q1 w - - 0 1", &result);
+    assert(result.wdl == 1 && result.dtz == 1);
+    probe_fen("k6Q/8/1K6/8/8/8/8/8 b - - 0 1", &result);
+    assert(result.wdl == -1 && result.dtz == 0);
+    
+    // Stalemate, and the queen hanging
+    probe_fen("k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", &result);
+    assert(result.wdl == 0);
+    probe_fen("8/8/8/3k4/3Q4/8/8/7K b - - 0 1", &result);
+    assert(result.wdl == 0);
+    
+    // The same positions with colors swapped
+    probe_fen("K7/8/1k6/8/8/8/8/6q1 b - - 0 1", &result);
+    assert(result.wdl == 1 && result.dtz == 1);
+    probe_fen("8/8/8/3K4/3q4/8/8/7k w - - 0 1", &result);
+    assert(result.wdl == 0);
+    
+    // No probes with castling rights or for missing tables
+    Board board;
+    set_fen(&board, "4k3/8/8/8/8/8/8/R3K3 w Q - 0 1");
+    assert(!probe_tablebase(&board, &result));
+    set_fen(&board, "4k3/8/8/8/8/8/8/4K1N1 w - - 0 1");
+    assert(!probe_tablebase(&board, &result));
+}
+
+void test_generate_with_pawns() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    // Pulls in the rook table for underpromotions
+    report_count = 0;
+    assert(generate_tablebase("KvKP", TB_TEST_DIR, 1, record_stats));
+    assert(stats_of("KPvK") && stats_of("KRvK"));
+    assert(stats_of("KRvK")->max_dtz == 32);
+    assert(stats_of("KPvK")->entries == 2 * 32 * 48 * 62);
+    
+    // Win/draw/loss agrees with the KPK bitbase, for both sides to move
+    int checked = 0;
+    for (Square pawn = A2; pawn <= H7; pawn++) {
+        for (Square wk = 0; wk < 64; wk++) {
+            for (Square bk = 0; bk < 64; bk++) {
+                for (int stm = WHITE; stm <= BLACK; stm++) {
+                    if (wk == pawn || bk == pawn || square_distance(wk, bk) <= 1) continue;
+                    if (stm == WHITE && (pawn_attacks(pawn, WHITE) & square_bb(bk))) continue;
+                    
+                    char fen[128];
+                    piece_fen(fen, wk, 'P', pawn, bk, (Color)stm);
+                    TbResult result;
+                    probe_fen(fen, &result);
+                    
+                    bool win = (stm == WHITE) ? result.wdl == 1 : result.wdl == -1;
+                    assert(win == kpk_probe(wk, pawn, bk, (Color)stm));
+                    checked++;
+                }
+            }
+        }
+    }
+    printf("  %d KPK positions agree with the bitbase\n", checked);
+}
+
+// Every entry of a table against one move of lookahead: a win has the shortest way into a loss,
+// a loss the longest way into a win (captures and pawn moves count one ply), a draw neither
+static int check_against_moves(char piece) {
+    int checked = 0;
+    for (Square wk = 0; wk < 64; wk++) {
+        for (Square square = 0; square < 64; square++) {
+            if (piece == 'P' && (square < A2 || square > H7)) continue;
+            for (Square bk = 0; bk < 64; bk++) {
+                for (int stm = WHITE; stm <= BLACK; stm++) {
+                    if (wk == square || bk == square || square_distance(wk, bk) <= 1) continue;
+                    
+                    char fen[128];
+                    piece_fen(fen, wk, piece, square, bk, (Color)stm);
+                    Board board;
+                    set_fen(&board, fen);
+                    if (is_in_check(&board, stm == WHITE ? BLACK : WHITE)) continue;
+                    
+                    TbResult result;
+                    assert(probe_tablebase(&board, &result));
+                    
+                    MoveList list;
+                    generate_moves(&board, &list);
+                    int win_dtz = 1000, loss_dtz = 0;
+                    bool draw = false;
+                    for (int i = 0; i < list.count; i++) {
+                        Move move = list.moves[i];
+                        bool zeroing = is_capture(move) || piece_on(&board, move_from(move)) == PAWN;
+                        make_move(&board, move);
+                        
+                        // Bare kings and a lone minor piece have no table; with no pawn to take
+                        // it, an en passant square changes nothing
+                        Square en_passant = board.en_passant_square;
+                        board.en_passant_square = NO_SQUARE;
+                        TbResult child = { 0, 0 };
+                        probe_tablebase(&board, &child);
+                        board.en_passant_square = en_passant;
+                        unmake_move(&board, move);
+                        
+                        int dtz = zeroing ? 1 : child.dtz + 1;
+                        if (child.wdl < 0 && dtz < win_dtz) win_dtz = dtz;
+                        if (child.wdl == 0) draw = true;
+                        if (child.wdl > 0 && dtz > loss_dtz) loss_dtz = dtz;
+                    }
+                    
+                    if (list.count == 0) {
+                        bool mate = is_in_check(&board, board.side_to_move);
+                        assert(result.wdl == (mate ? -1 : 0) && result.dtz == 0);
+                    } else if (win_dtz < 1000) {
+                        assert(result.wdl == 1 && result.dtz == win_dtz);
+                    } else if (draw) {
+                        assert(result.wdl == 0);
+                    } else {
+                        assert(result.wdl == -1 && result.dtz == loss_dtz);
+                    }
+                    checked++;
+                }
+            }
+        }
+    }
+    return checked;
+}
+
+void test_entries_agree_with_moves() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    int checked = check_against_moves('Q') + check_against_moves('R') + check_against_moves('P');
+    printf("  %d KQvK, KRvK and KPvK positions agree with their moves\n", checked);
+}
+
+void test_reload_from_files() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    const char* fens[] = {
+        "k7/8/1K6/8/8/8/8/6Q1 w - - 0 1",
+        "8/8/3k4/8/8/8/1R6/4K3 b - - 0 1",
+        "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1",
+        "8/4p3/8/8/8/2K5/8/5k2 b - - 0 1"
+    };
+    TbResult before[4], after[4];
+    for (int i = 0; i < 4; i++) probe_fen(fens[i], &before[i]);
+    int count = tablebase_count();
+    
+    // The memory-mapped files give the same results
+    free_tablebases();
+    assert(tablebase_count() == 0 && tb_max_pieces == 0);
+    assert(load_tablebases(TB_TEST_DIR) == count);
+    assert(tb_max_pieces == 3);
+    for (int i = 0; i < 4; i++) {
+        probe_fen(fens[i], &after[i]);
+        assert(before[i].wdl == after[i].wdl && before[i].dtz == after[i].dtz);
+    }
+    
+    for (int i = 0; i < tablebase_count(); i++) {
+        assert(tablebase_probe_latency(i, 1000) > 0.0);
+    }
+    assert(load_tablebases("/nonexistent/zugzwang") == -1);
+}
+
+void test_search_uses_tablebases() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    SearchParams params = { .max_depth = 3, .use_quiescence = true, .tt = &tt };
+    SearchInfo info;
+    Board board;
+    
+    // Every child is a tablebase position: the best move keeps the win with the lowest DTZ
+    set_fen(&board, "k7/8/1K6/8/8/8/8/6Q1 w - - 0 1");
+    iterative_deepening(&board, 3, &info, &params);
+    assert(info.tb_hits > 0);
+    assert(info.pv_lines[0].score >= MATE_SCORE - 1 || info.pv_lines[0].score > TB_WIN_SCORE - 20);
+    
+    // Black takes the hanging rook, reaching a KPvK tablebase draw
+    set_fen(&board, "8/8/8/3R4/4k3/8/4P3/4K3 b - - 0 1");
+    clear_tt(&tt);
+    iterative_deepening(&board, 3, &info, &params);
+    assert(info.tb_hits > 0);
+    assert(info.pv_lines[0].pv[0] == encode_move(E4, D5, CAPTURE));
+    assert(info.pv_lines[0].score == DRAW_SCORE);
+    free_tt(&tt);
+    
+    free_tablebases();
+}
+
+int main() {
+    printf("Running tablebase tests...\n");
+    
+    test_signatures();
+    test_generate_pawnless();
+    test_generate_with_pawns();
+    test_entries_agree_with_moves();
+    test_reload_from_files();
+    test_search_uses_tablebases();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
@@ -8,10 +8,30 @@
 #include "../src/moves.h"
 #include <stdio.h>
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+
+#define SNAPSHOT_PATH "/tmp/zugzwang_test_tt.bin"
+
+// Probes the start position under an arbitrary hash; its moves pass the pseudo-legality check
+static bool probe_hash(TranspositionTable* tt, uint64_t hash, TTEntry* entry) {
+    static Board board;
+    static bool ready = false;
+    if (!ready) {
+        init_bitboards();
+        init_zobrist();
+        init_board(&board);
+        ready = true;
+    }
+    board.hash = hash;
+    return probe_tt(tt, &board, entry);
+}
 
 void test_tt_initialization() {
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     assert(tt.entries != NULL);
     assert(tt.size > 0);
@@ -22,41 +42,123 @@ void test_tt_initialization() {
     assert(tt.size == 0);
 }
 
+void test_tt_huge_page_allocation() {
+    // Large enough to be zeroed by several threads
+    TranspositionTable tt;
+    assert(init_tt(&tt, 96));
+    assert(tt.entries != NULL);
+    assert(tt.size == 96 * 1024 * 1024 / sizeof(TTSlot));
+    assert((uintptr_t)tt.entries % TT_ALIGNMENT == 0);
+    
+    for (size_t i = 0; i < tt.size; i++) {
+        assert(atomic_load(&tt.entries[i].key) == 0 && atomic_load(&tt.entries[i].data) == 0);
+    }
+    
+    // Usable at both ends
+    store_tt(&tt, tt.size - 1, 10, 0, 1, TT_EXACT);
+    store_tt(&tt, tt.size, 20, 0, 1, TT_EXACT);
+    TTEntry entry;
+    assert(probe_hash(&tt, tt.size - 1, &entry) && entry.score == 10);
+    assert(probe_hash(&tt, tt.size, &entry) && entry.score == 20);
+    free_tt(&tt);
+    
+    // An empty table is a valid table that stores nothing
+    assert(init_tt(&tt, 0));
+    assert(tt.entries == NULL && tt.size == 0);
+    store_tt(&tt, 1, 0, 0, 1, TT_EXACT);
+    assert(!probe_hash(&tt, 1, &entry));
+    free_tt(&tt);
+    
+    // A table that cannot be mapped is reported, and left empty
+    assert(!init_tt(&tt, (size_t)1 << 40));
+    assert(tt.entries == NULL && tt.size == 0);
+    free_tt(&tt);
+}
+
+void test_tt_resize() {
+    TranspositionTable tt;
+    assert(init_tt(&tt, 8));
+    TTSlot* memory = tt.entries;
+    store_tt(&tt, 12345, 1, 0, 1, TT_EXACT);
+    age_tt(&tt);
+    
+    // Smaller: same memory, emptied, the rest of it released
+    TTEntry entry;
+    assert(resize_tt(&tt, 4));
+    assert(tt.entries == memory && tt.size == 4 * 1024 * 1024 / sizeof(TTSlot));
+    assert(tt.allocated_bytes == 4 * 1024 * 1024 && tt.current_age == 0);
+    assert(!probe_hash(&tt, 12345, &entry));
+    store_tt(&tt, tt.size - 1, 2, 0, 1, TT_EXACT);
+    assert(probe_hash(&tt, tt.size - 1, &entry) && entry.score == 2);
+    
+    // The same size only empties it
+    assert(resize_tt(&tt, 4));
+    assert(tt.entries == memory && !probe_hash(&tt, tt.size - 1, &entry));
+    
+    // Larger: new memory, 2 MB aligned and zeroed
+    assert(resize_tt(&tt, 96));
+    assert(tt.size == 96 * 1024 * 1024 / sizeof(TTSlot));
+    assert((uintptr_t)tt.entries % TT_ALIGNMENT == 0);
+    for (size_t i = 0; i < tt.size; i += 4099) {
+        assert(atomic_load(&tt.entries[i].key) == 0 && atomic_load(&tt.entries[i].data) == 0);
+    }
+    store_tt(&tt, tt.size - 1, 3, 0, 1, TT_EXACT);
+    assert(probe_hash(&tt, tt.size - 1, &entry) && entry.score == 3);
+    
+    // Cleared on several threads (over 64 MB)
+    for (size_t i = 0; i < tt.size; i += 1000) {
+        store_tt(&tt, i, 4, 0, 1, TT_EXACT);
+    }
+    clear_tt(&tt);
+    for (size_t i = 0; i < tt.size; i++) {
+        assert(atomic_load(&tt.entries[i].key) == 0 && atomic_load(&tt.entries[i].data) == 0);
+    }
+    
+    // Down to nothing and back
+    assert(resize_tt(&tt, 0));
+    assert(tt.entries == NULL && tt.size == 0);
+    assert(resize_tt(&tt, 1));
+    store_tt(&tt, 5, 5, 0, 1, TT_EXACT);
+    assert(probe_hash(&tt, 5, &entry) && entry.score == 5);
+    
+    free_tt(&tt);
+}
+
 void test_tt_store_probe() {
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     uint64_t hash = 0x123456789ABCDEFULL;
     Move move = encode_move(E2, E4, NORMAL);
     
     store_tt(&tt, hash, 150, move, 5, TT_EXACT);
     
-    TTEntry* entry = probe_tt(&tt, hash);
-    assert(entry != NULL);
-    assert(entry->hash == hash);
-    assert(entry->score == 150);
-    assert(entry->best_move == move);
-    assert(entry->depth == 5);
-    assert(entry->flag == TT_EXACT);
+    TTEntry entry;
+    assert(probe_hash(&tt, hash, &entry));
+    assert(entry.hash == hash);
+    assert(entry.score == 150);
+    assert(entry.best_move == move);
+    assert(entry.depth == 5);
+    assert(entry.flag == TT_EXACT);
     
     free_tt(&tt);
 }
 
 void test_tt_probe_miss() {
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     uint64_t hash = 0x123456789ABCDEFULL;
-    TTEntry* entry = probe_tt(&tt, hash);
+    TTEntry entry;
     
-    assert(entry == NULL);
+    assert(!probe_hash(&tt, hash, &entry));
     
     free_tt(&tt);
 }
 
 void test_tt_replacement() {
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     uint64_t hash = 0x123456789ABCDEFULL;
     Move move1 = encode_move(E2, E4, NORMAL);
@@ -68,32 +170,34 @@ void test_tt_replacement() {
     // Store deeper search - should replace
     store_tt(&tt, hash, 200, move2, 5, TT_LOWER);
     
-    TTEntry* entry = probe_tt(&tt, hash);
-    assert(entry->score == 200);
-    assert(entry->best_move == move2);
-    assert(entry->depth == 5);
+    TTEntry entry;
+    assert(probe_hash(&tt, hash, &entry));
+    assert(entry.score == 200);
+    assert(entry.best_move == move2);
+    assert(entry.depth == 5);
     
     // Store shallower search - should not replace
     store_tt(&tt, hash, 150, move1, 2, TT_UPPER);
     
-    entry = probe_tt(&tt, hash);
-    assert(entry->score == 200);
-    assert(entry->depth == 5);
+    assert(probe_hash(&tt, hash, &entry));
+    assert(entry.score == 200);
+    assert(entry.depth == 5);
     
     free_tt(&tt);
 }
 
 void test_tt_age() {
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     uint64_t hash = 0x123456789ABCDEFULL;
     Move move = encode_move(E2, E4, NORMAL);
     
     store_tt(&tt, hash, 100, move, 5, TT_EXACT);
     
-    TTEntry* entry = probe_tt(&tt, hash);
-    assert(entry->age == 0);
+    TTEntry entry;
+    assert(probe_hash(&tt, hash, &entry));
+    assert(entry.age == 0);
     
     age_tt(&tt);
     assert(tt.current_age == 1);
@@ -102,30 +206,315 @@ void test_tt_age() {
     Move move2 = encode_move(D2, D4, NORMAL);
     store_tt(&tt, hash, 50, move2, 1, TT_EXACT);
     
-    entry = probe_tt(&tt, hash);
-    assert(entry->score == 50);
-    assert(entry->age == 1);
+    assert(probe_hash(&tt, hash, &entry));
+    assert(entry.score == 50);
+    assert(entry.age == 1);
     
     free_tt(&tt);
 }
 
 void test_tt_clear() {
     TranspositionTable tt;
-    init_tt(&tt, 1);
+    assert(init_tt(&tt, 1));
     
     uint64_t hash = 0x123456789ABCDEFULL;
     Move move = encode_move(E2, E4, NORMAL);
     
     store_tt(&tt, hash, 100, move, 5, TT_EXACT);
-    TTEntry* entry = probe_tt(&tt, hash);
-    assert(entry != NULL);
+    TTEntry entry;
+    assert(probe_hash(&tt, hash, &entry));
     
     clear_tt(&tt);
     assert(tt.current_age == 0);
     
-    entry = probe_tt(&tt, hash);
-    assert(entry == NULL);
+    assert(!probe_hash(&tt, hash, &entry));
+    
+    free_tt(&tt);
+}
+
+void test_tt_move_validation() {
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    
+    // A black move stored under the hash of a position with White to move
+    uint64_t hash = 0x0F0F0F0F12345678ULL;
+    store_tt(&tt, hash, -30, encode_move(E7, E5, NORMAL), 4, TT_UPPER);
+    
+    TTEntry entry;
+    assert(probe_hash(&tt, hash, &entry));
+    assert(entry.best_move == 0);
+    assert(entry.score == -30 && entry.depth == 4 && entry.flag == TT_UPPER);
+    
+    free_tt(&tt);
+}
+
+void test_tt_torn_write_detected() {
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    
+    uint64_t hash = 0x123456789ABCDEFULL;
+    store_tt(&tt, hash, 100, encode_move(E2, E4, NORMAL), 5, TT_EXACT);
+    
+    // The data word of another store lands without its key
+    TTSlot* slot = &tt.entries[hash % tt.size];
+    atomic_store(&slot->data, atomic_load(&slot->data) ^ 0x0000000500000000ULL);
+    
+    TTEntry entry;
+    assert(!probe_hash(&tt, hash, &entry));
+    
+    free_tt(&tt);
+}
+
+// Stress: every thread stores entries whose contents follow from their hash, all into the
+// same few slots, while checking that whatever it reads back is self-consistent
+#define STRESS_THREADS 8
+#define STRESS_ITERATIONS 200000
+#define STRESS_SLOTS 4
+
+typedef struct {
+    TranspositionTable* tt;
+    int id;
+    int hits;
+} StressTask;
+
+static Move stress_move(uint64_t hash) {
+    // Start-position moves only, so that a consistent entry always keeps its move
+    static const Square from[4] = { E2, D2, G1, B1 };
+    static const Square to[4] = { E4, D4, F3, C3 };
+    int i = (int)(hash >> 40) & 3;
+    return encode_move(from[i], to[i], NORMAL);
+}
+
+static void* stress_worker(void* arg) {
+    StressTask* task = (StressTask*)arg;
+    TranspositionTable* tt = task->tt;
+    Board board;
+    init_board(&board);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL * (uint64_t)(task->id + 1);
+    
+    for (int i = 0; i < STRESS_ITERATIONS; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        
+        // Different keys landing in the same slots
+        uint64_t hash = (seed >> 8) * tt->size + (seed % STRESS_SLOTS);
+        int score = (int)(hash >> 20 & 0x3FFF);
+        int depth = (int)(hash >> 34 & 0x3F);
+        store_tt(tt, hash, score, stress_move(hash), depth, TT_EXACT);
+        
+        // Probe another thread's likely key and verify everything that comes back
+        board.hash = hash ^ ((uint64_t)(i & 7) << 30);
+        TTEntry entry;
+        if (probe_tt(tt, &board, &entry)) {
+            assert(entry.score == (int)(board.hash >> 20 & 0x3FFF));
+            assert(entry.depth == (int)(board.hash >> 34 & 0x3F));
+            assert(entry.best_move == stress_move(board.hash));
+            assert(entry.flag == TT_EXACT);
+            task->hits++;
+        }
+    }
+    return NULL;
+}
+
+void test_tt_concurrent_stores() {
+    init_bitboards();
+    init_zobrist();
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    
+    pthread_t threads[STRESS_THREADS];
+    StressTask tasks[STRESS_THREADS];
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        tasks[i] = (StressTask){ .tt = &tt, .id = i, .hits = 0 };
+        assert(pthread_create(&threads[i], NULL, stress_worker, &tasks[i]) == 0);
+    }
+    
+    int hits = 0;
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        hits += tasks[i].hits;
+    }
+    assert(hits > 0);
+    
+    free_tt(&tt);
+}
+
+void test_tt_stats() {
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    uint64_t hash = 0xABCDEF0123456789ULL;
+    TTEntry entry;
+    
+    assert(!probe_hash(&tt, hash, &entry));
+    store_tt(&tt, hash, 10, 0, 4, TT_EXACT);     // Empty slot
+    store_tt(&tt, hash, 20, 0, 6, TT_EXACT);     // Deeper
+    store_tt(&tt, hash, 30, 0, 2, TT_EXACT);     // Rejected
+    age_tt(&tt);
+    store_tt(&tt, hash, 40, 0, 1, TT_EXACT);     // Older search
+    assert(probe_hash(&tt, hash, &entry) && entry.score == 40);
+    
+    TTStats stats;
+    get_tt_stats(&tt, &stats);
+    assert(stats.probes == 2 && stats.hits == 1);
+    assert(stats.stores == 4 && stats.rejected == 1);
+    assert(stats.stored_empty == 1 && stats.stored_depth == 1 && stats.stored_age == 1);
+    assert(stats.collisions == 0);
+    
+    reset_tt_stats(&tt);
+    get_tt_stats(&tt, &stats);
+    assert(stats.probes == 0 && stats.hits == 0 && stats.stores == 0 && stats.rejected == 0);
+    
+    // The counters written by probes stay off the cache line holding entries and size
+    assert(offsetof(TranspositionTable, counters) % 64 == 0);
+    assert(offsetof(TranspositionTable, counters) / 64 != offsetof(TranspositionTable, size) / 64);
+    
+    // Hashfull counts the sampled slots written by the current search
+    clear_tt(&tt);
+    assert(tt_hashfull(&tt) == 0);
+    for (uint64_t i = 0; i < 1000; i++) {
+        store_tt(&tt, i, 0, 0, 1, TT_EXACT);
+    }
+    assert(tt_hashfull(&tt) == 1000);
+    age_tt(&tt);
+    assert(tt_hashfull(&tt) == 0);
+    for (uint64_t i = 0; i < 1000; i += 4) {
+        store_tt(&tt, i, 0, 0, 1, TT_EXACT);
+    }
+    assert(tt_hashfull(&tt) == 250);
+    
+    free_tt(&tt);
+}
+
+#ifdef DEBUG
+void test_tt_collision_counter() {
+    init_bitboards();
+    init_zobrist();
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    
+    Board first, second;
+    init_board(&first);
+    set_fen(&second, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    store_tt(&tt, first.hash, 5, encode_move(E2, E4, NORMAL), 3, TT_EXACT);
+    record_tt_position(&tt, &first);
+    
+    TTEntry entry;
+    assert(probe_tt(&tt, &first, &entry));
+    
+    // Another position given the same hash
+    second.hash = first.hash;
+    assert(probe_tt(&tt, &second, &entry));
+    TTStats stats;
+    get_tt_stats(&tt, &stats);
+    assert(stats.hits == 2 && stats.collisions == 1);
+    
+    free_tt(&tt);
+}
+#endif
+
+void test_tt_save_load() {
+    init_bitboards();
+    init_zobrist();
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    age_tt(&tt);
+    
+    uint64_t hashes[3] = { 0x1111222233334444ULL, 0x5555666677778888ULL, 0x99990000AAAABBBBULL };
+    for (int i = 0; i < 3; i++) {
+        store_tt(&tt, hashes[i], 10 * i - 7, encode_move(E2, E4, NORMAL), i + 1, TT_LOWER);
+    }
+    assert(save_tt(&tt, SNAPSHOT_PATH));
+    
+    // Loading takes the snapshot's size and age, whatever the table had
+    TranspositionTable loaded;
+    assert(init_tt(&loaded, 2));
+    assert(load_tt(&loaded, SNAPSHOT_PATH));
+    assert(loaded.size == tt.size && loaded.current_age == 1 && loaded.mapped_bytes > 0);
+    for (int i = 0; i < 3; i++) {
+        TTEntry entry;
+        assert(probe_hash(&loaded, hashes[i], &entry));
+        assert(entry.score == 10 * i - 7 && entry.depth == i + 1 && entry.flag == TT_LOWER);
+        assert(entry.best_move == encode_move(E2, E4, NORMAL) && entry.age == 1);
+    }
+    
+    // Stores go to private pages, never to the file
+    store_tt(&loaded, hashes[0], 500, 0, 30, TT_EXACT);
+    TTEntry entry;
+    assert(probe_hash(&loaded, hashes[0], &entry) && entry.score == 500);
+    TranspositionTable again;
+    assert(init_tt(&again, 1));
+    assert(load_tt(&again, SNAPSHOT_PATH));
+    assert(probe_hash(&again, hashes[0], &entry) && entry.score == -7);
+    
+    // Resizing replaces the mapping with memory of the table's own
+    assert(resize_tt(&again, 1));
+    assert(again.mapped_bytes == 0 && again.allocated_bytes > 0 && !probe_hash(&again, hashes[0], &entry));
+    
+    free_tt(&again);
+    free_tt(&loaded);
+    free_tt(&tt);
+    assert(loaded.entries == NULL && loaded.mapped_bytes == 0);
+}
+
+// Overwrites part of the snapshot file
+static void patch_snapshot(long offset, const void* bytes, size_t length) {
+    FILE* file = fopen(SNAPSHOT_PATH, "r+b");
+    assert(file);
+    fseek(file, offset, SEEK_SET);
+    fwrite(bytes, 1, length, file);
+    fclose(file);
+}
+
+void test_tt_load_rejects_mismatch() {
+    init_bitboards();
+    init_zobrist();
+    TranspositionTable tt;
+    assert(init_tt(&tt, 1));
+    store_tt(&tt, 42, 1, 0, 1, TT_EXACT);
+    
+    TranspositionTable target;
+    assert(init_tt(&target, 1));
+    store_tt(&target, 7, 3, 0, 2, TT_EXACT);
+    
+    // Missing file
+    remove(SNAPSHOT_PATH);
+    assert(!load_tt(&target, SNAPSHOT_PATH));
+    
+    // Another layout version (after the 8-byte magic)
+    assert(save_tt(&tt, SNAPSHOT_PATH));
+    uint32_t version = TT_LAYOUT_VERSION + 1;
+    patch_snapshot(8, &version, sizeof(version));
+    assert(!load_tt(&target, SNAPSHOT_PATH));
+    
+    // Other Zobrist keys (after the version and the slot size)
+    assert(save_tt(&tt, SNAPSHOT_PATH));
+    uint64_t zobrist = zobrist_fingerprint() ^ 1;
+    patch_snapshot(16, &zobrist, sizeof(zobrist));
+    assert(!load_tt(&target, SNAPSHOT_PATH));
+    
+    // A truncated file
+    assert(save_tt(&tt, SNAPSHOT_PATH));
+    static uint8_t prefix[TT_FILE_HEADER_SIZE + 16];
+    FILE* file = fopen(SNAPSHOT_PATH, "rb");
+    assert(file && fread(prefix, 1, sizeof(prefix), file) == sizeof(prefix));
+    fclose(file);
+    file = fopen(SNAPSHOT_PATH, "wb");
+    assert(file && fwrite(prefix, 1, sizeof(prefix), file) == sizeof(prefix));
+    fclose(file);
+    assert(!load_tt(&target, SNAPSHOT_PATH));
+    
+    // Not a snapshot
+    patch_snapshot(0, "NOTATTBL", 8);
+    assert(!load_tt(&target, SNAPSHOT_PATH));
+    
+    // The table is untouched by the failures
+    TTEntry entry;
+    assert(target.mapped_bytes == 0);
+    assert(probe_hash(&target, 7, &entry) && entry.score == 3);
     
+    remove(SNAPSHOT_PATH);
+    free_tt(&target);
     free_tt(&tt);
 }
 
@@ -191,11 +580,22 @@ int main() {
     printf("Running transposition tests...\n");
     
     test_tt_initialization();
+    test_tt_huge_page_allocation();
+    test_tt_resize();
     test_tt_store_probe();
     test_tt_probe_miss();
     test_tt_replacement();
     test_tt_age();
     test_tt_clear();
+    test_tt_move_validation();
+    test_tt_torn_write_detected();
+    test_tt_concurrent_stores();
+    test_tt_stats();
+#ifdef DEBUG
+    test_tt_collision_counter();
+#endif
+    test_tt_save_load();
+    test_tt_load_rejects_mismatch();
     test_tt_cutoff();
     test_mate_score_adjustment();
     
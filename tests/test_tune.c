@@ -0,0 +1,181 @@
+// test_tune.c
+// Test suite for tune.c
+
+#include "../src/tune.h"
+#include "../src/packed.h"
+#include "../src/evaluation.h"
+#include "../src/board.h"
+#include "../src/bitboard.h"
+#include "../src/zobrist.h"
+#include "../src/moves.h"
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE "/tmp/zugzwang_test_tune.bin"
+
+static const char* test_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/8/4k3/3p4/3P4/4K3/8/8 b - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 b - - 0 1",
+    "4k3/pp3ppp/8/8/8/8/PP4PP/4K3 w - - 0 1"
+};
+#define TEST_FEN_COUNT 7
+
+void test_linear_eval_matches_evaluate() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    double params[TUNE_PARAM_COUNT];
+    init_tune_params(params, &eval_params);
+    
+    for (int i = 0; i < TEST_FEN_COUNT; i++) {
+        Board board;
+        set_fen(&board, test_fens[i]);
+        
+        TuneEntry entry;
+        make_tune_entry(&board, DRAW, &entry);
+        assert(entry.result == 1);
+        
+        // evaluate() rounds its tapered and mobility terms down
+        int expected = evaluate(&board);
+        if (board.side_to_move == BLACK) expected = -expected;
+        assert(fabs(tune_evaluate(params, &entry) - expected) <= 2.0);
+    }
+}
+
+static void build_data(TuneData* data) {
+    // Each position labelled with the side that is ahead by the compiled-in evaluation
+    data->count = TEST_FEN_COUNT;
+    data->entries = malloc(TEST_FEN_COUNT * sizeof(TuneEntry));
+    for (int i = 0; i < TEST_FEN_COUNT; i++) {
+        Board board;
+        set_fen(&board, test_fens[i]);
+        int score = evaluate(&board) * (board.side_to_move == WHITE ? 1 : -1);
+        GameResult result = score > 50 ? WHITE_WINS : (score < -50 ? BLACK_WINS : DRAW);
+        make_tune_entry(&board, result, &data->entries[i]);
+    }
+}
+
+void test_threaded_loss_matches() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    TuneData data;
+    build_data(&data);
+    
+    double params[TUNE_PARAM_COUNT];
+    init_tune_params(params, &eval_params);
+    
+    double single = tune_loss(&data, params, 0.005, 1);
+    double threaded = tune_loss(&data, params, 0.005, 4);
+    assert(single > 0.0);
+    assert(fabs(single - threaded) < 1e-12);
+    
+    double k = find_best_k(&data, params, 2);
+    assert(k > 0.0 && k < 0.05);
+    assert(tune_loss(&data, params, k, 1) <= single + 1e-12);
+    
+    free_tune_data(&data);
+}
+
+void test_tuner_reduces_loss() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    TuneData data;
+    build_data(&data);
+    
+    double params[TUNE_PARAM_COUNT];
+    init_tune_params(params, &eval_params);
+    
+    TuneParams tune_params = {
+        .threads = 2,
+        .epochs = 50,
+        .learning_rate = 1.0,
+        .k = 0.01
+    };
+    double before = tune_loss(&data, params, tune_params.k, 1);
+    double after = run_tuner(&data, params, &tune_params, NULL, NULL);
+    assert(after < before);
+    
+    // Squares that never hold a piece keep their values
+    assert(params[TUNE_PST_MG + PAWN * 64 + A1] == 0.0);
+    assert(params[TUNE_PST_EG + PAWN * 64 + A1] == 0.0);
+    
+    free_tune_data(&data);
+}
+
+void test_load_tune_data() {
+    init_bitboards();
+    init_zobrist();
+    init_evaluation();
+    
+    PackedPosition positions[3];
+    Board board;
+    
+    // Labelled quiet position, unlabelled position, labelled position in check
+    set_fen(&board, test_fens[1]);
+    pack_position(&board, &positions[0]);
+    positions[0].result = WHITE_WINS;
+    pack_position(&board, &positions[1]);
+    set_fen(&board, "4k3/8/8/8/8/8/4q3/4K3 w - - 0 1");
+    pack_position(&board, &positions[2]);
+    positions[2].result = BLACK_WINS;
+    
+    PackedWriter writer;
+    assert(packed_writer_open(&writer, TEST_FILE, PACKED_POSITIONS));
+    assert(packed_write_positions(&writer, positions, 3));
+    assert(packed_writer_close(&writer));
+    
+    TuneData data;
+    assert(load_tune_data(&data, TEST_FILE, 3));
+    assert(data.count == 1);
+    assert(data.entries[0].result == 2);
+    assert(data.entries[0].occupied == positions[0].occupied);
+    free_tune_data(&data);
+    
+    assert(!load_tune_data(&data, "/nonexistent/zugzwang.bin", 1));
+    remove(TEST_FILE);
+}
+
+void test_write_tune_params() {
+    init_evaluation();
+    
+    double params[TUNE_PARAM_COUNT];
+    init_tune_params(params, &eval_params);
+    params[TUNE_PST_EG + KING * 64 + E1] = -42.4;
+    params[TUNE_MOBILITY] = 1.25;
+    assert(write_tune_params(params, TEST_FILE));
+    
+    // The output is a loadable parameter file
+    EvalParams loaded;
+    assert(load_eval_params(&loaded, TEST_FILE));
+    assert(loaded.material[PAWN] == 100);
+    assert(loaded.pst_mg[KING][E1] == eval_params.pst_mg[KING][E1]);
+    assert(loaded.pst_eg[KING][E1] == -42);
+    assert(loaded.mobility == 320);
+    assert(loaded.doubled_pawn == eval_params.doubled_pawn);
+    remove(TEST_FILE);
+}
+
+int main() {
+    printf("Running tune tests...\n");
+    
+    test_linear_eval_matches_evaluate();
+    test_threaded_loss_matches();
+    test_tuner_reduces_loss();
+    test_load_tune_data();
+    test_write_tune_params();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+// test_util.c
+// Test suite for util.c
+
+#include "../src/util.h"
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct {
+    int index;
+    pthread_t thread;
+} SliceTask;
+
+static void* mark_slice(void* arg) {
+    SliceTask* task = (SliceTask*)arg;
+    task->thread = pthread_self();
+    return NULL;
+}
+
+static void* count_call(void* arg) {
+    atomic_fetch_add((atomic_int*)arg, 1);
+    return NULL;
+}
+
+void test_run_workers_slices() {
+    // Each worker gets its own task; the calling thread runs the first
+    SliceTask tasks[4];
+    for (int i = 0; i < 4; i++) tasks[i].index = i;
+    run_workers(mark_slice, tasks, sizeof(SliceTask), 4);
+    
+    assert(pthread_equal(tasks[0].thread, pthread_self()));
+    for (int i = 1; i < 4; i++) {
+        assert(!pthread_equal(tasks[i].thread, pthread_self()));
+    }
+}
+
+void test_run_workers_shared_job() {
+    // Workers sharing one argument, and the thread count clamped to at least one
+    atomic_int calls = 0;
+    run_workers(count_call, &calls, 0, 8);
+    assert(atomic_load(&calls) == 8);
+    
+    run_workers(count_call, &calls, 0, 0);
+    assert(atomic_load(&calls) == 9);
+}
+
+void test_get_time_ms() {
+    uint64_t start = get_time_ms();
+    assert(start > 0);
+    assert(get_time_ms() >= start);
+}
+
+int main() {
+    printf("Running util tests...\n");
+    
+    test_run_workers_slices();
+    test_run_workers_shared_job();
+    test_get_time_ms();
+    
+    printf("All tests passed.\n");
+    return 0;
+}
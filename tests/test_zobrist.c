@@ -5,6 +5,7 @@
 #include "../src/board.h"
 #include "../src/bitboard.h"
 #include "../src/moves.h"
+#include "../src/movegen.h"
 #include <stdio.h>
 #include <assert.h>
 
@@ -166,6 +167,36 @@ void test_hash_series_of_moves() {
     assert(board.hash == start.hash);
 }
 
+void test_hash_before_making_move() {
+    init_bitboards();
+    init_zobrist();
+    
+    // Castling, rights lost to king and rook moves and captures, en passant, promotions
+    const char* fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/Pp2P3/2N2Q1p/1PPBBPPP/R3K2R b KQkq a3 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+    };
+    
+    for (int f = 0; f < 6; f++) {
+        Board board;
+        set_fen(&board, fens[f]);
+        MoveList list;
+        generate_moves(&board, &list);
+        
+        for (int i = 0; i < list.count; i++) {
+            uint64_t predicted = hash_after_move(&board, list.moves[i]);
+            make_move(&board, list.moves[i]);
+            assert(predicted == board.hash);
+            assert(board.hash == compute_hash(&board));
+            unmake_move(&board, list.moves[i]);
+        }
+    }
+}
+
 int main() {
     printf("Running zobrist tests...\n");
     
@@ -176,6 +207,7 @@ int main() {
     test_hash_after_move();
     test_hash_consistency();
     test_hash_series_of_moves();
+    test_hash_before_making_move();
     
     printf("All tests passed.\n");
     return 0;